@@ -525,25 +525,27 @@ unsigned long clk_get_rate_all_locked(struct clk *c)
 	return rate;
 }
 
-long clk_round_rate(struct clk *c, unsigned long rate)
+long clk_round_rate_locked(struct clk *c, unsigned long rate)
 {
-	unsigned long flags, max_rate;
-	long ret;
-
-	clk_lock_save(c, &flags);
+	unsigned long max_rate;
 
-	if (!c->ops || !c->ops->round_rate) {
-		ret = -ENOSYS;
-		goto out;
-	}
+	if (!c->ops || !c->ops->round_rate)
+		return -ENOSYS;
 
 	max_rate = clk_get_max_rate(c);
 	if (rate > max_rate)
 		rate = max_rate;
 
-	ret = c->ops->round_rate(c, rate);
+	return c->ops->round_rate(c, rate);
+}
 
-out:
+long clk_round_rate(struct clk *c, unsigned long rate)
+{
+	unsigned long flags;
+	long ret;
+
+	clk_lock_save(c, &flags);
+	ret = clk_round_rate_locked(c, rate);
 	clk_unlock_restore(c, &flags);
 	return ret;
 }
@@ -112,6 +112,9 @@ enum shared_bus_users_mode {
 	SHARED_BW,
 	SHARED_CEILING,
 	SHARED_AUTO,
+	SHARED_ACTIVITY,	/* measured demand, EMC governor input */
+	SHARED_DECLARED,	/* declared non-isochronous bandwidth */
+	SHARED_ISO,		/* declared isochronous bandwidth */
 };
 
 enum clk_state {
@@ -238,6 +241,7 @@ void clk_set_cansleep(struct clk *c);
 unsigned long clk_get_max_rate(struct clk *c);
 unsigned long clk_get_min_rate(struct clk *c);
 unsigned long clk_get_rate_locked(struct clk *c);
+long clk_round_rate_locked(struct clk *c, unsigned long rate);
 int clk_set_rate_locked(struct clk *c, unsigned long rate);
 int clk_set_parent_locked(struct clk *c, struct clk *parent);
 int tegra_clk_shared_bus_update(struct clk *c);
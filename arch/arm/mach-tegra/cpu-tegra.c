@@ -32,6 +32,7 @@
 #include <linux/io.h>
 #include <linux/suspend.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/cpu.h>
 
 #include <asm/system.h>
@@ -187,9 +188,142 @@ static unsigned int edp_predict_limit(unsigned int cpus)
 	return limit;
 }
 
+/*
+ * Predictive EDP trim. Crossing an EDP zone boundary or the throttle
+ * temperature drops the cpu cap by hundreds of MHz at once. The thermal
+ * driver samples Tj periodically; the filtered slope is used to predict
+ * Tj edp_predict_horizon ms ahead, and a PID controller walks the cap from
+ * the current zone limit towards the limit behind the next boundary as
+ * the prediction enters the edp_predict_band guard band below it. The
+ * controller output is in per-mille of that step; gains are scaled so that
+ * an error equal to the band with kp = 1000 gives the full step.
+ */
+#define EDP_TREND_STALE_MS	10000
+#define EDP_TREND_STALE_PERIODS	3
+#define EDP_TREND_SLOPE_MAX	100000	/* mC/s */
+
+static bool edp_predict = true;
+module_param(edp_predict, bool, 0644);
+static unsigned int edp_predict_horizon = 2000;	/* ms */
+module_param(edp_predict_horizon, uint, 0644);
+static unsigned int edp_predict_band = 4000;	/* mC */
+module_param(edp_predict_band, uint, 0644);
+static unsigned int edp_predict_kp = 1000;
+module_param(edp_predict_kp, uint, 0644);
+static unsigned int edp_predict_ki = 100;
+module_param(edp_predict_ki, uint, 0644);
+static unsigned int edp_predict_kd = 500;
+module_param(edp_predict_kd, uint, 0644);
+
+static struct {
+	long temp;		/* last sample, mC */
+	long slope;		/* filtered dTj/dt, mC/s */
+	long integral;		/* mC * s */
+	long predicted;		/* mC */
+	long boundary;		/* next cap step, mC */
+	long throttle_temp;	/* mC */
+	ktime_t stamp;
+	long period;		/* last sampling interval, ms */
+	unsigned int trim;	/* per-mille of the step to the next limit */
+	unsigned int max_trim;
+	unsigned long samples;
+	unsigned long trimmed;
+} edp_trend;
+
+/* Next temperature at which the cap steps down and the limit behind it */
+static long edp_trend_next(unsigned int cpus, unsigned int *next_limit)
+{
+	long boundary = LONG_MAX;
+	unsigned int throttle_limit;
+
+	*next_limit = 0;
+	if (edp_thermal_index + 1 < cpu_edp_limits_size) {
+		boundary = cpu_edp_limits[edp_thermal_index].temperature * 1000L;
+		*next_limit = cpu_edp_limits[edp_thermal_index + 1]
+			.freq_limits[cpus - 1];
+	}
+
+	throttle_limit = tegra_throttle_entry_speed();
+	if (throttle_limit && edp_trend.throttle_temp &&
+	    edp_trend.throttle_temp < boundary && !tegra_is_throttling()) {
+		boundary = edp_trend.throttle_temp;
+		*next_limit = throttle_limit;
+	}
+
+	return boundary;
+}
+
+static unsigned int edp_trend_trim(unsigned int limit, unsigned int cpus)
+{
+	unsigned int next_limit;
+
+	if (!edp_predict || !edp_trend.trim || !cpu_edp_limits)
+		return limit;
+
+	edp_trend_next(cpus, &next_limit);
+	if (!next_limit || next_limit >= limit)
+		return limit;
+
+	return limit - (limit - next_limit) * edp_trend.trim / 1000;
+}
+
+static unsigned int edp_trend_update(long temp)
+{
+	ktime_t now = ktime_get();
+	long band = max(edp_predict_band, 1000U);
+	long horizon = min(edp_predict_horizon, 10000U);
+	long dt_ms = EDP_TREND_STALE_MS;
+	unsigned int next_limit;
+	long err;
+	s64 u;
+
+	if (edp_trend.samples++)
+		dt_ms = min_t(s64, ktime_to_ms(ktime_sub(now, edp_trend.stamp)),
+			      EDP_TREND_STALE_MS);
+
+	if (dt_ms >= EDP_TREND_STALE_MS) {
+		/* first sample, or back from suspend: no usable slope */
+		edp_trend.slope = 0;
+		edp_trend.integral = 0;
+	} else if (dt_ms > 0) {
+		long raw = (temp - edp_trend.temp) * 1000 / dt_ms;
+
+		raw = clamp_t(long, raw, -EDP_TREND_SLOPE_MAX,
+			      EDP_TREND_SLOPE_MAX);
+		edp_trend.slope += (raw - edp_trend.slope) / 4;
+		edp_trend.period = dt_ms;
+	}
+	edp_trend.temp = temp;
+	edp_trend.stamp = now;
+
+	edp_trend.predicted = temp + edp_trend.slope * horizon / 1000;
+	edp_trend.boundary = edp_trend_next(
+		cpumask_weight(&edp_cpumask) ? : 1, &next_limit);
+	if (!edp_predict || !next_limit) {
+		edp_trend.integral = 0;
+		return 0;
+	}
+
+	err = edp_trend.predicted - (edp_trend.boundary - band);
+
+	/* integrate only inside the band, bounded to prevent wind-up */
+	if (err > 0 || edp_trend.integral > 0) {
+		edp_trend.integral += err * dt_ms / 1000;
+		edp_trend.integral = clamp(edp_trend.integral, 0L, 4 * band);
+	}
+
+	u = (s64)edp_predict_kp * err +
+		(s64)edp_predict_ki * edp_trend.integral +
+		(s64)edp_predict_kd * edp_trend.slope;
+	u = div_s64(u, band);
+
+	return clamp_t(s64, u, 0, 1000);
+}
+
 static void edp_update_limit(void)
 {
-	unsigned int limit = edp_predict_limit(cpumask_weight(&edp_cpumask));
+	unsigned int cpus = cpumask_weight(&edp_cpumask);
+	unsigned int limit = edp_trend_trim(edp_predict_limit(cpus), cpus);
 
 #ifdef CONFIG_TEGRA_EDP_EXACT_FREQ
 	edp_limit = limit;
@@ -254,6 +388,83 @@ int tegra_edp_update_thermal_zone(int temperature)
 }
 EXPORT_SYMBOL_GPL(tegra_edp_update_thermal_zone);
 
+/*
+ * Periodic Tj sample from the thermal driver, both temperatures in mC on
+ * the EDP table scale. Updates the slope estimate and the predictive trim.
+ */
+void tegra_edp_update_thermal_trend(long temp, long throttle_temp)
+{
+	unsigned int trim;
+
+	if (!cpu_edp_limits)
+		return;
+
+	mutex_lock(&tegra_cpu_lock);
+	edp_trend.throttle_temp = throttle_temp;
+	trim = edp_trend_update(temp);
+	if (trim) {
+		edp_trend.trimmed++;
+		edp_trend.max_trim = max(edp_trend.max_trim, trim);
+	}
+
+	if (trim != edp_trend.trim) {
+		edp_trend.trim = trim;
+		if (target_cpu_speed[0]) {
+			edp_update_limit();
+			tegra_cpu_set_speed_cap(NULL);
+		}
+	}
+	mutex_unlock(&tegra_cpu_lock);
+}
+EXPORT_SYMBOL_GPL(tegra_edp_update_thermal_trend);
+
+/*
+ * The thermal driver stopped sampling: drop the trend so neither the trim
+ * nor the throttle keeps acting on a slope that is no longer measured.
+ */
+void tegra_edp_stop_thermal_trend(void)
+{
+	if (!cpu_edp_limits)
+		return;
+
+	mutex_lock(&tegra_cpu_lock);
+	edp_trend.samples = 0;
+	edp_trend.slope = 0;
+	edp_trend.integral = 0;
+	edp_trend.period = 0;
+	if (edp_trend.trim) {
+		edp_trend.trim = 0;
+		if (target_cpu_speed[0]) {
+			edp_update_limit();
+			tegra_cpu_set_speed_cap(NULL);
+		}
+	}
+	mutex_unlock(&tegra_cpu_lock);
+}
+EXPORT_SYMBOL_GPL(tegra_edp_stop_thermal_trend);
+
+/*
+ * Filtered Tj slope in mC/s, called with tegra_cpu_lock held. Reported as
+ * flat once no sample has arrived for EDP_TREND_STALE_PERIODS sampling
+ * intervals, so a slope measured before sampling stopped does not hold
+ * the throttle at its current step indefinitely.
+ */
+long tegra_edp_thermal_slope(void)
+{
+	s64 age;
+
+	if (!edp_trend.samples || !edp_trend.period)
+		return 0;
+
+	age = ktime_to_ms(ktime_sub(ktime_get(), edp_trend.stamp));
+	if (age > min_t(s64, EDP_TREND_STALE_PERIODS * edp_trend.period,
+			EDP_TREND_STALE_MS))
+		return 0;
+
+	return edp_trend.slope;
+}
+EXPORT_SYMBOL_GPL(tegra_edp_thermal_slope);
+
 int tegra_system_edp_alarm(bool alarm)
 {
 	int ret = -ENODEV;
@@ -403,12 +614,46 @@ static int system_edp_alarm_set(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(system_edp_alarm_fops,
 			system_edp_alarm_get, system_edp_alarm_set, "%llu\n");
 
+static int edp_trend_show(struct seq_file *s, void *data)
+{
+	mutex_lock(&tegra_cpu_lock);
+	seq_printf(s, "temp:       %ld mC\n", edp_trend.temp);
+	seq_printf(s, "slope:      %ld mC/s\n", edp_trend.slope);
+	seq_printf(s, "period:     %ld ms\n", edp_trend.period);
+	seq_printf(s, "predicted:  %ld mC\n", edp_trend.predicted);
+	seq_printf(s, "boundary:   %ld mC\n", edp_trend.boundary);
+	seq_printf(s, "integral:   %ld mC*s\n", edp_trend.integral);
+	seq_printf(s, "trim:       %u/1000 (max %u)\n",
+		   edp_trend.trim, edp_trend.max_trim);
+	seq_printf(s, "limit:      %u kHz\n", edp_limit);
+	seq_printf(s, "samples:    %lu (%lu trimmed)\n",
+		   edp_trend.samples, edp_trend.trimmed);
+	mutex_unlock(&tegra_cpu_lock);
+	return 0;
+}
+
+static int edp_trend_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, edp_trend_show, inode->i_private);
+}
+
+static const struct file_operations edp_trend_fops = {
+	.open		= edp_trend_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init tegra_edp_debug_init(struct dentry *cpu_tegra_debugfs_root)
 {
 	if (!debugfs_create_file("edp_alarm", 0644, cpu_tegra_debugfs_root,
 				 NULL, &system_edp_alarm_fops))
 		return -ENOMEM;
 
+	if (!debugfs_create_file("edp_predict", 0444, cpu_tegra_debugfs_root,
+				 NULL, &edp_trend_fops))
+		return -ENOMEM;
+
 	return 0;
 }
 #endif
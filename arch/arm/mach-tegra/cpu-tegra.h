@@ -34,6 +34,7 @@ int tegra_throttle_init(struct mutex *cpu_lock);
 void tegra_throttle_exit(void);
 bool tegra_is_throttling(void);
 unsigned int tegra_throttle_governor_speed(unsigned int requested_speed);
+unsigned int tegra_throttle_entry_speed(void);
 int tegra_throttle_debug_init(struct dentry *cpu_tegra_debugfs_root);
 void tegra_throttling_enable(bool enable);
 #else
@@ -46,6 +47,8 @@ static inline bool tegra_is_throttling(void)
 static inline unsigned int tegra_throttle_governor_speed(
 	unsigned int requested_speed)
 { return requested_speed; }
+static inline unsigned int tegra_throttle_entry_speed(void)
+{ return 0; }
 static inline int tegra_throttle_debug_init(
 	struct dentry *cpu_tegra_debugfs_root)
 { return 0; }
@@ -57,6 +60,7 @@ static inline void tegra_throttling_enable(bool enable)
 int tegra_auto_hotplug_init(struct mutex *cpu_lock);
 void tegra_auto_hotplug_exit(void);
 void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend);
+bool tegra_cpu_is_parked(unsigned int cpu);
 #else
 static inline int tegra_auto_hotplug_init(struct mutex *cpu_lock)
 { return 0; }
@@ -65,6 +69,8 @@ static inline void tegra_auto_hotplug_exit(void)
 static inline void tegra_auto_hotplug_governor(unsigned int cpu_freq,
 					       bool suspend)
 { }
+static inline bool tegra_cpu_is_parked(unsigned int cpu)
+{ return false; }
 #endif
 
 #ifdef CONFIG_TEGRA_EDP_LIMITS
@@ -0,0 +1,183 @@
+/*
+ * arch/arm/mach-tegra/cpu-tegra3-policy.h
+ *
+ * Tegra3 auto-hotplug decision policy
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * Pure functions of their arguments, with no dependency on clocks, PM QoS
+ * or the EDP tables: cpu-tegra3.c gathers a tegra_hp_sample from the live
+ * system, tools/power/tegra/policy-replay builds one from a recorded trace.
+ * This header includes nothing; the includer provides bool.
+ */
+
+#ifndef __MACH_TEGRA_CPU_TEGRA3_POLICY_H
+#define __MACH_TEGRA_CPU_TEGRA3_POLICY_H
+
+enum {
+	TEGRA_HP_DISABLED = 0,
+	TEGRA_HP_IDLE,
+	TEGRA_HP_DOWN,
+	TEGRA_HP_UP,
+};
+
+enum {
+	TEGRA_CPU_SPEED_BALANCED,
+	TEGRA_CPU_SPEED_BIASED,
+	TEGRA_CPU_SPEED_SKEWED,
+};
+
+/* fixed point of avg_nr_running() and of the nr_run thresholds */
+#define TEGRA_HP_FSHIFT		11
+#define TEGRA_HP_NR_FSHIFT	2
+
+struct tegra_hp_policy {
+	unsigned int idle_bottom_freq;
+	int balance_level;
+	const unsigned int *nr_run_thresholds;
+	unsigned int nr_run_levels;
+	unsigned int nr_run_hysteresis;
+};
+
+struct tegra_hp_sample {
+	unsigned long highest_speed;	/* highest per-cpu target, kHz */
+	unsigned int nr_cpus;		/* active (on-line, not parked) */
+	unsigned int min_cpus;
+	unsigned int max_cpus;
+	unsigned int slow_balanced;	/* targets <= balanced speed */
+	unsigned int slow_skewed;	/* targets <= skewed speed */
+	bool edp_favor_up;
+	bool edp_favor_down;
+	unsigned int nr_run;		/* from tegra_hp_nr_run_target() */
+};
+
+/* Per-cpu target speeds at or below which a core counts as slow */
+static inline unsigned long tegra_hp_balanced_speed(
+	const struct tegra_hp_policy *p, unsigned long highest_speed)
+{
+	return highest_speed * p->balance_level / 100;
+}
+
+static inline unsigned long tegra_hp_skewed_speed(
+	const struct tegra_hp_policy *p, unsigned long highest_speed)
+{
+	return tegra_hp_balanced_speed(p, highest_speed) / 2;
+}
+
+/* balanced: freq targets for all CPUs are above 50% of highest speed
+   biased: freq target for at least one CPU is below 50% threshold
+   skewed: freq targets for at least 2 CPUs are below 25% threshold */
+static inline int tegra_hp_speed_balance(const struct tegra_hp_policy *p,
+					 const struct tegra_hp_sample *s)
+{
+	if (((s->slow_skewed >= 2) || s->edp_favor_down ||
+	     (s->highest_speed <= p->idle_bottom_freq) ||
+	     (s->nr_cpus > s->max_cpus)) &&
+	    (s->nr_cpus > s->min_cpus))
+		return TEGRA_CPU_SPEED_SKEWED;
+
+	if (((s->slow_balanced >= 1) || !s->edp_favor_up ||
+	     (s->highest_speed <= p->idle_bottom_freq) ||
+	     (s->nr_cpus == s->max_cpus)) &&
+	    (s->nr_cpus >= s->min_cpus))
+		return TEGRA_CPU_SPEED_BIASED;
+
+	return TEGRA_CPU_SPEED_BALANCED;
+}
+
+/* Number of cores needed to run the average runnable thread count, with
+   hysteresis around the previous target (*last) in both directions */
+static inline unsigned int tegra_hp_nr_run_target(
+	const struct tegra_hp_policy *p, unsigned long avg_nr_run,
+	unsigned int *last)
+{
+	unsigned int nr_run;
+
+	for (nr_run = 1; nr_run < p->nr_run_levels; nr_run++) {
+		unsigned int nr_threshold = p->nr_run_thresholds[nr_run - 1];
+
+		if (nr_run >= *last)
+			nr_threshold += p->nr_run_hysteresis;
+		else if (nr_threshold > p->nr_run_hysteresis)
+			nr_threshold -= p->nr_run_hysteresis;
+
+		if (avg_nr_run <= ((unsigned long)nr_threshold <<
+				   (TEGRA_HP_FSHIFT - TEGRA_HP_NR_FSHIFT)))
+			break;
+	}
+	*last = nr_run;
+	return nr_run;
+}
+
+static inline int tegra_hp_nr_run_balance(const struct tegra_hp_policy *p,
+					  const struct tegra_hp_sample *s)
+{
+	/* more cores than runnable threads - remove one core */
+	if (((s->nr_run < s->nr_cpus) || s->edp_favor_down ||
+	     (s->highest_speed <= p->idle_bottom_freq) ||
+	     (s->nr_cpus > s->max_cpus)) &&
+	    (s->nr_cpus > s->min_cpus))
+		return TEGRA_CPU_SPEED_SKEWED;
+
+	/* more runnable threads than cores - one more on-line, regardless
+	   of how the per-CPU frequency targets are spread */
+	if (((s->nr_run > s->nr_cpus) && (s->nr_cpus < s->max_cpus) &&
+	     s->edp_favor_up) ||
+	    (s->nr_cpus < s->min_cpus))
+		return TEGRA_CPU_SPEED_BALANCED;
+
+	/* thread demand matches core count - frequency targets may still
+	   show a skewed load, but never justify a core nobody will run on */
+	if (tegra_hp_speed_balance(p, s) == TEGRA_CPU_SPEED_SKEWED)
+		return TEGRA_CPU_SPEED_SKEWED;
+
+	return TEGRA_CPU_SPEED_BIASED;
+}
+
+/*
+ * Hotplug governor state for a new cpu rate, given the window of the
+ * current cluster. The hotplug work has to be (re)queued whenever the
+ * state changes to TEGRA_HP_UP or TEGRA_HP_DOWN.
+ */
+static inline int tegra_hp_next_state(int state, unsigned int cpu_freq,
+				      unsigned long top_freq,
+				      unsigned long bottom_freq)
+{
+	switch (state) {
+	case TEGRA_HP_IDLE:
+		if (cpu_freq > top_freq)
+			return TEGRA_HP_UP;
+		if (cpu_freq <= bottom_freq)
+			return TEGRA_HP_DOWN;
+		break;
+	case TEGRA_HP_DOWN:
+		if (cpu_freq > top_freq)
+			return TEGRA_HP_UP;
+		if (cpu_freq > bottom_freq)
+			return TEGRA_HP_IDLE;
+		break;
+	case TEGRA_HP_UP:
+		if (cpu_freq <= bottom_freq)
+			return TEGRA_HP_DOWN;
+		if (cpu_freq <= top_freq)
+			return TEGRA_HP_IDLE;
+		break;
+	}
+	return state;
+}
+
+#endif /* __MACH_TEGRA_CPU_TEGRA3_POLICY_H */
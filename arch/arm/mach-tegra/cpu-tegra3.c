@@ -36,12 +36,17 @@
 
 #include "pm.h"
 #include "cpu-tegra.h"
+#include "cpu-tegra3-policy.h"
+#include "power-model.h"
 #include "clock.h"
+#include "dvfs.h"
 
 #define INITIAL_STATE		TEGRA_HP_DISABLED
 #define UP2G0_DELAY_MS		70
 #define UP2Gn_DELAY_MS		100
 #define DOWN_DELAY_MS		2000
+#define PARK_UNPLUG_DELAY_MS	5000
+#define CLUSTER_RESIDENCY_MS	100
 
 static struct mutex *tegra3_cpu_lock;
 
@@ -69,6 +74,62 @@ module_param(mp_overhead, int, 0644);
 static int balance_level = 75;
 module_param(balance_level, int, 0644);
 
+static bool rq_balance = true;
+module_param(rq_balance, bool, 0644);
+
+/* Average runnable threads (in 1/4 thread units, TEGRA_HP_NR_FSHIFT)
+   that one, two, three and four on-line cores can absorb */
+static unsigned int nr_run_thresholds[] = {
+/*	1,  2,  3,  4 - on-line cpus target */
+	5,  9, 13, UINT_MAX
+};
+static unsigned int nr_run_hysteresis = 2;	/* 0.5 thread */
+module_param(nr_run_hysteresis, uint, 0644);
+static unsigned int nr_run_last;
+
+/* Parked cores stay on-line, but are left alone in LP2 by cpuidle; only
+   cores parked for longer than park_unplug_delay are actually unplugged.
+   A parked core is still schedulable: once the scheduler keeps more than
+   park_busy_nr_run threads (1/4 thread units) on it, it is taken back */
+static bool core_park = true;
+module_param(core_park, bool, 0644);
+
+static unsigned long park_unplug_delay;
+module_param(park_unplug_delay, ulong, 0644);
+
+static unsigned int park_busy_nr_run = 1;	/* 0.25 thread */
+module_param(park_busy_nr_run, uint, 0644);
+
+static struct cpumask parked_cpus;
+static unsigned long park_time[CONFIG_NR_CPUS];
+static struct {
+	unsigned int park_count;
+	unsigned int unpark_count;
+	unsigned int unplug_count;
+} park_stats[CONFIG_NR_CPUS];
+
+/* Pick the LP/G switch rates from the power model in power-model.h */
+static bool energy_model = true;
+module_param(energy_model, bool, 0644);
+
+static unsigned int em_lp_top_freq;	/* LP is cheaper up to this rate */
+static unsigned int em_g_bottom_freq;	/* G down to LP at/below this rate */
+
+static unsigned long cluster_residency;
+module_param(cluster_residency, ulong, 0644);
+static unsigned long last_cluster_switch;
+
+enum {
+	CLUSTER_SWITCH_TO_LP = 0,
+	CLUSTER_SWITCH_TO_G,
+};
+static struct {
+	unsigned int count;
+	unsigned int fail_count;
+	u64 total_us;
+	u64 max_us;
+} cluster_switch_stats[2];
+
 static struct clk *cpu_clk;
 static struct clk *cpu_g_clk;
 static struct clk *cpu_lp_clk;
@@ -100,6 +161,66 @@ static void hp_init_stats(void)
 
 }
 
+bool tegra_cpu_is_parked(unsigned int cpu)
+{
+	return cpumask_test_cpu(cpu, &parked_cpus);
+}
+
+/* On-line cores the scheduler is expected to use, i.e. not parked */
+static unsigned int tegra_cpu_active_count(void)
+{
+	struct cpumask parked;
+
+	cpumask_and(&parked, &parked_cpus, cpu_online_mask);
+	return num_online_cpus() - cpumask_weight(&parked);
+}
+
+static void tegra_cpu_park(unsigned int cpu)
+{
+	cpumask_set_cpu(cpu, &parked_cpus);
+	park_time[cpu] = jiffies;
+	park_stats[cpu].park_count++;
+}
+
+static void tegra_cpu_unpark(unsigned int cpu)
+{
+	cpumask_clear_cpu(cpu, &parked_cpus);
+	park_stats[cpu].unpark_count++;
+}
+
+/* Take back parked cores the scheduler has been running work on, so they
+   count when balancing again */
+static void tegra_unpark_busy_cpus(void)
+{
+	unsigned long nr_run;
+	unsigned int cpu;
+
+	for_each_cpu(cpu, &parked_cpus) {
+		if (!cpu_online(cpu))
+			continue;
+		nr_run = avg_nr_running_cpu(cpu) >>
+			(TEGRA_HP_FSHIFT - TEGRA_HP_NR_FSHIFT);
+		if (nr_run > park_busy_nr_run)
+			tegra_cpu_unpark(cpu);
+	}
+}
+
+/* Parked core that has been idle long enough to be worth unplugging */
+static unsigned int tegra_get_expired_parked_cpu(void)
+{
+	unsigned int cpu;
+
+	for_each_cpu(cpu, &parked_cpus) {
+		if (!cpu_online(cpu)) {
+			cpumask_clear_cpu(cpu, &parked_cpus);
+			continue;
+		}
+		if (time_after_eq(jiffies, park_time[cpu] + park_unplug_delay))
+			return cpu;
+	}
+	return nr_cpu_ids;
+}
+
 static void hp_stats_update(unsigned int cpu, bool up)
 {
 	u64 cur_jiffies = get_jiffies_64();
@@ -123,13 +244,90 @@ static void hp_stats_update(unsigned int cpu, bool up)
 	hp_stats[cpu].last_update = cur_jiffies;
 }
 
+/* Energy per cycle (pJ) running at rate kHz on the given cluster, at
+   the voltage its rail needs for that rate. G cannot run below its
+   minimum rate, so slower loads race to idle there */
+static u64 em_energy(struct clk *c, bool lp, unsigned int rate)
+{
+	unsigned long min_rate = clk_get_min_rate(c) / 1000;
+	int mv;
+
+	rate = max_t(unsigned int, rate, min_rate);
+	mv = tegra_dvfs_predict_millivolts(c, rate * 1000);
+	if ((mv <= 0) && c->dvfs && c->dvfs->dvfs_rail)
+		mv = c->dvfs->dvfs_rail->nominal_millivolts;
+	if (mv <= 0)
+		mv = 1000;
+
+	return tegra_energy_per_cycle_pj(lp, rate, mv);
+}
+
+/* Find where G becomes cheaper than LP in the cpufreq table, and derive
+   the LP to G and G to LP switch rates from it */
+static void em_init(void)
+{
+	struct tegra_cpufreq_table_data *table_data = tegra_cpufreq_table_get();
+	struct cpufreq_frequency_table *table;
+	unsigned int lp_top = 0;
+	int i;
+
+	if (IS_ERR_OR_NULL(table_data))
+		goto no_model;
+
+	table = table_data->freq_table;
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		unsigned int f = table[i].frequency;
+
+		if ((f == CPUFREQ_ENTRY_INVALID) || (f > idle_top_freq))
+			continue;
+		if (em_energy(cpu_g_clk, false, f) <=
+		    em_energy(cpu_lp_clk, true, f))
+			break;
+		lp_top = f;
+	}
+	if (!lp_top)
+		goto no_model;
+
+	em_lp_top_freq = lp_top;
+	em_g_bottom_freq = max(lp_top, idle_bottom_freq);
+	return;
+
+no_model:
+	em_lp_top_freq = idle_top_freq;
+	em_g_bottom_freq = idle_bottom_freq;
+}
+
+static bool cluster_residency_expired(void)
+{
+	return time_after_eq(jiffies, last_cluster_switch + cluster_residency);
+}
+
+/* Switch CPU complex to LP or G cluster, and account for the switch */
+static int tegra_cluster_switch(bool to_lp)
+{
+	int ret;
+	u64 us;
+	ktime_t start = ktime_get();
+	int dir = to_lp ? CLUSTER_SWITCH_TO_LP : CLUSTER_SWITCH_TO_G;
+
+	ret = clk_set_parent(cpu_clk, to_lp ? cpu_lp_clk : cpu_g_clk);
+	if (ret) {
+		cluster_switch_stats[dir].fail_count++;
+		return ret;
+	}
+
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	cluster_switch_stats[dir].count++;
+	cluster_switch_stats[dir].total_us += us;
+	cluster_switch_stats[dir].max_us =
+		max(cluster_switch_stats[dir].max_us, us);
+	last_cluster_switch = jiffies;
+
+	hp_stats_update(CONFIG_NR_CPUS, to_lp);
+	hp_stats_update(0, !to_lp);
+	return 0;
+}
 
-enum {
-	TEGRA_HP_DISABLED = 0,
-	TEGRA_HP_IDLE,
-	TEGRA_HP_DOWN,
-	TEGRA_HP_UP,
-};
 static int hp_state;
 
 static int hp_state_set(const char *arg, const struct kernel_param *kp)
@@ -147,9 +345,10 @@ static int hp_state_set(const char *arg, const struct kernel_param *kp)
 
 	if (ret == 0) {
 		if ((hp_state == TEGRA_HP_DISABLED) &&
-		    (old_state != TEGRA_HP_DISABLED))
+		    (old_state != TEGRA_HP_DISABLED)) {
 			pr_info("Tegra auto-hotplug disabled\n");
-		else if (hp_state != TEGRA_HP_DISABLED) {
+			cpumask_clear(&parked_cpus);
+		} else if (hp_state != TEGRA_HP_DISABLED) {
 			if (old_state == TEGRA_HP_DISABLED) {
 				pr_info("Tegra auto-hotplug enabled\n");
 				hp_init_stats();
@@ -177,38 +376,73 @@ static struct kernel_param_ops tegra_hp_state_ops = {
 module_param_cb(auto_hotplug, &tegra_hp_state_ops, &hp_state, 0644);
 
 
-enum {
-	TEGRA_CPU_SPEED_BALANCED,
-	TEGRA_CPU_SPEED_BIASED,
-	TEGRA_CPU_SPEED_SKEWED,
-};
+static void tegra_hp_get_policy(struct tegra_hp_policy *p)
+{
+	p->idle_bottom_freq = idle_bottom_freq;
+	p->balance_level = balance_level;
+	p->nr_run_thresholds = nr_run_thresholds;
+	p->nr_run_levels = ARRAY_SIZE(nr_run_thresholds);
+	p->nr_run_hysteresis = nr_run_hysteresis;
+}
+
+/* Snapshot of everything the balance decisions look at */
+static void tegra_hp_get_sample(const struct tegra_hp_policy *p,
+				struct tegra_hp_sample *s)
+{
+	s->highest_speed = tegra_cpu_highest_speed();
+	s->nr_cpus = tegra_cpu_active_count();
+	s->max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : 4;
+	s->min_cpus = pm_qos_request(PM_QOS_MIN_ONLINE_CPUS);
+	s->slow_balanced = tegra_count_slow_cpus(
+		tegra_hp_balanced_speed(p, s->highest_speed));
+	s->slow_skewed = tegra_count_slow_cpus(
+		tegra_hp_skewed_speed(p, s->highest_speed));
+	s->edp_favor_up = tegra_cpu_edp_favor_up(s->nr_cpus, mp_overhead);
+	s->edp_favor_down = tegra_cpu_edp_favor_down(s->nr_cpus, mp_overhead);
+	s->nr_run = nr_run_last;
+}
 
 static noinline int tegra_cpu_speed_balance(void)
 {
-	unsigned long highest_speed = tegra_cpu_highest_speed();
-	unsigned long balanced_speed = highest_speed * balance_level / 100;
-	unsigned long skewed_speed = balanced_speed / 2;
-	unsigned int nr_cpus = num_online_cpus();
-	unsigned int max_cpus = pm_qos_request(PM_QOS_MAX_ONLINE_CPUS) ? : 4;
-	unsigned int min_cpus = pm_qos_request(PM_QOS_MIN_ONLINE_CPUS);
-
-	/* balanced: freq targets for all CPUs are above 50% of highest speed
-	   biased: freq target for at least one CPU is below 50% threshold
-	   skewed: freq targets for at least 2 CPUs are below 25% threshold */
-	if (((tegra_count_slow_cpus(skewed_speed) >= 2) ||
-	     tegra_cpu_edp_favor_down(nr_cpus, mp_overhead) ||
-	     (highest_speed <= idle_bottom_freq) || (nr_cpus > max_cpus)) &&
-	    (nr_cpus > min_cpus))
-		return TEGRA_CPU_SPEED_SKEWED;
-
-	if (((tegra_count_slow_cpus(balanced_speed) >= 1) ||
-	     (!tegra_cpu_edp_favor_up(nr_cpus, mp_overhead)) ||
-	     (highest_speed <= idle_bottom_freq) || (nr_cpus == max_cpus)) &&
-	    (nr_cpus >= min_cpus))
-		return TEGRA_CPU_SPEED_BIASED;
-
-	return TEGRA_CPU_SPEED_BALANCED;
+	struct tegra_hp_policy p;
+	struct tegra_hp_sample s;
+
+	tegra_hp_get_policy(&p);
+	tegra_hp_get_sample(&p, &s);
+	return tegra_hp_speed_balance(&p, &s);
 }
+
+static noinline int tegra_cpu_nr_run_balance(void)
+{
+	struct tegra_hp_policy p;
+	struct tegra_hp_sample s;
+
+	tegra_hp_get_policy(&p);
+	tegra_hp_get_sample(&p, &s);
+	s.nr_run = tegra_hp_nr_run_target(&p, avg_nr_running(), &nr_run_last);
+	return tegra_hp_nr_run_balance(&p, &s);
+}
+
+/* On-line, not parked non-boot CPU with the fewest runnable threads on
+   average */
+static unsigned int tegra_get_idlest_cpu_n(void)
+{
+	unsigned int cpu = nr_cpu_ids;
+	unsigned long min_nr_run = ULONG_MAX;
+	int i;
+
+	for_each_online_cpu(i) {
+		unsigned long nr_run = avg_nr_running_cpu(i);
+
+		if ((i > 0) && !tegra_cpu_is_parked(i) &&
+		    (nr_run <= min_nr_run)) {
+			cpu = i;
+			min_nr_run = nr_run;
+		}
+	}
+	return cpu;
+}
+
 void disable_auto_hotplug(void)
 {
 	hp_state=TEGRA_HP_DISABLED;
@@ -228,14 +462,16 @@ static void tegra_auto_hotplug_work_func(struct work_struct *work)
 	case TEGRA_HP_IDLE:
 		break;
 	case TEGRA_HP_DOWN:
-		cpu = tegra_get_slowest_cpu_n();
+		/* parked cores are idle - unplug them first */
+		cpu = cpumask_first_and(&parked_cpus, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = tegra_get_slowest_cpu_n();
 		if (cpu < nr_cpu_ids) {
 			up = false;
 		} else if (!is_lp_cluster() && !no_lp &&
-			   !pm_qos_request(PM_QOS_MIN_ONLINE_CPUS)) {
-			if(!clk_set_parent(cpu_clk, cpu_lp_clk)) {
-				hp_stats_update(CONFIG_NR_CPUS, true);
-				hp_stats_update(0, false);
+			   !pm_qos_request(PM_QOS_MIN_ONLINE_CPUS) &&
+			   cluster_residency_expired()) {
+			if (!tegra_cluster_switch(true)) {
 				/* catch-up with governor target speed */
 				tegra_cpu_set_speed_cap(NULL);
 				break;
@@ -246,23 +482,31 @@ static void tegra_auto_hotplug_work_func(struct work_struct *work)
 		break;
 	case TEGRA_HP_UP:
 		if (is_lp_cluster() && !no_lp) {
-			if(!clk_set_parent(cpu_clk, cpu_g_clk)) {
-				hp_stats_update(CONFIG_NR_CPUS, false);
-				hp_stats_update(0, true);
+			if (cluster_residency_expired() &&
+			    !tegra_cluster_switch(false)) {
 				/* catch-up with governor target speed */
 				tegra_cpu_set_speed_cap(NULL);
 			}
 		} else {
-			switch (tegra_cpu_speed_balance()) {
-			/* cpu speed is up and balanced - one more on-line */
+			tegra_unpark_busy_cpus();
+			switch (rq_balance ? tegra_cpu_nr_run_balance() :
+					     tegra_cpu_speed_balance()) {
+			/* cpu speed is up and balanced - one more on-line,
+			   parked cores first */
 			case TEGRA_CPU_SPEED_BALANCED:
-				cpu = cpumask_next_zero(0, cpu_online_mask);
+				cpu = cpumask_first_and(
+					&parked_cpus, cpu_online_mask);
+				if (cpu >= nr_cpu_ids)
+					cpu = cpumask_next_zero(
+						0, cpu_online_mask);
 				if (cpu < nr_cpu_ids)
 					up = true;
 				break;
 			/* cpu speed is up, but skewed - remove one core */
 			case TEGRA_CPU_SPEED_SKEWED:
-				cpu = tegra_get_slowest_cpu_n();
+				cpu = (rq_balance || core_park) ?
+					tegra_get_idlest_cpu_n() :
+					tegra_get_slowest_cpu_n();
 				if (cpu < nr_cpu_ids)
 					up = false;
 				break;
@@ -272,8 +516,11 @@ static void tegra_auto_hotplug_work_func(struct work_struct *work)
 				break;
 			}
 		}
-		queue_delayed_work(
-			hotplug_wq, &hotplug_work, up2gn_delay);
+		/* keep going without delay until min cpus request is met */
+		queue_delayed_work(hotplug_wq, &hotplug_work,
+			(up && (tegra_cpu_active_count() + 1 <
+				pm_qos_request(PM_QOS_MIN_ONLINE_CPUS))) ?
+			0 : up2gn_delay);
 		break;
 	default:
 		pr_err("%s: invalid tegra hotplug state %d\n",
@@ -285,7 +532,31 @@ static void tegra_auto_hotplug_work_func(struct work_struct *work)
 
 	if (cpu < nr_cpu_ids) {
 		last_change_time = now;
-		hp_stats_update(cpu, up);
+		if (up && tegra_cpu_is_parked(cpu)) {
+			/* already on-line - just let scheduler have it back */
+			tegra_cpu_unpark(cpu);
+			cpu = nr_cpu_ids;
+		} else if (!up && core_park && (hp_state == TEGRA_HP_UP)) {
+			tegra_cpu_park(cpu);
+			cpu = nr_cpu_ids;
+		} else {
+			if (!up && tegra_cpu_is_parked(cpu)) {
+				cpumask_clear_cpu(cpu, &parked_cpus);
+				park_stats[cpu].unplug_count++;
+			}
+			hp_stats_update(cpu, up);
+		}
+	}
+
+	/* parked for long enough - unplug for real */
+	if ((cpu >= nr_cpu_ids) && (hp_state != TEGRA_HP_DISABLED)) {
+		cpu = tegra_get_expired_parked_cpu();
+		if (cpu < nr_cpu_ids) {
+			up = false;
+			cpumask_clear_cpu(cpu, &parked_cpus);
+			park_stats[cpu].unplug_count++;
+			hp_stats_update(cpu, false);
+		}
 	}
 	mutex_unlock(tegra3_cpu_lock);
 
@@ -311,14 +582,23 @@ static int min_cpus_notify(struct notifier_block *nb, unsigned long n, void *p)
 		unsigned int speed = max(
 			tegra_getspeed(0), clk_get_min_rate(cpu_g_clk) / 1000);
 		tegra_update_cpu_speed(speed);
-
-		if (!clk_set_parent(cpu_clk, cpu_g_clk)) {
-			hp_stats_update(CONFIG_NR_CPUS, false);
-			hp_stats_update(0, true);
-		}
+		tegra_cluster_switch(false);
 	}
+
+	/* parked cores are on-line already - hand them back right away */
+	while ((tegra_cpu_active_count() < n) &&
+	       (cpumask_first_and(&parked_cpus, cpu_online_mask) < nr_cpu_ids))
+		tegra_cpu_unpark(cpumask_first_and(&parked_cpus,
+						   cpu_online_mask));
+
 	/* update governor state machine */
 	tegra_cpu_set_speed_cap(NULL);
+
+	/* more cores to bring on-line - do not wait for next sample */
+	if ((hp_state == TEGRA_HP_UP) && (tegra_cpu_active_count() < n)) {
+		cancel_delayed_work(&hotplug_work);
+		queue_delayed_work(hotplug_wq, &hotplug_work, 0);
+	}
 	mutex_unlock(tegra3_cpu_lock);
 	return NOTIFY_OK;
 }
@@ -330,6 +610,7 @@ static struct notifier_block min_cpus_notifier = {
 void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 {
 	unsigned long up_delay, top_freq, bottom_freq;
+	int state;
 
 	if (!is_g_cluster_present())
 		return;
@@ -341,23 +622,19 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 		hp_state = TEGRA_HP_IDLE;
 
 		/* Switch to G-mode if suspend rate is high enough */
-		if (is_lp_cluster() && (cpu_freq >= idle_bottom_freq)) {
-			if (!clk_set_parent(cpu_clk, cpu_g_clk)) {
-				hp_stats_update(CONFIG_NR_CPUS, false);
-				hp_stats_update(0, true);
-			}
-		}
+		if (is_lp_cluster() && (cpu_freq >= idle_bottom_freq))
+			tegra_cluster_switch(false);
 		return;
 	}
 
 	if (is_lp_cluster()) {
 		up_delay = up2g0_delay;
-		top_freq = idle_top_freq;
+		top_freq = energy_model ? em_lp_top_freq : idle_top_freq;
 		bottom_freq = 0;
 	} else {
 		up_delay = up2gn_delay;
-		top_freq = idle_bottom_freq;
-		bottom_freq = idle_bottom_freq;
+		top_freq = energy_model ? em_g_bottom_freq : idle_bottom_freq;
+		bottom_freq = top_freq;
 	}
 
 	if (pm_qos_request(PM_QOS_MIN_ONLINE_CPUS) >= 2) {
@@ -369,45 +646,22 @@ void tegra_auto_hotplug_governor(unsigned int cpu_freq, bool suspend)
 		return;
 	}
 
-	switch (hp_state) {
-	case TEGRA_HP_IDLE:
-		if (cpu_freq > top_freq) {
-			hp_state = TEGRA_HP_UP;
-			queue_delayed_work(
-				hotplug_wq, &hotplug_work, up_delay);
-		} else if (cpu_freq <= bottom_freq) {
-			hp_state = TEGRA_HP_DOWN;
-			queue_delayed_work(
-				hotplug_wq, &hotplug_work, down_delay);
-		}
-		break;
-	case TEGRA_HP_DOWN:
-		if (cpu_freq > top_freq) {
-			hp_state = TEGRA_HP_UP;
-			queue_delayed_work(
-				hotplug_wq, &hotplug_work, up_delay);
-		} else if (cpu_freq > bottom_freq) {
-			hp_state = TEGRA_HP_IDLE;
-		}
-		break;
-	case TEGRA_HP_UP:
-		if (cpu_freq <= bottom_freq) {
-			hp_state = TEGRA_HP_DOWN;
-			queue_delayed_work(
-				hotplug_wq, &hotplug_work, down_delay);
-		} else if (cpu_freq <= top_freq) {
-			hp_state = TEGRA_HP_IDLE;
-		}
-		break;
-	default:
-		pr_err("%s: invalid tegra hotplug state %d\n",
-		       __func__, hp_state);
-		BUG();
-	}
+	state = tegra_hp_next_state(hp_state, cpu_freq, top_freq, bottom_freq);
+	if (state == hp_state)
+		return;
+
+	hp_state = state;
+	if (state == TEGRA_HP_UP)
+		queue_delayed_work(hotplug_wq, &hotplug_work, up_delay);
+	else if (state == TEGRA_HP_DOWN)
+		queue_delayed_work(hotplug_wq, &hotplug_work, down_delay);
 }
 
 int tegra_auto_hotplug_init(struct mutex *cpu_lock)
 {
+	/* the policy header cannot include sched.h for FSHIFT */
+	BUILD_BUG_ON(TEGRA_HP_FSHIFT != FSHIFT);
+
 	/*
 	 * Not bound to the issuer CPU (=> high-priority), has rescue worker
 	 * task, single-threaded, freezable.
@@ -430,6 +684,10 @@ int tegra_auto_hotplug_init(struct mutex *cpu_lock)
 	up2g0_delay = msecs_to_jiffies(UP2G0_DELAY_MS);
 	up2gn_delay = msecs_to_jiffies(UP2Gn_DELAY_MS);
 	down_delay = msecs_to_jiffies(DOWN_DELAY_MS);
+	park_unplug_delay = msecs_to_jiffies(PARK_UNPLUG_DELAY_MS);
+	cluster_residency = msecs_to_jiffies(CLUSTER_RESIDENCY_MS);
+	last_cluster_switch = jiffies;
+	em_init();
 
 	tegra3_cpu_lock = cpu_lock;
 	hp_state = INITIAL_STATE;
@@ -484,6 +742,50 @@ static int hp_stats_show(struct seq_file *s, void *data)
 	}
 	seq_printf(s, "\n");
 
+	seq_printf(s, "%-15s ", "avg runnable:");
+	for (i = 0; i < CONFIG_NR_CPUS; i++) {
+		unsigned long nr_run = (i < nr_cpu_ids) && cpu_online(i) ?
+			avg_nr_running_cpu(i) : 0;
+		seq_printf(s, "%lu.%02lu%-6s ", nr_run >> FSHIFT,
+			   ((nr_run & (FIXED_1 - 1)) * 100) >> FSHIFT, "");
+	}
+	seq_printf(s, "target %u\n", nr_run_last);
+
+	seq_printf(s, "%-15s ", "parked:");
+	for (i = 0; i < CONFIG_NR_CPUS; i++)
+		seq_printf(s, "%-10s ", tegra_cpu_is_parked(i) ? "yes" : "no");
+	seq_printf(s, "\n");
+
+	seq_printf(s, "%-15s ", "park/unpark:");
+	for (i = 0; i < CONFIG_NR_CPUS; i++) {
+		char buf[16];
+		snprintf(buf, sizeof(buf), "%u/%u", park_stats[i].park_count,
+			 park_stats[i].unpark_count);
+		seq_printf(s, "%-10s ", buf);
+	}
+	seq_printf(s, "\n");
+
+	seq_printf(s, "%-15s ", "park unplugs:");
+	for (i = 0; i < CONFIG_NR_CPUS; i++)
+		seq_printf(s, "%-10u ", park_stats[i].unplug_count);
+	seq_printf(s, "\n");
+
+	seq_printf(s, "\n%-15s %-10s %-10s %-10s %-10s\n", "cluster switch:",
+		   "count", "failed", "avg (us)", "max (us)");
+	for (i = 0; i < ARRAY_SIZE(cluster_switch_stats); i++) {
+		unsigned int count = cluster_switch_stats[i].count;
+		seq_printf(s, "%-15s %-10u %-10u %-10llu %-10llu\n",
+			   i == CLUSTER_SWITCH_TO_LP ? "G to LP:" : "LP to G:",
+			   count, cluster_switch_stats[i].fail_count,
+			   count ? div_u64(cluster_switch_stats[i].total_us,
+					   count) : 0,
+			   cluster_switch_stats[i].max_us);
+	}
+	seq_printf(s, "%-15s %u/%u kHz\n", "LP/G switch at:",
+		   energy_model ? em_lp_top_freq : idle_top_freq,
+		   energy_model ? em_g_bottom_freq : idle_bottom_freq);
+	seq_printf(s, "\n");
+
 	seq_printf(s, "%-15s %llu\n", "time-stamp:",
 		   cputime64_to_clock_t(cur_jiffies));
 
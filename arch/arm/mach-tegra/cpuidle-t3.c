@@ -51,6 +51,7 @@
 #include <trace/events/power.h>
 
 #include "clock.h"
+#include "cpu-tegra.h"
 #include "cpuidle.h"
 #include "dvfs.h"
 #include "fuse.h"
@@ -76,6 +77,30 @@ module_param(lp2_0_in_idle, bool, 0644);
 static bool lp2_n_in_idle = true;
 module_param(lp2_n_in_idle, bool, 0644);
 
+/* LP2 entry predictor: LP2 is refused when too many of the recent idle
+   periods on this CPU ended before LP2 target residency (i.e. woken up
+   by interrupts rather than by the timer it was set for); CPU0 rail-off
+   is more expensive and uses the stricter limit */
+#define LP2_HISTORY_LEN		8
+
+static bool lp2_predict = true;
+module_param(lp2_predict, bool, 0644);
+
+static unsigned int lp2_short_max = 4;
+module_param(lp2_short_max, uint, 0644);
+
+static unsigned int rail_off_short_max = 2;
+module_param(rail_off_short_max, uint, 0644);
+
+static struct {
+	unsigned int idle_us[LP2_HISTORY_LEN];
+	unsigned int next;
+	unsigned int target_residency;
+	s64 request;
+	bool denied;
+	bool entered;
+} lp2_history[5];
+
 static struct clk *cpu_clk_for_dvfs;
 static struct clk *twd_clk;
 
@@ -84,12 +109,17 @@ static int lp2_exit_latencies[5];
 static struct {
 	unsigned int cpu_ready_count[5];
 	unsigned int tear_down_count[5];
+	unsigned int parked_count[5];
 	unsigned long long cpu_wants_lp2_time[5];
 	unsigned long long in_lp2_time[5];
 	unsigned int lp2_count;
 	unsigned int lp2_completed_count;
 	unsigned int lp2_count_bin[32];
 	unsigned int lp2_completed_count_bin[32];
+	unsigned int lp2_short_count_bin[32];
+	unsigned int lp2_missed_count_bin[32];
+	unsigned int lp2_short_count;
+	unsigned int lp2_missed_count;
 	unsigned int lp2_int_count[NR_IRQS];
 	unsigned int last_lp2_int_count[NR_IRQS];
 } idle_stats;
@@ -115,9 +145,67 @@ void tegra3_cpu_idle_stats_lp2_ready(unsigned int cpu)
 	idle_stats.cpu_ready_count[cpu_number(cpu)]++;
 }
 
+/* Record actual idle time, and count predictions that turned out wrong:
+   LP2 entered for an idle period shorter than its target residency, or
+   LP2 refused by predictor for an idle period that would have fit it */
+static void tegra3_lp2_history_update(unsigned int cpu, s64 us)
+{
+	unsigned int n = cpu_number(cpu);
+	int bin;
+
+	lp2_history[n].idle_us[lp2_history[n].next] =
+		(unsigned int)min_t(s64, us, UINT_MAX);
+	lp2_history[n].next = (lp2_history[n].next + 1) % LP2_HISTORY_LEN;
+
+	bin = time_to_bin((u32)max_t(s64, lp2_history[n].request, 0) / 1000);
+	if (lp2_history[n].entered &&
+	    (us < lp2_history[n].target_residency)) {
+		idle_stats.lp2_short_count++;
+		idle_stats.lp2_short_count_bin[bin]++;
+	} else if (lp2_history[n].denied &&
+		   (us >= lp2_history[n].target_residency)) {
+		idle_stats.lp2_missed_count++;
+		idle_stats.lp2_missed_count_bin[bin]++;
+	}
+	lp2_history[n].entered = false;
+	lp2_history[n].denied = false;
+}
+
+static bool tegra3_lp2_predict(struct cpuidle_device *dev,
+			       struct cpuidle_state *state)
+{
+	unsigned int n = cpu_number(dev->cpu);
+	unsigned int short_max = lp2_short_max;
+	unsigned int short_count = 0;
+	int i;
+
+	if (!lp2_predict)
+		return true;
+
+	if ((dev->cpu == 0) && !is_lp_cluster())
+		short_max = min(short_max, rail_off_short_max);
+
+	/* I/O completion interrupts are likely to cut idle short */
+	if (nr_iowait_cpu(dev->cpu))
+		short_max /= 2;
+
+	for (i = 0; i < LP2_HISTORY_LEN; i++) {
+		if (lp2_history[n].idle_us[i] < state->target_residency)
+			short_count++;
+	}
+
+	return short_count <= short_max;
+}
+
 void tegra3_cpu_idle_stats_lp2_time(unsigned int cpu, s64 us)
 {
 	idle_stats.cpu_wants_lp2_time[cpu_number(cpu)] += us;
+	tegra3_lp2_history_update(cpu, us);
+}
+
+void tegra3_cpu_idle_stats_lp3_time(unsigned int cpu, s64 us)
+{
+	tegra3_lp2_history_update(cpu, us);
 }
 
 /* Allow rail off only if all secondary CPUs are power gated, and no
@@ -175,6 +263,15 @@ bool tegra3_lp2_is_allowed(struct cpuidle_device *dev,
 		return false;
 	}
 
+	lp2_history[cpu_number(dev->cpu)].request = request;
+	lp2_history[cpu_number(dev->cpu)].target_residency =
+		state->target_residency;
+	if (!tegra3_lp2_predict(dev, state)) {
+		/* Recent wake-ups say we will not stay long enough */
+		lp2_history[cpu_number(dev->cpu)].denied = true;
+		return false;
+	}
+
 	return true;
 }
 
@@ -276,6 +373,7 @@ static void tegra3_idle_enter_lp2_cpu_0(struct cpuidle_device *dev,
 
 	bin = time_to_bin((u32)request / 1000);
 	idle_stats.tear_down_count[cpu_number(dev->cpu)]++;
+	lp2_history[cpu_number(dev->cpu)].entered = true;
 	idle_stats.lp2_count++;
 	idle_stats.lp2_count_bin[bin]++;
 
@@ -369,6 +467,9 @@ static void tegra3_idle_enter_lp2_cpu_n(struct cpuidle_device *dev,
 	tegra_lp2_set_trigger(sleep_time);
 #endif
 	idle_stats.tear_down_count[cpu_number(dev->cpu)]++;
+	lp2_history[cpu_number(dev->cpu)].entered = true;
+	if (tegra_cpu_is_parked(dev->cpu))
+		idle_stats.parked_count[cpu_number(dev->cpu)]++;
 
 	trace_power_start(POWER_CSTATE, 2, dev->cpu);
 
@@ -439,6 +540,11 @@ int tegra3_cpudile_init_soc(void)
 	for (i = 0; i < ARRAY_SIZE(lp2_exit_latencies); i++)
 		lp2_exit_latencies[i] = tegra_lp2_exit_latency;
 
+	/* start optimistic, history fills in from the first idle periods */
+	for (i = 0; i < ARRAY_SIZE(lp2_history); i++)
+		memset(lp2_history[i].idle_us, 0xff,
+		       sizeof(lp2_history[i].idle_us));
+
 	return 0;
 }
 
@@ -461,11 +567,19 @@ int tegra3_lp2_debug_show(struct seq_file *s, void *data)
 		idle_stats.tear_down_count[2],
 		idle_stats.tear_down_count[3],
 		idle_stats.tear_down_count[4]);
+	seq_printf(s, "parked:                         %8u %8u %8u %8u %8u\n",
+		idle_stats.parked_count[0],
+		idle_stats.parked_count[1],
+		idle_stats.parked_count[2],
+		idle_stats.parked_count[3],
+		idle_stats.parked_count[4]);
 	seq_printf(s, "lp2:            %8u\n", idle_stats.lp2_count);
 	seq_printf(s, "lp2 completed:  %8u %7u%%\n",
 		idle_stats.lp2_completed_count,
 		idle_stats.lp2_completed_count * 100 /
 			(idle_stats.lp2_count ?: 1));
+	seq_printf(s, "lp2 too short:  %8u\n", idle_stats.lp2_short_count);
+	seq_printf(s, "lp2 missed:     %8u\n", idle_stats.lp2_missed_count);
 
 	seq_printf(s, "\n");
 	seq_printf(s, "cpu ready time:                 %8llu %8llu %8llu %8llu %8llu ms\n",
@@ -500,17 +614,22 @@ int tegra3_lp2_debug_show(struct seq_file *s, void *data)
 			idle_stats.cpu_wants_lp2_time[4]) : 0));
 	seq_printf(s, "\n");
 
-	seq_printf(s, "%19s %8s %8s %8s\n", "", "lp2", "comp", "%");
-	seq_printf(s, "-------------------------------------------------\n");
+	seq_printf(s, "%19s %8s %8s %8s %8s %8s\n",
+		"", "lp2", "comp", "%", "short", "missed");
+	seq_printf(s, "-------------------------------------------------------------------\n");
 	for (bin = 0; bin < 32; bin++) {
-		if (idle_stats.lp2_count_bin[bin] == 0)
+		if ((idle_stats.lp2_count_bin[bin] == 0) &&
+		    (idle_stats.lp2_short_count_bin[bin] == 0) &&
+		    (idle_stats.lp2_missed_count_bin[bin] == 0))
 			continue;
-		seq_printf(s, "%6u - %6u ms: %8u %8u %7u%%\n",
+		seq_printf(s, "%6u - %6u ms: %8u %8u %7u%% %8u %8u\n",
 			1 << (bin - 1), 1 << bin,
 			idle_stats.lp2_count_bin[bin],
 			idle_stats.lp2_completed_count_bin[bin],
 			idle_stats.lp2_completed_count_bin[bin] * 100 /
-				idle_stats.lp2_count_bin[bin]);
+				(idle_stats.lp2_count_bin[bin] ?: 1),
+			idle_stats.lp2_short_count_bin[bin],
+			idle_stats.lp2_missed_count_bin[bin]);
 	}
 
 	seq_printf(s, "\n");
@@ -42,6 +42,8 @@
 
 #include <trace/events/power.h>
 
+#include "cpu-tegra.h"
+#include "power-stats.h"
 #include "cpuidle.h"
 #include "pm.h"
 #include "sleep.h"
@@ -69,11 +71,13 @@ static int tegra_idle_enter_lp3(struct cpuidle_device *dev,
 	local_fiq_disable();
 
 	enter = ktime_get();
+	tegra_power_stats_idle(dev->cpu, TEGRA_POWER_LP3, enter);
 
 	tegra_cpu_wfi();
 
-	exit = ktime_sub(ktime_get(), enter);
-	us = ktime_to_us(exit);
+	exit = ktime_get();
+	tegra_power_stats_idle(dev->cpu, TEGRA_POWER_BUSY, exit);
+	us = ktime_to_us(ktime_sub(exit, enter));
 
 	local_fiq_enable();
 	local_irq_enable();
@@ -114,17 +118,21 @@ static int tegra_idle_enter_lp2(struct cpuidle_device *dev,
 	if (!lp2_in_idle || lp2_disabled_by_suspend ||
 	    !tegra_lp2_is_allowed(dev, state)) {
 		dev->last_state = &dev->states[0];
-		return tegra_idle_enter_lp3(dev, state);
+		us = tegra_idle_enter_lp3(dev, state);
+		tegra_cpu_idle_stats_lp3_time(dev->cpu, us);
+		return (int)us;
 	}
 
 	local_irq_disable();
 	enter = ktime_get();
+	tegra_power_stats_idle(dev->cpu, TEGRA_POWER_LP2, enter);
 
 	tegra_cpu_idle_stats_lp2_ready(dev->cpu);
 	tegra_idle_lp2(dev, state);
 
-	exit = ktime_sub(ktime_get(), enter);
-	us = ktime_to_us(exit);
+	exit = ktime_get();
+	tegra_power_stats_idle(dev->cpu, TEGRA_POWER_BUSY, exit);
+	us = ktime_to_us(ktime_sub(exit, enter));
 
 	local_irq_enable();
 
@@ -151,6 +159,13 @@ static int tegra_idle_prepare(struct cpuidle_device *dev)
 		dev->states[1].flags &= ~CPUIDLE_FLAG_IGNORE;
 	else
 		dev->states[1].flags |= CPUIDLE_FLAG_IGNORE;
+
+	/* Parked cores go straight for LP2 whatever the governor predicts;
+	   LP2 entry still falls back to LP3 if the next timer is too close */
+	if (lp2_in_idle && tegra_cpu_is_parked(dev->cpu))
+		dev->states[0].flags |= CPUIDLE_FLAG_IGNORE;
+	else
+		dev->states[0].flags &= ~CPUIDLE_FLAG_IGNORE;
 #endif
 
 	return 0;
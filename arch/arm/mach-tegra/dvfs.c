@@ -245,34 +245,74 @@ out:
 	return ret;
 }
 
+/* Recompute maximum voltage requested by clocks on the rail from scratch */
+static void dvfs_rail_scan_max(struct dvfs_rail *rail)
+{
+	struct dvfs *d;
+
+	rail->dvfs_max_millivolts = 0;
+	rail->dvfs_max_count = 0;
+
+	list_for_each_entry(d, &rail->dvfs, reg_node) {
+		if (d->cur_millivolts > rail->dvfs_max_millivolts) {
+			rail->dvfs_max_millivolts = d->cur_millivolts;
+			rail->dvfs_max_count = 1;
+		} else if (d->cur_millivolts == rail->dvfs_max_millivolts) {
+			rail->dvfs_max_count++;
+		}
+	}
+}
+
+/* Track maximum voltage requested by clocks on the rail incrementally;
+   the list is re-scanned only when the last clock at maximum goes down */
+static void dvfs_rail_track_max(struct dvfs_rail *rail, int old_mv, int new_mv)
+{
+	int max_mv = rail->dvfs_max_millivolts;
+
+	if (old_mv == new_mv)
+		return;
+
+	if (new_mv > max_mv) {
+		rail->dvfs_max_millivolts = new_mv;
+		rail->dvfs_max_count = 1;
+	} else if (new_mv == max_mv) {
+		rail->dvfs_max_count++;
+	} else if (old_mv == max_mv) {
+		if (--rail->dvfs_max_count <= 0)
+			dvfs_rail_scan_max(rail);
+	}
+}
+
 /* Determine the minimum valid voltage for a rail, taking into account
  * the dvfs clocks and any rails that this rail depends on.  Calls
  * dvfs_rail_set_voltage with the new voltage, which will call
  * dvfs_rail_update on any rails that depend on this rail. */
 static int dvfs_rail_update(struct dvfs_rail *rail)
 {
-	int millivolts = 0;
-	struct dvfs *d;
+	int millivolts;
 	struct dvfs_relationship *rel;
 	int ret = 0;
 	int steps;
 
 	/* if dvfs is suspended, return and handle it during resume */
-	if (rail->suspended)
+	if (rail->suspended) {
+		rail->in_sync = false;
 		return 0;
+	}
 
 	/* if regulators are not connected yet, return and handle it later */
-	if (!rail->reg)
+	if (!rail->reg) {
+		rail->in_sync = false;
 		return 0;
+	}
 
 	/* if rail update is entered while resolving circular dependencies,
 	   abort recursion */
 	if (rail->resolving_to)
 		return 0;
 
-	/* Find the maximum voltage requested by any clock */
-	list_for_each_entry(d, &rail->dvfs, reg_node)
-		millivolts = max(d->cur_millivolts, millivolts);
+	/* Maximum voltage requested by any clock is tracked on rate change */
+	millivolts = rail->dvfs_max_millivolts;
 
 	/* retry update if limited by from-relationship to account for
 	   circular dependencies */
@@ -290,6 +330,7 @@ static int dvfs_rail_update(struct dvfs_rail *rail)
 		ret = dvfs_rail_set_voltage(rail, rail->new_millivolts);
 	}
 
+	rail->in_sync = !ret && (rail->new_millivolts == rail->millivolts);
 	return ret;
 }
 
@@ -331,6 +372,9 @@ __tegra_dvfs_set_rate(struct dvfs *d, unsigned long rate)
 {
 	int i = 0;
 	int ret;
+	int old_millivolts = d->cur_millivolts;
+	struct dvfs_rail *rail = d->dvfs_rail;
+	ktime_t start, delta;
 	unsigned long *freqs = dvfs_get_freqs(d);
 
 	if (freqs == NULL || d->millivolts == NULL)
@@ -358,8 +402,24 @@ __tegra_dvfs_set_rate(struct dvfs *d, unsigned long rate)
 	}
 
 	d->cur_rate = rate;
+	dvfs_rail_track_max(rail, old_millivolts, d->cur_millivolts);
+
+	/* Same voltage bin and rail already settled: nothing to re-solve */
+	if ((old_millivolts == d->cur_millivolts) && rail->in_sync) {
+		rail->update_stats.fast_updates++;
+		return 0;
+	}
+
+	start = ktime_get();
+	ret = dvfs_rail_update(rail);
+	delta = ktime_sub(ktime_get(), start);
+
+	rail->update_stats.full_updates++;
+	rail->update_stats.total_time =
+		ktime_add(rail->update_stats.total_time, delta);
+	if (ktime_to_ns(delta) > ktime_to_ns(rail->update_stats.max_time))
+		rail->update_stats.max_time = delta;
 
-	ret = dvfs_rail_update(d->dvfs_rail);
 	if (ret)
 		pr_err("Failed to set regulator %s for clock %s to %d mV\n",
 			d->dvfs_rail->reg_id, d->clk_name, d->cur_millivolts);
@@ -470,6 +530,7 @@ int __init tegra_enable_dvfs_on_clk(struct clk *c, struct dvfs *d)
 
 	mutex_lock(&dvfs_lock);
 	list_add_tail(&d->reg_node, &d->dvfs_rail->dvfs);
+	dvfs_rail_scan_max(d->dvfs_rail);
 	mutex_unlock(&dvfs_lock);
 
 	return 0;
@@ -513,6 +574,7 @@ static int tegra_dvfs_suspend_one(void)
 			if (ret)
 				return ret;
 			rail->suspended = true;
+			rail->in_sync = false;
 			return 0;
 		}
 	}
@@ -603,6 +665,7 @@ static void __tegra_dvfs_rail_disable(struct dvfs_rail *rail)
 			"voltage %d\n", rail->reg_id,
 			rail->nominal_millivolts);
 	rail->disabled = true;
+	rail->in_sync = false;
 }
 
 /* must be called with dvfs lock held */
@@ -826,6 +889,42 @@ static const struct file_operations rail_stats_fops = {
 	.release	= single_release,
 };
 
+static int rail_update_stats_show(struct seq_file *s, void *data)
+{
+	struct dvfs_rail *rail;
+
+	seq_printf(s, "%-12s %-10s %-10s %-10s %-10s\n", "rail", "full",
+		   "fast", "avg(us)", "max(us)");
+
+	mutex_lock(&dvfs_lock);
+
+	list_for_each_entry(rail, &dvfs_rail_list, node) {
+		struct rail_update_stats *st = &rail->update_stats;
+		u64 avg = ktime_to_us(st->total_time);
+
+		if (st->full_updates)
+			do_div(avg, st->full_updates);
+
+		seq_printf(s, "%-12s %-10llu %-10llu %-10llu %-10lld\n",
+			   rail->reg_id, st->full_updates, st->fast_updates,
+			   avg, ktime_to_us(st->max_time));
+	}
+	mutex_unlock(&dvfs_lock);
+	return 0;
+}
+
+static int rail_update_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rail_update_stats_show, inode->i_private);
+}
+
+static const struct file_operations rail_update_stats_fops = {
+	.open		= rail_update_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 int __init dvfs_debugfs_init(struct dentry *clk_debugfs_root)
 {
 	struct dentry *d;
@@ -840,6 +939,11 @@ int __init dvfs_debugfs_init(struct dentry *clk_debugfs_root)
 	if (!d)
 		return -ENOMEM;
 
+	d = debugfs_create_file("rail_updates", S_IRUGO, clk_debugfs_root,
+		NULL, &rail_update_stats_fops);
+	if (!d)
+		return -ENOMEM;
+
 	return 0;
 }
 
@@ -51,6 +51,13 @@ struct rail_stats {
 	bool off;
 };
 
+struct rail_update_stats {
+	u64 full_updates;	/* rail re-solved on clock rate change */
+	u64 fast_updates;	/* rate change did not change rail request */
+	ktime_t total_time;
+	ktime_t max_time;
+};
+
 struct dvfs_rail {
 	const char *reg_id;
 	int min_millivolts;
@@ -71,6 +78,13 @@ struct dvfs_rail {
 	int new_millivolts;
 	bool suspended;
 	struct rail_stats stats;
+
+	/* maximum cur_millivolts over attached dvfs, and how many are at it */
+	int dvfs_max_millivolts;
+	int dvfs_max_count;
+	/* rail voltage matches its requests after the last update */
+	bool in_sync;
+	struct rail_update_stats update_stats;
 };
 
 enum dvfs_alt_freqs {
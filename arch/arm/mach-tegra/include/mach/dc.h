@@ -387,6 +387,7 @@ struct tegra_dc_out {
 
 #define V_BLANK_FLIP		0
 #define V_BLANK_NVSD		1
+#define V_BLANK_CURSOR		2
 
 struct tegra_dc;
 struct nvmap_handle_ref;
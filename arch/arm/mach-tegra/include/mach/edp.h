@@ -51,6 +51,9 @@ void tegra_get_cpu_edp_limits(const struct tegra_edp_limits **limits, int *size)
 unsigned int tegra_get_edp_limit(void);
 void tegra_get_system_edp_limits(const unsigned int **limits);
 int tegra_system_edp_alarm(bool alarm);
+void tegra_edp_update_thermal_trend(long temp, long throttle_temp);
+void tegra_edp_stop_thermal_trend(void);
+long tegra_edp_thermal_slope(void);
 
 #else
 static inline void tegra_init_cpu_edp_limits(int regulator_mA)
@@ -68,6 +71,13 @@ static inline void tegra_get_system_edp_limits(unsigned int **limits)
 {}
 static inline int tegra_system_edp_alarm(bool alarm)
 { return -1; }
+static inline void tegra_edp_update_thermal_trend(long temp,
+						  long throttle_temp)
+{}
+static inline void tegra_edp_stop_thermal_trend(void)
+{}
+static inline long tegra_edp_thermal_slope(void)
+{ return 0; }
 #endif
 
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
@@ -37,6 +37,9 @@ void tegra_dc_ext_disable(struct tegra_dc_ext *dc_ext);
 
 int tegra_dc_ext_process_hotplug(int output);
 
+/* called by display controller from the vblank interrupt */
+void tegra_dc_ext_vblank(struct tegra_dc_ext *dc_ext);
+
 #else /* CONFIG_TEGRA_DC_EXTENSIONS */
 
 static inline
@@ -72,6 +75,10 @@ int tegra_dc_ext_process_hotplug(int output)
 {
 	return 0;
 }
+static inline
+void tegra_dc_ext_vblank(struct tegra_dc_ext *dc_ext)
+{
+}
 #endif /* CONFIG_TEGRA_DC_EXTENSIONS */
 
 #endif /* __MACH_TEGRA_DC_EXT_H */
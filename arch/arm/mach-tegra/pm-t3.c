@@ -40,6 +40,7 @@
 #include "clock.h"
 #include "cpuidle.h"
 #include "pm.h"
+#include "power-stats.h"
 #include "sleep.h"
 #include "tegra3_emc.h"
 #include "dvfs.h"
@@ -428,7 +429,8 @@ void tegra_lp0_cpu_mode(bool enter)
 	if (entered_on_g) {
 		flags = enter ? TEGRA_POWER_CLUSTER_LP : TEGRA_POWER_CLUSTER_G;
 		flags |= TEGRA_POWER_CLUSTER_IMMEDIATE;
-		tegra_cluster_control(0, flags);
+		if (!tegra_cluster_control(0, flags))
+			tegra_power_stats_cluster_switch(0);
 		pr_info("Tegra: switched to %s cluster\n", enter ? "LP" : "G");
 	}
 }
@@ -0,0 +1,68 @@
+/*
+ * arch/arm/mach-tegra/power-model.h
+ *
+ * Tegra3 per-core CPU power model
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * The one model behind both the LP/G cluster choice (cpu-tegra3.c) and
+ * the energy accounting (power-stats.c), so the two always agree:
+ *
+ *   busy:         ceff * V^2 * f + leak * V
+ *   clock gated:  leak * V
+ *   power gated:  0
+ *
+ * ceff is the switched capacitance of one core in pF, leak its leakage
+ * current in mA. V is the voltage of the rail the cluster runs from:
+ * vdd_cpu for G, vdd_core for LP.
+ */
+
+#ifndef __MACH_TEGRA_POWER_MODEL_H
+#define __MACH_TEGRA_POWER_MODEL_H
+
+#include <linux/types.h>
+#include <linux/math64.h>
+
+#define TEGRA_G_CEFF_PF		300
+#define TEGRA_LP_CEFF_PF	250
+#define TEGRA_G_LEAK_MA		60
+#define TEGRA_LP_LEAK_MA	5
+
+/* Power of one clock gated core, in uW */
+static inline u64 tegra_power_gated_uw(bool lp, unsigned int mv)
+{
+	return (u64)(lp ? TEGRA_LP_LEAK_MA : TEGRA_G_LEAK_MA) * mv;
+}
+
+/* Power of one busy core running at @khz, in uW */
+static inline u64 tegra_power_busy_uw(bool lp, unsigned int khz,
+				      unsigned int mv)
+{
+	u64 dyn = (u64)(lp ? TEGRA_LP_CEFF_PF : TEGRA_G_CEFF_PF) *
+		mv * mv * (khz / 1000);
+
+	return div_u64(dyn, 1000000) + tegra_power_gated_uw(lp, mv);
+}
+
+/* Energy of one busy core per cycle at @khz, in pJ */
+static inline u64 tegra_energy_per_cycle_pj(bool lp, unsigned int khz,
+					    unsigned int mv)
+{
+	return div_u64(tegra_power_busy_uw(lp, khz, mv) * 1000, khz ? : 1);
+}
+
+#endif /* __MACH_TEGRA_POWER_MODEL_H */
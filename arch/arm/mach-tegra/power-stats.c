@@ -0,0 +1,489 @@
+/*
+ * arch/arm/mach-tegra/power-stats.c
+ *
+ * Per-CPU residency and estimated energy accounting for Tegra3
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/percpu.h>
+#include <linux/fs.h>
+#include <linux/err.h>
+
+#include "clock.h"
+#include "cpu-tegra.h"
+#include "dvfs.h"
+#include "pm.h"
+#include "power-model.h"
+#include "power-stats.h"
+
+/*
+ * Every core is always in exactly one of the TEGRA_POWER_* states. Each
+ * transition (idle entry/exit, cpufreq change, hotplug, cluster switch)
+ * closes the open interval of the affected core and charges it to the
+ * core and to the (cluster, rate) bucket it ran at. All of that state is
+ * per core and under the core's own lock, so idle transitions on different
+ * cores never contend; readers sum the rate buckets of all cores. Power
+ * over the interval comes from power-model.h, at the voltage the rail of
+ * the cluster had at its start; LP3 is clock gated, LP2 and offline power
+ * gated.
+ */
+
+struct power_bucket {
+	u64 time_us[TEGRA_POWER_NR_STATES];
+	u64 energy_nj;
+	int millivolts;
+};
+
+struct power_cpu {
+	spinlock_t lock;
+	int state;
+	int cluster;
+	int freq_index;
+	int millivolts;
+	ktime_t since;
+	struct power_bucket total;
+	struct power_bucket *freq[TEGRA_POWER_NR_CLUSTERS];
+};
+
+static DEFINE_PER_CPU(struct power_cpu, power_cpu);
+static struct cpufreq_frequency_table *freq_table;
+static int freq_count;
+static struct dvfs_rail *cpu_rail;	/* G cluster */
+static struct dvfs_rail *core_rail;	/* LP cluster */
+static bool power_stats_ready;
+
+static u64 power_estimate_uw(int cluster, int state, unsigned int khz, int mv)
+{
+	bool lp = (cluster == TEGRA_POWER_STATS_LP);
+
+	switch (state) {
+	case TEGRA_POWER_BUSY:
+		return tegra_power_busy_uw(lp, khz, mv);
+	case TEGRA_POWER_LP3:
+		return tegra_power_gated_uw(lp, mv);
+	default:
+		return 0;
+	}
+}
+
+/* Table entry for @khz: exact match, else the next rate above it */
+static int power_freq_index(unsigned int khz)
+{
+	int i;
+
+	for (i = 0; i < freq_count; i++) {
+		if (freq_table[i].frequency == CPUFREQ_ENTRY_INVALID)
+			continue;
+		if (freq_table[i].frequency >= khz)
+			return i;
+	}
+	return freq_count - 1;
+}
+
+/* Charge the open interval of @pc up to @now. Call with pc->lock held */
+static void power_account(struct power_cpu *pc, ktime_t now)
+{
+	struct power_bucket *b;
+	s64 us = ktime_us_delta(now, pc->since);
+	u64 nj;
+
+	if (us <= 0)
+		return;
+	pc->since = now;
+
+	nj = div_u64((u64)us * power_estimate_uw(pc->cluster, pc->state,
+		freq_table[pc->freq_index].frequency, pc->millivolts), 1000);
+	pc->total.time_us[pc->state] += us;
+	pc->total.energy_nj += nj;
+	pc->total.millivolts = pc->millivolts;
+
+	/* offline cores are not clocked by the cluster */
+	if (pc->state == TEGRA_POWER_OFFLINE)
+		return;
+
+	b = &pc->freq[pc->cluster][pc->freq_index];
+	b->time_us[pc->state] += us;
+	b->energy_nj += nj;
+	b->millivolts = pc->millivolts;
+}
+
+/*
+ * Latch the operating point for the next interval of @pc; @khz of 0 keeps
+ * the current rate. Call with pc->lock held
+ */
+static void power_refresh(struct power_cpu *pc, unsigned int khz)
+{
+	struct dvfs_rail *rail;
+
+	if (khz)
+		pc->freq_index = power_freq_index(khz);
+	if (is_lp_cluster()) {
+		pc->cluster = TEGRA_POWER_STATS_LP;
+		rail = core_rail;
+	} else {
+		pc->cluster = TEGRA_POWER_STATS_G;
+		rail = cpu_rail;
+	}
+	pc->millivolts = (rail && rail->millivolts) ? rail->millivolts : 1000;
+}
+
+void tegra_power_stats_idle(unsigned int cpu, int state, ktime_t now)
+{
+	struct power_cpu *pc = &per_cpu(power_cpu, cpu);
+	unsigned long flags;
+
+	if (!power_stats_ready)
+		return;
+
+	spin_lock_irqsave(&pc->lock, flags);
+	power_account(pc, now);
+	pc->state = state;
+	spin_unlock_irqrestore(&pc->lock, flags);
+}
+
+/*
+ * Called after every successful tegra_cluster_control(), with the new cpu
+ * rate in @khz or 0 if the rate did not change. May run under the cpu
+ * clock lock, so must not query the clock framework.
+ */
+void tegra_power_stats_cluster_switch(unsigned int khz)
+{
+	struct power_cpu *pc;
+	unsigned long flags;
+	unsigned int cpu;
+	ktime_t now;
+
+	if (!power_stats_ready)
+		return;
+
+	now = ktime_get();
+	for_each_online_cpu(cpu) {
+		pc = &per_cpu(power_cpu, cpu);
+		spin_lock_irqsave(&pc->lock, flags);
+		power_account(pc, now);
+		power_refresh(pc, khz);
+		spin_unlock_irqrestore(&pc->lock, flags);
+	}
+}
+
+static int power_stats_cpufreq_notify(struct notifier_block *nb,
+				      unsigned long event, void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+	struct power_cpu *pc = &per_cpu(power_cpu, freqs->cpu);
+	unsigned long flags;
+
+	if (event != CPUFREQ_POSTCHANGE)
+		return NOTIFY_OK;
+
+	spin_lock_irqsave(&pc->lock, flags);
+	power_account(pc, ktime_get());
+	power_refresh(pc, freqs->new);
+	spin_unlock_irqrestore(&pc->lock, flags);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block power_stats_cpufreq_nb = {
+	.notifier_call = power_stats_cpufreq_notify,
+};
+
+static int power_stats_cpu_notify(struct notifier_block *nb,
+				  unsigned long event, void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+	struct power_cpu *pc = &per_cpu(power_cpu, cpu);
+	unsigned int khz = tegra_getspeed(0);
+	unsigned long flags;
+
+	switch (event & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+		spin_lock_irqsave(&pc->lock, flags);
+		power_account(pc, ktime_get());
+		pc->state = TEGRA_POWER_BUSY;
+		power_refresh(pc, khz);
+		spin_unlock_irqrestore(&pc->lock, flags);
+		break;
+	case CPU_DEAD:
+		spin_lock_irqsave(&pc->lock, flags);
+		power_account(pc, ktime_get());
+		pc->state = TEGRA_POWER_OFFLINE;
+		spin_unlock_irqrestore(&pc->lock, flags);
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block power_stats_cpu_nb = {
+	.notifier_call = power_stats_cpu_notify,
+};
+
+/* Add @b to @r; records start out zeroed */
+static void power_fill_record(struct tegra_power_stats_record *r,
+			      struct power_bucket *b)
+{
+	int i;
+
+	for (i = 0; i < TEGRA_POWER_NR_STATES; i++)
+		r->time_us[i] += b->time_us[i];
+	r->energy_nj += b->energy_nj;
+	if (b->millivolts)
+		r->millivolts = b->millivolts;
+}
+
+#ifdef CONFIG_DEBUG_FS
+
+struct power_snapshot {
+	size_t size;
+	char data[0];
+};
+
+/* Snapshot everything at open; reads are served from the copy */
+static int power_stats_open(struct inode *inode, struct file *file)
+{
+	struct power_snapshot *snap;
+	struct tegra_power_stats_header *hdr;
+	struct tegra_power_stats_record *r, *freq;
+	struct power_cpu *pc;
+	unsigned int n, cpu;
+	unsigned long flags;
+	ktime_t now;
+	int c, i;
+	size_t size;
+
+	n = num_possible_cpus() + TEGRA_POWER_NR_CLUSTERS * freq_count;
+	size = sizeof(*hdr) + n * sizeof(*r);
+	snap = kzalloc(sizeof(*snap) + size, GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	snap->size = size;
+	hdr = (struct tegra_power_stats_header *)snap->data;
+	hdr->magic = TEGRA_POWER_STATS_MAGIC;
+	hdr->version = TEGRA_POWER_STATS_VERSION;
+	hdr->record_size = sizeof(*r);
+	hdr->nr_records = n;
+	r = (struct tegra_power_stats_record *)(hdr + 1);
+	freq = r + num_possible_cpus();
+
+	for (c = 0; c < TEGRA_POWER_NR_CLUSTERS; c++) {
+		for (i = 0; i < freq_count; i++) {
+			freq[c * freq_count + i].type = TEGRA_POWER_RECORD_FREQ;
+			freq[c * freq_count + i].id = c;
+			freq[c * freq_count + i].freq_khz =
+				freq_table[i].frequency;
+			freq[c * freq_count + i].cluster = c;
+		}
+	}
+
+	/* Cores are sampled one at a time, all up to the same instant */
+	now = ktime_get();
+	hdr->timestamp_us = ktime_to_us(now);
+
+	for_each_possible_cpu(cpu) {
+		pc = &per_cpu(power_cpu, cpu);
+		r->type = TEGRA_POWER_RECORD_CPU;
+		r->id = cpu;
+
+		spin_lock_irqsave(&pc->lock, flags);
+		power_account(pc, now);
+		r->cluster = pc->cluster;
+		power_fill_record(r, &pc->total);
+		for (c = 0; c < TEGRA_POWER_NR_CLUSTERS; c++)
+			for (i = 0; i < freq_count; i++)
+				power_fill_record(&freq[c * freq_count + i],
+						  &pc->freq[c][i]);
+		spin_unlock_irqrestore(&pc->lock, flags);
+		r++;
+	}
+
+	file->private_data = snap;
+	return nonseekable_open(inode, file);
+}
+
+static ssize_t power_stats_read(struct file *file, char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct power_snapshot *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, snap->data, snap->size);
+}
+
+static int power_stats_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations power_stats_fops = {
+	.open		= power_stats_open,
+	.read		= power_stats_read,
+	.llseek		= no_llseek,
+	.release	= power_stats_release,
+};
+
+static const char *power_state_names[TEGRA_POWER_NR_STATES] = {
+	"busy", "lp3", "lp2", "offline",
+};
+
+static int power_summary_show(struct seq_file *s, void *data)
+{
+	struct power_bucket total;
+	struct power_cpu *pc;
+	unsigned long flags;
+	unsigned int cpu;
+	ktime_t now = ktime_get();
+	int cluster;
+	int i;
+
+	seq_printf(s, "cpu  cluster");
+	for (i = 0; i < TEGRA_POWER_NR_STATES; i++)
+		seq_printf(s, " %10s", power_state_names[i]);
+	seq_printf(s, " %10s %5s\n", "energy", "mV");
+
+	for_each_possible_cpu(cpu) {
+		pc = &per_cpu(power_cpu, cpu);
+		spin_lock_irqsave(&pc->lock, flags);
+		power_account(pc, now);
+		total = pc->total;
+		cluster = pc->cluster;
+		spin_unlock_irqrestore(&pc->lock, flags);
+
+		seq_printf(s, "%3u  %7s", cpu,
+			   cluster == TEGRA_POWER_STATS_LP ? "LP" : "G");
+		for (i = 0; i < TEGRA_POWER_NR_STATES; i++)
+			seq_printf(s, " %10llu",
+				   div_u64(total.time_us[i], 1000));
+		seq_printf(s, " %10llu %5d\n",
+			   div_u64(total.energy_nj, 1000000),
+			   total.millivolts);
+	}
+	seq_printf(s, "(times in ms, energy in mJ)\n");
+
+	return 0;
+}
+
+static int power_summary_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, power_summary_show, inode->i_private);
+}
+
+static const struct file_operations power_summary_fops = {
+	.open		= power_summary_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init power_stats_debug_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("tegra_power", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("stats", 0444, dir, NULL, &power_stats_fops))
+		goto err_out;
+
+	if (!debugfs_create_file("summary", 0444, dir, NULL,
+				 &power_summary_fops))
+		goto err_out;
+
+	return 0;
+
+err_out:
+	debugfs_remove_recursive(dir);
+	return -ENOMEM;
+}
+#else
+static inline int power_stats_debug_init(void)
+{ return 0; }
+#endif
+
+static int __init tegra_power_stats_init(void)
+{
+	struct tegra_cpufreq_table_data *table_data =
+		tegra_cpufreq_table_get();
+	struct power_cpu *pc;
+	unsigned int khz, cpu;
+	ktime_t now;
+	int c;
+
+	if (IS_ERR_OR_NULL(table_data))
+		return -EINVAL;
+
+	freq_table = table_data->freq_table;
+	for (freq_count = 0; freq_table[freq_count].frequency !=
+	     CPUFREQ_TABLE_END; freq_count++)
+		;
+	if (!freq_count)
+		return -EINVAL;
+
+	for_each_possible_cpu(cpu) {
+		pc = &per_cpu(power_cpu, cpu);
+		for (c = 0; c < TEGRA_POWER_NR_CLUSTERS; c++) {
+			pc->freq[c] = kcalloc(freq_count, sizeof(*pc->freq[c]),
+					      GFP_KERNEL);
+			if (!pc->freq[c])
+				goto err_out;
+		}
+	}
+
+	cpu_rail = tegra_dvfs_get_rail_by_name("vdd_cpu");
+	core_rail = tegra_dvfs_get_rail_by_name("vdd_core");
+
+	khz = tegra_getspeed(0);
+	now = ktime_get();
+	for_each_possible_cpu(cpu) {
+		pc = &per_cpu(power_cpu, cpu);
+		spin_lock_init(&pc->lock);
+		pc->state = cpu_online(cpu) ?
+			TEGRA_POWER_BUSY : TEGRA_POWER_OFFLINE;
+		pc->since = now;
+		power_refresh(pc, khz);
+	}
+
+	cpufreq_register_notifier(&power_stats_cpufreq_nb,
+				  CPUFREQ_TRANSITION_NOTIFIER);
+	register_hotcpu_notifier(&power_stats_cpu_nb);
+	power_stats_ready = true;
+
+	return power_stats_debug_init();
+
+err_out:
+	for_each_possible_cpu(cpu) {
+		pc = &per_cpu(power_cpu, cpu);
+		for (c = 0; c < TEGRA_POWER_NR_CLUSTERS; c++) {
+			kfree(pc->freq[c]);
+			pc->freq[c] = NULL;
+		}
+	}
+	return -ENOMEM;
+}
+late_initcall(tegra_power_stats_init);
@@ -0,0 +1,84 @@
+/*
+ * arch/arm/mach-tegra/power-stats.h
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __MACH_TEGRA_POWER_STATS_H
+#define __MACH_TEGRA_POWER_STATS_H
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+enum {
+	TEGRA_POWER_BUSY = 0,
+	TEGRA_POWER_LP3,
+	TEGRA_POWER_LP2,
+	TEGRA_POWER_OFFLINE,
+	TEGRA_POWER_NR_STATES,
+};
+
+enum {
+	TEGRA_POWER_STATS_G = 0,
+	TEGRA_POWER_STATS_LP,
+	TEGRA_POWER_NR_CLUSTERS,
+};
+
+/*
+ * Layout of debugfs tegra_power/stats: one header followed by nr_records
+ * records of record_size bytes. CPU records come first, one per possible
+ * cpu (id = cpu), then one FREQ record per cluster and cpufreq table entry
+ * (id = cluster) holding the residency of all cores at that rate.
+ * Times are in us, energy in nJ; all fields are little endian.
+ */
+#define TEGRA_POWER_STATS_MAGIC		0x53505754	/* "TWPS" */
+#define TEGRA_POWER_STATS_VERSION	1
+
+#define TEGRA_POWER_RECORD_CPU		1
+#define TEGRA_POWER_RECORD_FREQ		2
+
+struct tegra_power_stats_header {
+	__u32 magic;
+	__u16 version;
+	__u16 record_size;
+	__u32 nr_records;
+	__u32 reserved;
+	__u64 timestamp_us;
+};
+
+struct tegra_power_stats_record {
+	__u16 type;
+	__u16 id;
+	__u32 freq_khz;		/* FREQ records only */
+	__u32 millivolts;	/* last voltage of the cluster's rail */
+	__u32 cluster;		/* CPU records: current cluster */
+	__u64 time_us[TEGRA_POWER_NR_STATES];
+	__u64 energy_nj;
+};
+
+#ifdef CONFIG_TEGRA_POWER_STATS
+void tegra_power_stats_idle(unsigned int cpu, int state, ktime_t now);
+void tegra_power_stats_cluster_switch(unsigned int khz);
+#else
+static inline void tegra_power_stats_idle(unsigned int cpu, int state,
+					  ktime_t now)
+{ }
+static inline void tegra_power_stats_cluster_switch(unsigned int khz)
+{ }
+#endif
+
+#endif /* __MACH_TEGRA_POWER_STATS_H */
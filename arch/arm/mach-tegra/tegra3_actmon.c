@@ -25,6 +25,11 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
+#include <linux/hrtimer.h>
+#include <linux/kfifo.h>
+#include <linux/tick.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
 
 #include <mach/iomap.h>
 #include <mach/irqs.h>
@@ -743,6 +748,172 @@ static int period_set(void *data, u64 val)
 }
 DEFINE_SIMPLE_ATTRIBUTE(period_fops, period_get, period_set, "%llu\n");
 
+/*
+ * Telemetry stream: while "telemetry" is open, actmon counters of all
+ * devices and per-CPU busy time are sampled from an hrtimer every
+ * telemetry_period_ms and queued as fixed-size binary records, read back
+ * as whole records. Only the sampling timer runs; no actmon interrupts are
+ * added. Counts are refreshed by hardware once per actmon "period", so it
+ * should be set at or below the telemetry period for non-repeating data.
+ */
+#define ACTMON_TELEMETRY_CPUS		4
+#define ACTMON_TELEMETRY_DEVS		2
+#define ACTMON_TELEMETRY_FIFO_SIZE	256	/* records, power of 2 */
+
+struct actmon_telemetry_dev {
+	u32	count;		/* last sample period activity count */
+	u32	avg_count;	/* moving average activity count */
+	u32	cur_freq;	/* kHz */
+};
+
+struct actmon_telemetry_sample {
+	u64	timestamp;	/* ns, monotonic */
+	u32	dropped;	/* records lost before this one */
+	u32	cpu_busy_us[ACTMON_TELEMETRY_CPUS];
+	struct actmon_telemetry_dev dev[ACTMON_TELEMETRY_DEVS];
+};
+
+static DEFINE_KFIFO(telemetry_fifo, struct actmon_telemetry_sample,
+		    ACTMON_TELEMETRY_FIFO_SIZE);
+static DECLARE_WAIT_QUEUE_HEAD(telemetry_wq);
+static DEFINE_MUTEX(telemetry_read_lock);
+static struct hrtimer telemetry_timer;
+static unsigned long telemetry_busy;
+static u32 telemetry_period_ms = 10;
+static u32 telemetry_dropped;
+static u64 telemetry_cpu_idle[ACTMON_TELEMETRY_CPUS];
+static u64 telemetry_cpu_wall[ACTMON_TELEMETRY_CPUS];
+
+static inline ktime_t telemetry_period(void)
+{
+	u32 ms = max(telemetry_period_ms, 1U);
+
+	return ktime_set(ms / MSEC_PER_SEC, (ms % MSEC_PER_SEC) * NSEC_PER_MSEC);
+}
+
+static void actmon_telemetry_sample_cpus(struct actmon_telemetry_sample *t)
+{
+	int cpu;
+	u64 idle, wall;
+
+	for (cpu = 0; cpu < ACTMON_TELEMETRY_CPUS; cpu++) {
+		t->cpu_busy_us[cpu] = 0;
+		if (!cpu_online(cpu))
+			continue;
+
+		idle = get_cpu_idle_time_us(cpu, &wall);
+		if (idle == -1ULL)
+			continue;
+
+		if ((wall - telemetry_cpu_wall[cpu]) >
+		    (idle - telemetry_cpu_idle[cpu]))
+			t->cpu_busy_us[cpu] = (u32)((wall -
+				telemetry_cpu_wall[cpu]) -
+				(idle - telemetry_cpu_idle[cpu]));
+		telemetry_cpu_idle[cpu] = idle;
+		telemetry_cpu_wall[cpu] = wall;
+	}
+}
+
+static enum hrtimer_restart actmon_telemetry_timer_fn(struct hrtimer *timer)
+{
+	int i;
+	unsigned long flags;
+	struct actmon_telemetry_sample t;
+
+	/* padding included: the record is copied to user space as is */
+	memset(&t, 0, sizeof(t));
+	t.timestamp = ktime_to_ns(ktime_get());
+	t.dropped = telemetry_dropped;
+	actmon_telemetry_sample_cpus(&t);
+
+	for (i = 0; i < ACTMON_TELEMETRY_DEVS; i++) {
+		struct actmon_dev *dev = actmon_devices[i];
+
+		/* device stays on, and its frequency matches the counts */
+		spin_lock_irqsave(&dev->lock, flags);
+		if (dev->state == ACTMON_ON) {
+			t.dev[i].count = actmon_readl(offs(ACTMON_DEV_COUNT));
+			t.dev[i].avg_count =
+				actmon_readl(offs(ACTMON_DEV_AVG_COUNT));
+			t.dev[i].cur_freq = dev->cur_freq;
+		}
+		spin_unlock_irqrestore(&dev->lock, flags);
+	}
+
+	if (kfifo_put(&telemetry_fifo, &t))
+		telemetry_dropped = 0;
+	else
+		telemetry_dropped++;
+	wake_up_interruptible(&telemetry_wq);
+
+	hrtimer_forward_now(timer, telemetry_period());
+	return HRTIMER_RESTART;
+}
+
+static int telemetry_open(struct inode *inode, struct file *file)
+{
+	int cpu;
+
+	if (test_and_set_bit(0, &telemetry_busy))
+		return -EBUSY;
+
+	kfifo_reset(&telemetry_fifo);
+	telemetry_dropped = 0;
+	for (cpu = 0; cpu < ACTMON_TELEMETRY_CPUS; cpu++)
+		telemetry_cpu_idle[cpu] = get_cpu_idle_time_us(
+			cpu, &telemetry_cpu_wall[cpu]);
+
+	hrtimer_start(&telemetry_timer, telemetry_period(), HRTIMER_MODE_REL);
+	return nonseekable_open(inode, file);
+}
+
+static int telemetry_release(struct inode *inode, struct file *file)
+{
+	hrtimer_cancel(&telemetry_timer);
+	clear_bit(0, &telemetry_busy);
+	return 0;
+}
+
+static ssize_t telemetry_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	int ret;
+	unsigned int copied;
+
+	if (count < sizeof(struct actmon_telemetry_sample))
+		return -EINVAL;
+
+	if (kfifo_is_empty(&telemetry_fifo)) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(telemetry_wq,
+				!kfifo_is_empty(&telemetry_fifo));
+		if (ret)
+			return ret;
+	}
+
+	/* kfifo_to_user() copies whole records only */
+	mutex_lock(&telemetry_read_lock);
+	ret = kfifo_to_user(&telemetry_fifo, buf, count, &copied);
+	mutex_unlock(&telemetry_read_lock);
+
+	return ret ? ret : copied;
+}
+
+static unsigned int telemetry_poll(struct file *file, poll_table *wait)
+{
+	poll_wait(file, &telemetry_wq, wait);
+	return kfifo_is_empty(&telemetry_fifo) ? 0 : POLLIN | POLLRDNORM;
+}
+
+static const struct file_operations telemetry_fops = {
+	.open		= telemetry_open,
+	.release	= telemetry_release,
+	.read		= telemetry_read,
+	.poll		= telemetry_poll,
+	.llseek		= no_llseek,
+};
 
 static int actmon_debugfs_create_dev(struct actmon_dev *dev)
 {
@@ -813,6 +984,20 @@ static int __init actmon_debugfs_init(void)
 	if (!d)
 		goto err_out;
 
+	BUILD_BUG_ON(ARRAY_SIZE(actmon_devices) != ACTMON_TELEMETRY_DEVS);
+	hrtimer_init(&telemetry_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	telemetry_timer.function = actmon_telemetry_timer_fn;
+
+	d = debugfs_create_file("telemetry", RO_MODE, clk_debugfs_root, NULL,
+				&telemetry_fops);
+	if (!d)
+		goto err_out;
+
+	d = debugfs_create_u32("telemetry_period_ms", RW_MODE,
+			       clk_debugfs_root, &telemetry_period_ms);
+	if (!d)
+		goto err_out;
+
 	for (i = 0; i < ARRAY_SIZE(actmon_devices); i++) {
 		ret = actmon_debugfs_create_dev(actmon_devices[i]);
 		if (ret)
@@ -38,6 +38,7 @@
 #include "fuse.h"
 #include "dvfs.h"
 #include "pm.h"
+#include "power-stats.h"
 #include "sleep.h"
 #include "tegra3_emc.h"
 
@@ -1075,6 +1076,7 @@ static int tegra3_cpu_cmplx_clk_set_parent(struct clk *c, struct clk *p)
 		clk_disable(c->parent);
 
 	clk_reparent(c, p);
+	tegra_power_stats_cluster_switch(rate / 1000);
 	return 0;
 }
 
@@ -2994,6 +2996,58 @@ static noinline int shared_bus_set_rate(struct clk *bus, unsigned long rate,
 	return 0;
 }
 
+/*
+ * EMC governor mode: instead of taking the maximum of all floor requests,
+ * combine measured activity (actmon), declared isochronous bandwidth
+ * (display, camera) and declared non-isochronous bandwidth (3d, avp) into
+ * one target; see tegra_emc_gov_rate(). Plain floors and ceilings from
+ * other users are still honored.
+ */
+static int tegra3_clk_emc_gov_update(struct clk *bus)
+{
+	struct clk *c;
+	unsigned long old_rate, rate;
+	unsigned long floor = bus->min_rate;
+	unsigned long iso_bw = 0;
+	unsigned long declared_bw = 0;
+	unsigned long activity = 0;
+	unsigned long ceiling = bus->max_rate;
+
+	list_for_each_entry(c, &bus->shared_bus_list,
+			u.shared_bus_user.node) {
+		if (!c->u.shared_bus_user.enabled)
+			continue;
+
+		switch (c->u.shared_bus_user.mode) {
+		case SHARED_BW:
+		case SHARED_ISO:
+			iso_bw += c->u.shared_bus_user.rate;
+			break;
+		case SHARED_DECLARED:
+			declared_bw += c->u.shared_bus_user.rate;
+			break;
+		case SHARED_ACTIVITY:
+			activity = max(c->u.shared_bus_user.rate, activity);
+			break;
+		case SHARED_CEILING:
+			ceiling = min(c->u.shared_bus_user.rate, ceiling);
+			break;
+		case SHARED_AUTO:
+		case SHARED_FLOOR:
+		default:
+			floor = max(c->u.shared_bus_user.rate, floor);
+		}
+	}
+
+	old_rate = clk_get_rate_locked(bus);
+	rate = tegra_emc_gov_rate(floor, iso_bw, declared_bw, activity,
+				  ceiling, old_rate);
+	if (rate == old_rate)
+		return 0;
+
+	return shared_bus_set_rate(bus, rate, old_rate);
+}
+
 static int tegra3_clk_shared_bus_update(struct clk *bus)
 {
 	struct clk *c;
@@ -3005,6 +3059,9 @@ static int tegra3_clk_shared_bus_update(struct clk *bus)
 	if (detach_shared_bus)
 		return 0;
 
+	if ((bus->flags & PERIPH_EMC_ENB) && tegra_emc_gov_enabled())
+		return tegra3_clk_emc_gov_update(bus);
+
 	list_for_each_entry(c, &bus->shared_bus_list,
 			u.shared_bus_user.node) {
 		/* Ignore requests from disabled users and from users with
@@ -4312,7 +4369,7 @@ struct clk tegra_list_clks[] = {
 	SHARED_CLK("sbc5.sclk", "spi_tegra.4",		"sclk", &tegra_clk_sbus_cmplx, NULL, 0, 0),
 	SHARED_CLK("sbc6.sclk", "spi_tegra.5",		"sclk", &tegra_clk_sbus_cmplx, NULL, 0, 0),
 
-	SHARED_CLK("avp.emc",	"tegra-avp",		"emc",	&tegra_clk_emc, NULL, 0, 0),
+	SHARED_CLK("avp.emc",	"tegra-avp",		"emc",	&tegra_clk_emc, NULL, 0, SHARED_DECLARED),
 	SHARED_CLK("cpu.emc",	"cpu",			"emc",	&tegra_clk_emc, NULL, 0, 0),
 	SHARED_CLK("disp1.emc",	"tegradc.0",		"emc",	&tegra_clk_emc, NULL, 0, SHARED_BW),
 	SHARED_CLK("disp1.min_emc",	"tegradc.0",	"min_emc",	&tegra_clk_emc, NULL, 0, 0),
@@ -4323,12 +4380,12 @@ struct clk tegra_list_clks[] = {
 	SHARED_CLK("usb1.emc",	"tegra-ehci.0",		"emc",	&tegra_clk_emc, NULL, 0, 0),
 	SHARED_CLK("usb2.emc",	"tegra-ehci.1",		"emc",	&tegra_clk_emc, NULL, 0, 0),
 	SHARED_CLK("usb3.emc",	"tegra-ehci.2",		"emc",	&tegra_clk_emc, NULL, 0, 0),
-	SHARED_CLK("mon.emc",	"tegra_actmon",		"emc",	&tegra_clk_emc, NULL, 0, 0),
+	SHARED_CLK("mon.emc",	"tegra_actmon",		"emc",	&tegra_clk_emc, NULL, 0, SHARED_ACTIVITY),
 	SHARED_CLK("cap.emc",	"cap.emc",		NULL,	&tegra_clk_emc, NULL, 0, SHARED_CEILING),
-	SHARED_CLK("3d.emc",	"tegra_gr3d",		"emc",	&tegra_clk_emc, NULL, 0, 0),
+	SHARED_CLK("3d.emc",	"tegra_gr3d",		"emc",	&tegra_clk_emc, NULL, 0, SHARED_DECLARED),
 	SHARED_CLK("2d.emc",	"tegra_gr2d",		"emc",	&tegra_clk_emc, NULL, 0, 0),
 	SHARED_CLK("mpe.emc",	"tegra_mpe",		"emc",	&tegra_clk_emc, NULL, 0, 0),
-	SHARED_CLK("camera.emc", "tegra_camera",	"emc",	&tegra_clk_emc, NULL, 0, 0),
+	SHARED_CLK("camera.emc", "tegra_camera",	"emc",	&tegra_clk_emc, NULL, 0, SHARED_ISO),
 	SHARED_CLK("floor.emc",	"floor.emc",		NULL,	&tegra_clk_emc, NULL, 0, 0),
 
 	SHARED_CLK("host1x.cbus", "tegra_host1x",	"host1x", &tegra_clk_cbus, "host1x", 2, SHARED_AUTO),
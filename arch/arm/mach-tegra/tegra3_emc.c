@@ -28,6 +28,8 @@
 #include <linux/suspend.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include <asm/cputime.h>
 #include <asm/cacheflush.h>
@@ -55,6 +57,35 @@ enum {
 	DLL_CHANGE_OFF,
 };
 
+struct emc_reg_write {
+	unsigned long	reg;
+	u32		val;
+};
+
+#define EMC_MAX_DQS_PRESETS		3
+#define EMC_MAX_MODE_WRITES		3
+
+/*
+ * Everything emc_set_clock() needs to know about a switch between two DFS
+ * table entries that does not depend on run-time state. One transition is
+ * precomputed for every (from, to) pair at init, so the clock change path
+ * only replays register writes while memory access is stalled.
+ */
+struct emc_transition {
+	int			dll_change;
+	bool			zcal_long;
+	bool			vref_cal_toggle;
+	bool			qrst_possible;	/* need QRST if QUSE DPD is off */
+	bool			periodic_qrst_change;
+	u32			mrs_wait_cnt;	/* DDR3 DLL re-start only */
+
+	int			num_dqs_presets;
+	struct emc_reg_write	dqs_presets[EMC_MAX_DQS_PRESETS];
+
+	int			num_mode_writes;
+	struct emc_reg_write	mode_writes[EMC_MAX_MODE_WRITES];
+};
+
 #define EMC_CLK_DIV_SHIFT		0
 #define EMC_CLK_DIV_MASK		(0xFF << EMC_CLK_DIV_SHIFT)
 #define EMC_CLK_SOURCE_SHIFT		30
@@ -195,6 +226,7 @@ static unsigned long dram_over_temp_state = DRAM_OVER_TEMP_NONE;
 static const u32 *dram_to_soc_bit_map;
 static const struct tegra_emc_table *tegra_emc_table;
 static int tegra_emc_table_size;
+static struct emc_transition *emc_transitions;
 
 static u32 dram_dev_num;
 static u32 emc_cfg_saved;
@@ -356,33 +388,32 @@ static inline void enable_early_ack(u32 mc_override)
 			MC_EMEM_ARB_OVERRIDE);
 }
 
-static inline bool dqs_preset(const struct tegra_emc_table *next_timing,
+static inline void dqs_preset(struct emc_transition *t,
+			      const struct tegra_emc_table *next_timing,
 			      const struct tegra_emc_table *last_timing)
 {
-	bool ret = false;
-
 #define DQS_SET(reg, bit)						      \
 	do {								      \
 		if ((next_timing->burst_regs[EMC_##reg##_INDEX] &	      \
 		     EMC_##reg##_##bit##_ENABLE) &&			      \
 		    (!(last_timing->burst_regs[EMC_##reg##_INDEX] &	      \
 		       EMC_##reg##_##bit##_ENABLE)))   {		      \
-			emc_writel(last_timing->burst_regs[EMC_##reg##_INDEX] \
-				   | EMC_##reg##_##bit##_ENABLE, EMC_##reg);  \
-			ret = true;					      \
+			t->dqs_presets[t->num_dqs_presets].reg = EMC_##reg;   \
+			t->dqs_presets[t->num_dqs_presets].val =	      \
+				last_timing->burst_regs[EMC_##reg##_INDEX] |  \
+				EMC_##reg##_##bit##_ENABLE;		      \
+			t->num_dqs_presets++;				      \
 		}							      \
 	} while (0)
 
+	t->num_dqs_presets = 0;
 	DQS_SET(XM2DQSPADCTRL2, VREF);
 	DQS_SET(XM2DQSPADCTRL3, VREF);
 	DQS_SET(XM2QUSEPADCTRL, IVREF);
-
-	return ret;
 }
 
-static inline void overwrite_mrs_wait_cnt(
-	const struct tegra_emc_table *next_timing,
-	bool zcal_long)
+static inline u32 get_mrs_wait_cnt(const struct tegra_emc_table *next_timing,
+				   bool zcal_long)
 {
 	u32 reg;
 	u32 cnt = 512;
@@ -405,26 +436,23 @@ static inline void overwrite_mrs_wait_cnt(
 	reg |= (cnt << EMC_MRS_WAIT_CNT_LONG_WAIT_SHIFT) &
 		EMC_MRS_WAIT_CNT_LONG_WAIT_MASK;
 
-	emc_writel(reg, EMC_MRS_WAIT_CNT);
+	return reg;
 }
 
+/* Table part of the QRST decision; QUSE DPD state is checked at switch time */
 static inline bool need_qrst(const struct tegra_emc_table *next_timing,
-			     const struct tegra_emc_table *last_timing,
-			     u32 emc_dpd_reg)
+			     const struct tegra_emc_table *last_timing)
 {
 	u32 last_mode = (last_timing->burst_regs[EMC_FBIO_CFG5_INDEX] &
 		EMC_CFG5_QUSE_MODE_MASK) >> EMC_CFG5_QUSE_MODE_SHIFT;
 	u32 next_mode = (next_timing->burst_regs[EMC_FBIO_CFG5_INDEX] &
 		EMC_CFG5_QUSE_MODE_MASK) >> EMC_CFG5_QUSE_MODE_SHIFT;
 
-	/* QUSE DPD is disabled */
-	bool ret = !(emc_dpd_reg & EMC_SEL_DPD_CTRL_QUSE_DPD_ENABLE) &&
-
 	/* QUSE uses external mode before or after clock change */
-		(((last_mode != EMC_CFG5_QUSE_MODE_PULSE_INTERN) &&
-		  (last_mode != EMC_CFG5_QUSE_MODE_INTERNAL_LPBK)) ||
-		 ((next_mode != EMC_CFG5_QUSE_MODE_PULSE_INTERN) &&
-		  (next_mode != EMC_CFG5_QUSE_MODE_INTERNAL_LPBK)))  &&
+	bool ret = (((last_mode != EMC_CFG5_QUSE_MODE_PULSE_INTERN) &&
+		     (last_mode != EMC_CFG5_QUSE_MODE_INTERNAL_LPBK)) ||
+		    ((next_mode != EMC_CFG5_QUSE_MODE_PULSE_INTERN) &&
+		     (next_mode != EMC_CFG5_QUSE_MODE_INTERNAL_LPBK)))  &&
 
 	/* QUSE pad switches from schmitt to vref mode */
 		(((last_timing->burst_regs[EMC_XM2QUSEPADCTRL_INDEX] &
@@ -457,38 +485,70 @@ static inline int get_dll_change(const struct tegra_emc_table *next_timing,
 		return DLL_CHANGE_OFF;
 }
 
-static inline void set_dram_mode(const struct tegra_emc_table *next_timing,
-				 const struct tegra_emc_table *last_timing,
-				 int dll_change)
+static inline void add_mode_write(struct emc_transition *t,
+				  unsigned long reg, u32 val)
 {
+	BUG_ON(t->num_mode_writes >= EMC_MAX_MODE_WRITES);
+	t->mode_writes[t->num_mode_writes].reg = reg;
+	t->mode_writes[t->num_mode_writes].val = val;
+	t->num_mode_writes++;
+}
+
+static inline void set_dram_mode(struct emc_transition *t,
+				 const struct tegra_emc_table *next_timing,
+				 const struct tegra_emc_table *last_timing)
+{
+	t->num_mode_writes = 0;
+
 	if (dram_type == DRAM_TYPE_DDR3) {
 		/* first mode_1, then mode_2, then mode_reset*/
 		if (next_timing->emc_mode_1 != last_timing->emc_mode_1)
-			emc_writel(next_timing->emc_mode_1, EMC_EMRS);
+			add_mode_write(t, EMC_EMRS, next_timing->emc_mode_1);
 		if (next_timing->emc_mode_2 != last_timing->emc_mode_2)
-			emc_writel(next_timing->emc_mode_2, EMC_EMRS);
+			add_mode_write(t, EMC_EMRS, next_timing->emc_mode_2);
 
 		if ((next_timing->emc_mode_reset !=
 		     last_timing->emc_mode_reset) ||
-		    (dll_change == DLL_CHANGE_ON))
+		    (t->dll_change == DLL_CHANGE_ON))
 		{
 			u32 reg = next_timing->emc_mode_reset &
 				(~EMC_MODE_SET_DLL_RESET);
-			if (dll_change == DLL_CHANGE_ON) {
+			if (t->dll_change == DLL_CHANGE_ON) {
 				reg |= EMC_MODE_SET_DLL_RESET;
 				reg |= EMC_MODE_SET_LONG_CNT;
 			}
-			emc_writel(reg, EMC_MRS);
+			add_mode_write(t, EMC_MRS, reg);
 		}
 	} else {
 		/* first mode_2, then mode_1; mode_reset is not applicable */
 		if (next_timing->emc_mode_2 != last_timing->emc_mode_2)
-			emc_writel(next_timing->emc_mode_2, EMC_MRW);
+			add_mode_write(t, EMC_MRW, next_timing->emc_mode_2);
 		if (next_timing->emc_mode_1 != last_timing->emc_mode_1)
-			emc_writel(next_timing->emc_mode_1, EMC_MRW);
+			add_mode_write(t, EMC_MRW, next_timing->emc_mode_1);
 	}
 }
 
+static void emc_build_transition(struct emc_transition *t,
+				 const struct tegra_emc_table *next_timing,
+				 const struct tegra_emc_table *last_timing)
+{
+	t->dll_change = get_dll_change(next_timing, last_timing);
+	t->zcal_long =
+		(next_timing->burst_regs[EMC_ZCAL_INTERVAL_INDEX] != 0) &&
+		(last_timing->burst_regs[EMC_ZCAL_INTERVAL_INDEX] == 0);
+	t->vref_cal_toggle = (next_timing->emc_acal_interval != 0) &&
+		((next_timing->burst_regs[EMC_XM2COMPPADCTRL_INDEX] ^
+		  last_timing->burst_regs[EMC_XM2COMPPADCTRL_INDEX]) &
+		 EMC_XM2COMPPADCTRL_VREF_CAL_ENABLE);
+	t->qrst_possible = need_qrst(next_timing, last_timing);
+	t->periodic_qrst_change = next_timing->emc_periodic_qrst !=
+		last_timing->emc_periodic_qrst;
+	t->mrs_wait_cnt = get_mrs_wait_cnt(next_timing, t->zcal_long);
+
+	dqs_preset(t, next_timing, last_timing);
+	set_dram_mode(t, next_timing, last_timing);
+}
+
 static inline void do_clock_change(u32 clk_setting)
 {
 	int err;
@@ -505,20 +565,17 @@ static inline void do_clock_change(u32 clk_setting)
 }
 
 static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
-				   const struct tegra_emc_table *last_timing,
+				   const struct emc_transition *t,
 				   u32 clk_setting)
 {
-	int i, dll_change, pre_wait;
-	bool dyn_sref_enabled, vref_cal_toggle, qrst_used, zcal_long;
+	int i, pre_wait;
+	bool dyn_sref_enabled, qrst_used;
 
 	u32 mc_override = mc_readl(MC_EMEM_ARB_OVERRIDE);
 	u32 emc_cfg_reg = emc_readl(EMC_CFG);
 	u32 emc_dbg_reg = emc_readl(EMC_DBG);
 
 	dyn_sref_enabled = emc_cfg_reg & EMC_CFG_DYN_SREF_ENABLE;
-	dll_change = get_dll_change(next_timing, last_timing);
-	zcal_long = (next_timing->burst_regs[EMC_ZCAL_INTERVAL_INDEX] != 0) &&
-		(last_timing->burst_regs[EMC_ZCAL_INTERVAL_INDEX] == 0);
 
 	/* FIXME: remove steps enumeration below? */
 
@@ -541,7 +598,9 @@ static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
 		disable_early_ack(mc_override);
 
 	/* 2.5 check dq/dqs vref delay */
-	if (dqs_preset(next_timing, last_timing)) {
+	for (i = 0; i < t->num_dqs_presets; i++)
+		emc_writel(t->dqs_presets[i].val, t->dqs_presets[i].reg);
+	if (t->num_dqs_presets) {
 		if (pre_wait < 3)
 			pre_wait = 3;	/* 3us+ for dqs vref settled */
 	}
@@ -551,11 +610,7 @@ static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
 	}
 
 	/* 3. disable auto-cal if vref mode is switching */
-	vref_cal_toggle = (next_timing->emc_acal_interval != 0) &&
-		((next_timing->burst_regs[EMC_XM2COMPPADCTRL_INDEX] ^
-		  last_timing->burst_regs[EMC_XM2COMPPADCTRL_INDEX]) &
-		 EMC_XM2COMPPADCTRL_VREF_CAL_ENABLE);
-	if (vref_cal_toggle)
+	if (t->vref_cal_toggle)
 		auto_cal_disable();
 
 	/* 4. program burst shadow registers */
@@ -572,12 +627,13 @@ static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
 
 	/* On ddr3 when DLL is re-started predict MRS long wait count and
 	   overwrite DFS table setting */
-	if ((dram_type == DRAM_TYPE_DDR3) && (dll_change == DLL_CHANGE_ON))
-		overwrite_mrs_wait_cnt(next_timing, zcal_long);
+	if ((dram_type == DRAM_TYPE_DDR3) && (t->dll_change == DLL_CHANGE_ON))
+		emc_writel(t->mrs_wait_cnt, EMC_MRS_WAIT_CNT);
 
-	/* the last read below makes sure prev writes are completed */
-	qrst_used = need_qrst(next_timing, last_timing,
-			      emc_readl(EMC_SEL_DPD_CTRL));
+	/* the last read below makes sure prev writes are completed;
+	   QRST is needed only if QUSE DPD is disabled */
+	qrst_used = !(emc_readl(EMC_SEL_DPD_CTRL) &
+		      EMC_SEL_DPD_CTRL_QUSE_DPD_ENABLE) && t->qrst_possible;
 
 	/* 5. flow control marker 1 (no EMC read access after this) */
 	emc_writel(1, EMC_STALL_BEFORE_CLKCHANGE);
@@ -591,7 +647,7 @@ static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
 
 	/* 7. turn Off dll and enter self-refresh on DDR3 */
 	if (dram_type == DRAM_TYPE_DDR3) {
-		if (dll_change == DLL_CHANGE_OFF)
+		if (t->dll_change == DLL_CHANGE_OFF)
 			emc_writel(next_timing->emc_mode_1, EMC_EMRS);
 		emc_writel(DRAM_BROADCAST(dram_dev_num) |
 			   EMC_SELF_REF_CMD_ENABLED, EMC_SELF_REF);
@@ -606,8 +662,7 @@ static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
 		   EMC_XM2CLKPADCTRL);
 
 	/* 9. restore periodic QRST, and disable write mux */
-	if ((qrst_used) || (next_timing->emc_periodic_qrst !=
-			    last_timing->emc_periodic_qrst)) {
+	if ((qrst_used) || t->periodic_qrst_change) {
 		emc_cfg_reg = next_timing->emc_periodic_qrst ?
 			emc_cfg_reg | EMC_CFG_PERIODIC_QRST :
 			emc_cfg_reg & (~EMC_CFG_PERIODIC_QRST);
@@ -620,10 +675,11 @@ static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
 		emc_writel(DRAM_BROADCAST(dram_dev_num), EMC_SELF_REF);
 
 	/* 11. set dram mode registers */
-	set_dram_mode(next_timing, last_timing, dll_change);
+	for (i = 0; i < t->num_mode_writes; i++)
+		emc_writel(t->mode_writes[i].val, t->mode_writes[i].reg);
 
 	/* 12. issue zcal command if turning zcal On */
-	if (zcal_long) {
+	if (t->zcal_long) {
 		emc_writel(EMC_ZQ_CAL_LONG_CMD_DEV0, EMC_ZQ_CAL);
 		if (dram_dev_num > 1)
 			emc_writel(EMC_ZQ_CAL_LONG_CMD_DEV1, EMC_ZQ_CAL);
@@ -641,7 +697,7 @@ static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
 	emc_writel(EMC_REFCTRL_ENABLE_ALL(dram_dev_num), EMC_REFCTRL);
 
 	/* 15. restore auto-cal */
-	if (vref_cal_toggle)
+	if (t->vref_cal_toggle)
 		emc_writel(next_timing->emc_acal_interval,
 			   EMC_AUTO_CAL_INTERVAL);
 
@@ -654,7 +710,7 @@ static noinline void emc_set_clock(const struct tegra_emc_table *next_timing,
 	}
 
 	/* 17. set zcal wait count */
-	if (zcal_long)
+	if (t->zcal_long)
 		emc_writel(next_timing->emc_zcal_cnt_long, EMC_ZCAL_WAIT_CNT);
 
 	/* 18. update restored timing */
@@ -713,6 +769,8 @@ int tegra_emc_set_rate(unsigned long rate)
 	int i;
 	u32 clk_setting;
 	const struct tegra_emc_table *last_timing;
+	const struct emc_transition *t;
+	struct emc_transition boot_transition;
 	unsigned long flags;
 
 	if (!tegra_emc_table)
@@ -741,10 +799,19 @@ int tegra_emc_set_rate(unsigned long rate)
 	else
 		last_timing = emc_timing;
 
+	if (emc_transitions && (last_timing != &start_timing)) {
+		t = &emc_transitions[(last_timing - tegra_emc_table) *
+				     tegra_emc_table_size + i];
+	} else {
+		emc_build_transition(&boot_transition,
+				     &tegra_emc_table[i], last_timing);
+		t = &boot_transition;
+	}
+
 	clk_setting = tegra_emc_clk_sel[i].value;
 
 	spin_lock_irqsave(&emc_access_lock, flags);
-	emc_set_clock(&tegra_emc_table[i], last_timing, clk_setting);
+	emc_set_clock(&tegra_emc_table[i], t, clk_setting);
 	if (!emc_timing)
 		emc_cfg_power_restore();
 	emc_timing = &tegra_emc_table[i];
@@ -866,6 +933,30 @@ static void adjust_emc_dvfs_table(const struct tegra_emc_table *table,
 	}
 }
 
+/* Precompute switch plans between all DFS table entries */
+static void init_emc_transitions(const struct tegra_emc_table *table,
+				 int table_size)
+{
+	int from, to;
+
+	emc_transitions = kcalloc(table_size * table_size,
+				  sizeof(*emc_transitions), GFP_KERNEL);
+	if (!emc_transitions) {
+		pr_warn("tegra: no memory for EMC transition table\n");
+		return;
+	}
+
+	for (from = 0; from < table_size; from++) {
+		for (to = 0; to < table_size; to++) {
+			if (!table[from].rate || !table[to].rate)
+				continue;
+			emc_build_transition(
+				&emc_transitions[from * table_size + to],
+				&table[to], &table[from]);
+		}
+	}
+}
+
 static bool is_emc_bridge(void)
 {
 	int mv;
@@ -1043,6 +1134,8 @@ void tegra_init_emc(const struct tegra_emc_table *table, int table_size)
 	}
 	pr_info("tegra: validated EMC DFS table\n");
 
+	init_emc_transitions(tegra_emc_table, tegra_emc_table_size);
+
 	/* Configure clock change mode according to dram type */
 	reg = emc_readl(EMC_CFG_2) & (~EMC_CFG_2_MODE_MASK);
 	reg |= ((dram_type == DRAM_TYPE_LPDDR2) ? EMC_CFG_2_PD_MODE :
@@ -1191,6 +1284,105 @@ int tegra_emc_set_eack_state(unsigned long state)
 	return 0;
 }
 
+/*
+ * EMC governor: combines the inputs of the emc shared bus users into one
+ * target rate instead of stacking independent floors:
+ *
+ *  target = max(floor, iso * (1 + la_margin) + max(activity - iso,
+ *						declared * declared_pct))
+ *
+ * iso is the bandwidth declared by isochronous clients (display, camera)
+ * padded by the latency allowance margin, activity is the actmon measured
+ * demand (which includes isochronous traffic), and declared is the sum of
+ * non-isochronous client requests (3d, avp). Increases are applied at once;
+ * decreases step down one table entry at a time, no more often than every
+ * down_delay_ms.
+ */
+static bool emc_gov_enable;
+static u32 emc_gov_la_margin = 20;		/* % */
+static u32 emc_gov_declared_pct = 50;		/* % */
+static u32 emc_gov_down_delay_ms = 100;
+
+static struct {
+	unsigned long last_change;
+	u64 up_count;
+	u64 down_count;
+	u64 hold_count;
+} emc_gov_stats;
+
+static void emc_gov_work_func(struct work_struct *work)
+{
+	tegra_clk_shared_bus_update(emc);
+}
+static DECLARE_DELAYED_WORK(emc_gov_work, emc_gov_work_func);
+
+bool tegra_emc_gov_enabled(void)
+{
+	return emc_gov_enable && tegra_emc_table;
+}
+
+/* Highest valid table rate below the current one (Hz) */
+static unsigned long emc_gov_step_down(unsigned long cur_rate)
+{
+	int i;
+	unsigned long rate = 0;
+
+	cur_rate /= 1000;
+	for (i = 0; i < tegra_emc_table_size; i++) {
+		if (tegra_emc_clk_sel[i].input == NULL)
+			continue;	/* invalid entry */
+		if ((tegra_emc_table[i].rate < cur_rate) &&
+		    (tegra_emc_table[i].rate > rate))
+			rate = tegra_emc_table[i].rate;
+	}
+	return rate * 1000;
+}
+
+/* Called from emc shared bus update with emc clock lock held */
+unsigned long tegra_emc_gov_rate(unsigned long floor, unsigned long iso_bw,
+	unsigned long declared_bw, unsigned long activity,
+	unsigned long ceiling, unsigned long cur_rate)
+{
+	unsigned long target, non_iso, step, delay;
+	long rounded;
+
+	non_iso = (activity > iso_bw) ? activity - iso_bw : 0;
+	non_iso = max(non_iso, declared_bw / 100 * emc_gov_declared_pct);
+	target = iso_bw + iso_bw / 100 * emc_gov_la_margin + non_iso;
+	target = min(max(target, floor), ceiling);
+
+	/* compare and account table rates, which is what the bus runs at */
+	rounded = clk_round_rate_locked(emc, target);
+	if (rounded > 0)
+		target = rounded;
+
+	if (target >= cur_rate) {
+		if (target > cur_rate) {
+			emc_gov_stats.last_change = jiffies;
+			emc_gov_stats.up_count++;
+		}
+		return target;
+	}
+
+	delay = emc_gov_stats.last_change +
+		msecs_to_jiffies(emc_gov_down_delay_ms);
+	if (time_before(jiffies, delay)) {
+		emc_gov_stats.hold_count++;
+		schedule_delayed_work(&emc_gov_work, delay - jiffies);
+		return cur_rate;
+	}
+
+	step = emc_gov_step_down(cur_rate);
+	if (target < step) {
+		target = step;
+		schedule_delayed_work(&emc_gov_work,
+				      msecs_to_jiffies(emc_gov_down_delay_ms));
+	}
+	emc_gov_stats.last_change = jiffies;
+	emc_gov_stats.down_count++;
+	return target;
+}
+
 #ifdef CONFIG_DEBUG_FS
 
 static struct dentry *emc_debugfs_root;
@@ -1215,6 +1407,15 @@ static int emc_stats_show(struct seq_file *s, void *data)
 	seq_printf(s, "%-15s %llu\n", "time-stamp:",
 		   cputime64_to_clock_t(emc_stats.last_update));
 
+	if (emc_gov_enable) {
+		seq_printf(s, "%-15s %llu\n", "gov up:",
+			   emc_gov_stats.up_count);
+		seq_printf(s, "%-15s %llu\n", "gov down:",
+			   emc_gov_stats.down_count);
+		seq_printf(s, "%-15s %llu\n", "gov held:",
+			   emc_gov_stats.hold_count);
+	}
+
 	return 0;
 }
 
@@ -1273,6 +1474,22 @@ static int eack_state_set(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(eack_state_fops, eack_state_get,
 			eack_state_set, "%llu\n");
 
+static int gov_enable_get(void *data, u64 *val)
+{
+	*val = emc_gov_enable;
+	return 0;
+}
+static int gov_enable_set(void *data, u64 val)
+{
+	emc_gov_enable = !!val;
+	if (!emc_gov_enable)
+		cancel_delayed_work_sync(&emc_gov_work);
+	tegra_clk_shared_bus_update(emc);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(gov_enable_fops, gov_enable_get,
+			gov_enable_set, "%llu\n");
+
 static int __init tegra_emc_debug_init(void)
 {
 	if (!tegra_emc_table)
@@ -1298,6 +1515,22 @@ static int __init tegra_emc_debug_init(void)
 		"eack_state", S_IRUGO | S_IWUSR, emc_debugfs_root, NULL, &eack_state_fops))
 		goto err_out;
 
+	if (!debugfs_create_file("gov_enable", S_IRUGO | S_IWUSR,
+				 emc_debugfs_root, NULL, &gov_enable_fops))
+		goto err_out;
+
+	if (!debugfs_create_u32("gov_la_margin", S_IRUGO | S_IWUSR,
+				emc_debugfs_root, &emc_gov_la_margin))
+		goto err_out;
+
+	if (!debugfs_create_u32("gov_declared_pct", S_IRUGO | S_IWUSR,
+				emc_debugfs_root, &emc_gov_declared_pct))
+		goto err_out;
+
+	if (!debugfs_create_u32("gov_down_delay_ms", S_IRUGO | S_IWUSR,
+				emc_debugfs_root, &emc_gov_down_delay_ms))
+		goto err_out;
+
 	return 0;
 
 err_out:
@@ -60,6 +60,11 @@ int tegra_emc_get_dram_type(void);
 int tegra_emc_get_dram_temperature(void);
 int tegra_emc_set_over_temp_state(unsigned long state);
 
+bool tegra_emc_gov_enabled(void);
+unsigned long tegra_emc_gov_rate(unsigned long floor, unsigned long iso_bw,
+	unsigned long declared_bw, unsigned long activity,
+	unsigned long ceiling, unsigned long cur_rate);
+
 #ifdef CONFIG_PM_SLEEP
 void tegra_mc_timing_restore(void);
 #else
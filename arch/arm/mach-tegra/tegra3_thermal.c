@@ -25,6 +25,7 @@
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/thermal.h>
+#include <linux/workqueue.h>
 #include <mach/thermal.h>
 #include <mach/edp.h>
 #include <linux/slab.h>
@@ -34,6 +35,7 @@
 #include "dvfs.h"
 
 #define MAX_ZONES (16)
+#define EDP_TREND_PERIOD_MS (500)
 
 struct tegra_thermal {
 	struct tegra_thermal_device *device;
@@ -51,6 +53,8 @@ struct tegra_thermal {
 	int edp_thermal_zone_val;
 	long edp_offset;
 	long hysteresis_edp;
+	struct delayed_work edp_trend_work;
+	unsigned int edp_trend_period;
 #endif
 	struct mutex mutex;
 };
@@ -166,6 +170,32 @@ static void tegra_therm_throttle(bool enable)
 }
 #endif
 
+#ifdef CONFIG_TEGRA_EDP_LIMITS
+/*
+ * Sample Tj periodically for the predictive EDP trim; the alert only fires
+ * on window crossings, which is too coarse to estimate a slope. Deferrable,
+ * so an idle system is not woken just to read the sensor.
+ */
+static void tegra_thermal_edp_trend_work(struct work_struct *work)
+{
+	struct tegra_thermal *thermal = container_of(to_delayed_work(work),
+					struct tegra_thermal, edp_trend_work);
+	long temp_dev, temp_tj;
+
+	mutex_lock(&thermal->mutex);
+	if (!thermal->device->get_temp(thermal->device->data, &temp_dev)) {
+		temp_tj = dev2tj(thermal->device, temp_dev);
+		tegra_edp_update_thermal_trend(tj2edp(thermal, temp_tj),
+				tj2edp(thermal, thermal->temp_throttle_tj));
+	}
+	mutex_unlock(&thermal->mutex);
+
+	if (thermal->edp_trend_period)
+		queue_delayed_work(system_freezable_wq, &thermal->edp_trend_work,
+				   msecs_to_jiffies(thermal->edp_trend_period));
+}
+#endif
+
 /* Make sure this function remains stateless */
 void tegra_thermal_alert(void *data)
 {
@@ -325,6 +355,12 @@ int tegra_thermal_set_device(struct tegra_thermal_device *device)
 	/* initialize limits */
 	tegra_thermal_alert(&thermal_state);
 
+#ifdef CONFIG_TEGRA_EDP_LIMITS
+	if (thermal_state.edp_trend_period)
+		queue_delayed_work(system_freezable_wq,
+				   &thermal_state.edp_trend_work, 0);
+#endif
+
 	return 0;
 }
 
@@ -343,6 +379,9 @@ int __init tegra_thermal_init(struct tegra_thermal_data *data)
 #ifdef CONFIG_TEGRA_EDP_LIMITS
 	thermal_state.edp_offset = data->edp_offset;
 	thermal_state.hysteresis_edp = data->hysteresis_edp;
+	thermal_state.edp_trend_period = EDP_TREND_PERIOD_MS;
+	INIT_DELAYED_WORK_DEFERRABLE(&thermal_state.edp_trend_work,
+				     tegra_thermal_edp_trend_work);
 #endif
 	thermal_state.temp_throttle_tj = data->temp_throttle +
 						data->temp_offset;
@@ -354,6 +393,11 @@ int __init tegra_thermal_init(struct tegra_thermal_data *data)
 
 int tegra_thermal_exit(void)
 {
+#ifdef CONFIG_TEGRA_EDP_LIMITS
+	thermal_state.edp_trend_period = 0;
+	cancel_delayed_work_sync(&thermal_state.edp_trend_work);
+	tegra_edp_stop_thermal_trend();
+#endif
 #ifdef CONFIG_TEGRA_THERMAL_SYSFS
 	if (thermal_state.thz)
 		thermal_zone_device_unregister(thermal_state.thz);
@@ -500,6 +544,31 @@ DEFINE_SIMPLE_ATTRIBUTE(passive_delay_fops,
 			"%llu\n");
 #endif
 
+#ifdef CONFIG_TEGRA_EDP_LIMITS
+static int tegra_thermal_edp_trend_period_set(void *data, u64 val)
+{
+	cancel_delayed_work_sync(&thermal_state.edp_trend_work);
+	thermal_state.edp_trend_period = val;
+
+	if (val && thermal_state.device)
+		queue_delayed_work(system_freezable_wq,
+				   &thermal_state.edp_trend_work, 0);
+	else
+		tegra_edp_stop_thermal_trend();
+	return 0;
+}
+
+static int tegra_thermal_edp_trend_period_get(void *data, u64 *val)
+{
+	*val = (u64)thermal_state.edp_trend_period;
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(edp_trend_period_fops,
+			tegra_thermal_edp_trend_period_get,
+			tegra_thermal_edp_trend_period_set,
+			"%llu\n");
+#endif
 
 static struct dentry *thermal_debugfs_root;
 
@@ -533,6 +602,13 @@ static int __init tegra_thermal_debug_init(void)
 		goto err_out;
 #endif
 
+#ifdef CONFIG_TEGRA_EDP_LIMITS
+	if (!debugfs_create_file("edp_trend_period", 0644,
+				 thermal_debugfs_root, NULL,
+				 &edp_trend_period_fops))
+		goto err_out;
+#endif
+
 	return 0;
 
 err_out:
@@ -27,6 +27,7 @@
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/thermal.h>
+#include <mach/edp.h>
 
 #include "clock.h"
 #include "cpu-tegra.h"
@@ -86,7 +87,14 @@ static void tegra_throttle_work_func(struct work_struct *work)
 	}
 
 	cpu_freq = tegra_getspeed(0);
-	throttle_index -= throttle_index ? 1 : 0;
+
+	/*
+	 * Step deeper only while Tj is still rising: once the current step
+	 * has the temperature falling, hold it instead of collapsing to the
+	 * floor rate.
+	 */
+	if (tegra_edp_thermal_slope() >= 0)
+		throttle_index -= throttle_index ? 1 : 0;
 
 	core_level = throttle_table[throttle_index].core_cap_level;
 	if (throttle_table[throttle_index].cpu_freq < cpu_freq)
@@ -156,6 +164,12 @@ unsigned int tegra_throttle_governor_speed(unsigned int requested_speed)
 		requested_speed;
 }
 
+/* Cap applied as soon as throttling starts */
+unsigned int tegra_throttle_entry_speed(void)
+{
+	return throttle_table[ARRAY_SIZE(throttle_table) - 1].cpu_freq;
+}
+
 bool tegra_is_throttling(void)
 {
 	return is_throttling;
@@ -31,6 +31,10 @@
 #include <linux/input.h>
 #include <asm/cputime.h>
 #include <linux/pm_qos_params.h>
+#include <linux/math64.h>
+
+#define POLICY_DIV64(a, b)	div64_u64(a, b)
+#include "cpufreq_interactive_policy.h"
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/cpufreq_interactive.h>
@@ -39,6 +43,7 @@ static atomic_t active_count = ATOMIC_INIT(0);
 
 struct cpufreq_interactive_cpuinfo {
 	struct timer_list cpu_timer;
+	struct timer_list cpu_slack_timer;
 	int timer_idlecancel;
 	u64 time_in_idle;
 	u64 time_in_iowait;
@@ -51,6 +56,7 @@ struct cpufreq_interactive_cpuinfo {
 	struct cpufreq_policy *policy;
 	struct cpufreq_frequency_table *freq_table;
 	unsigned int target_freq;
+	unsigned int target_set;	/* last target handed to the driver */
 	unsigned int floor_freq;
 	u64 floor_validate_time;
 	int governor_enabled;
@@ -58,30 +64,25 @@ struct cpufreq_interactive_cpuinfo {
 
 static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
 
-/* Workqueues handle frequency scaling */
-static struct task_struct *up_task;
+/*
+ * Frequency changes in both directions are applied by one realtime
+ * thread. Each CPU only writes its own target_freq, and the thread picks
+ * up every target that differs from what was last handed to the driver,
+ * so no shared mask or lock is needed between samplers.
+ */
+static struct task_struct *speedchange_task;
 static struct workqueue_struct *down_wq;
-static struct work_struct freq_scale_down_work;
-static cpumask_t up_cpumask;
-static spinlock_t up_cpumask_lock;
-static cpumask_t down_cpumask;
-static spinlock_t down_cpumask_lock;
 static struct mutex set_speed_lock;
 
 struct cpufreq_interactive_core_lock {
 	struct pm_qos_request_list qos_min_req;
-	struct pm_qos_request_list qos_max_req;
 	struct task_struct *lock_task;
 	struct work_struct unlock_work;
 	struct timer_list unlock_timer;
 	int request_active;
-	unsigned long lock_period;
 	struct mutex mutex;
 };
 
-/* default timeout for core lock down */
-#define DEFAULT_CORE_LOCK_PERIOD 200000 /* 200 ms */
-
 static struct cpufreq_interactive_core_lock core_lock;
 
 
@@ -123,6 +124,13 @@ static unsigned long min_sample_time;
 #define DEFAULT_TIMER_RATE 20000;
 static unsigned long timer_rate;
 
+/*
+ * Max additional time to wait in idle, beyond timer_rate, at speeds above
+ * minimum before wakeup to reduce speed, or -1 if unnecessary.
+ */
+#define DEFAULT_TIMER_SLACK 80000
+static int timer_slack_val = DEFAULT_TIMER_SLACK;
+
 /*
  * Wait this long before raising speed above hispeed, by default a single
  * timer interval.
@@ -135,6 +143,32 @@ static unsigned long above_hispeed_delay_val;
  */
 static int input_boost_val;
 
+/*
+ * On input, keep at least input_boost_cores on-line (a G-cluster request,
+ * so LP switches to G right away) and hold a frequency floor of
+ * input_boost_freq (hispeed_freq if 0) for input_boost_hold us after the
+ * last input event; the floor then decays linearly over input_boost_decay.
+ */
+#define DEFAULT_INPUT_BOOST_CORES 2
+#define DEFAULT_INPUT_BOOST_HOLD 200000 /* 200 ms */
+#define DEFAULT_INPUT_BOOST_DECAY 300000 /* 300 ms */
+static unsigned long input_boost_cores;
+static unsigned long input_boost_freq;
+static unsigned long input_boost_hold;
+static unsigned long input_boost_decay;
+
+static spinlock_t input_boost_lock;
+static u64 input_boost_time;	/* last input event, us */
+static u64 input_boost_event_time;	/* first event not yet served, us */
+static bool input_boost_pending;
+
+/* input event to cores/cluster boost in place */
+static struct {
+	unsigned int count;
+	u64 total_us;
+	u64 max_us;
+} input_boost_stats;
+
 struct cpufreq_interactive_inputopen {
 	struct input_handle *handle;
 	struct work_struct inputopen_work;
@@ -160,72 +194,61 @@ struct cpufreq_governor cpufreq_gov_interactive = {
 	.owner = THIS_MODULE,
 };
 
-static unsigned int cpufreq_interactive_get_target(
-	int cpu_load, int load_since_change,
-	struct cpufreq_interactive_cpuinfo *pcpu)
+static unsigned int cpufreq_interactive_input_floor(u64 now)
 {
-	unsigned int target_freq;
-
-	/*
-	 * Choose greater of short-term load (since last idle timer
-	 * started or timer function re-armed itself) or long-term load
-	 * (since last frequency change).
-	 */
-	if (load_since_change > cpu_load)
-		cpu_load = load_since_change;
-
-	/* Exponential boost policy */
-	if (boost_factor) {
-
-		if (cpu_load >= go_maxspeed_load) {
-			target_freq = pcpu->policy->cur * boost_factor;
-
-			if (max_boost &&
-				target_freq > pcpu->policy->cur + max_boost)
-
-				target_freq = pcpu->policy->cur + max_boost;
-		} else {
+	unsigned long flags;
+	u64 elapsed;
 
-			if (!sustain_load)
-				sustain_load = 100;
+	spin_lock_irqsave(&input_boost_lock, flags);
+	elapsed = now - input_boost_time;
+	if (!input_boost_time || (now < input_boost_time))
+		elapsed = input_boost_hold + input_boost_decay;
+	spin_unlock_irqrestore(&input_boost_lock, flags);
 
-			target_freq =
-				(pcpu->policy->cur * cpu_load / sustain_load);
-		}
+	return cpufreq_interactive_policy_input_floor(
+		input_boost_freq ? : hispeed_freq, elapsed,
+		input_boost_hold, input_boost_decay);
+}
 
-		goto done;
-	}
+static void cpufreq_interactive_get_tunables(
+	struct cpufreq_interactive_tunables *t)
+{
+	t->go_maxspeed_load = go_maxspeed_load;
+	t->go_hispeed_load = go_hispeed_load;
+	t->boost_factor = boost_factor;
+	t->max_boost = max_boost;
+	t->sustain_load = sustain_load;
+	t->above_hispeed_delay = above_hispeed_delay_val;
+	t->min_sample_time = min_sample_time;
+	t->hispeed_freq = hispeed_freq;
+	t->boost = boost_val;
+}
 
-	/* Jump boost policy */
-	if (cpu_load >= go_hispeed_load || boost_val) {
-		if (pcpu->target_freq <= pcpu->policy->min) {
-			target_freq = hispeed_freq;
-		} else {
-			target_freq = pcpu->policy->max * cpu_load / 100;
-
-			if (target_freq < hispeed_freq)
-				target_freq = hispeed_freq;
-
-			if (pcpu->target_freq == hispeed_freq &&
-			    target_freq > hispeed_freq &&
-			    cputime64_sub(pcpu->timer_run_time,
-					  pcpu->freq_change_time)
-			    < above_hispeed_delay_val) {
-
-				target_freq = pcpu->target_freq;
-				trace_cpufreq_interactive_notyet(
-							smp_processor_id(),
-							cpu_load,
-							pcpu->target_freq,
-							target_freq);
-			}
-		}
-	} else {
-		target_freq = pcpu->policy->max * cpu_load / 100;
-	}
+static unsigned int cpufreq_interactive_get_target(
+	int cpu_load, int load_since_change,
+	struct cpufreq_interactive_cpuinfo *pcpu,
+	const struct cpufreq_interactive_tunables *t)
+{
+	struct cpufreq_interactive_sample s = {
+		.load = cpu_load,
+		.load_since_change = load_since_change,
+		.cur = pcpu->policy->cur,
+		.min = pcpu->policy->min,
+		.max = pcpu->policy->max,
+		.target = pcpu->target_freq,
+		.now = pcpu->timer_run_time,
+		.freq_change_time = pcpu->freq_change_time,
+		.floor = input_boost_val ?
+			cpufreq_interactive_input_floor(pcpu->timer_run_time) : 0,
+	};
+	unsigned int target_freq;
+	bool notyet;
 
-done:
-	target_freq = min(target_freq, pcpu->policy->max);
+	target_freq = cpufreq_interactive_policy_target(t, &s, &notyet);
+	if (notyet)
+		trace_cpufreq_interactive_notyet(smp_processor_id(),
+						 max(cpu_load, load_since_change),
+						 pcpu->target_freq, target_freq);
 	return target_freq;
 }
 
@@ -256,7 +279,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	u64 now_iowait;
 	unsigned int new_freq;
 	unsigned int index;
-	unsigned long flags;
+	struct cpufreq_interactive_tunables t;
 
 	smp_rmb();
 
@@ -327,8 +350,13 @@ static void cpufreq_interactive_timer(unsigned long data)
 	 *
 	 * This function implements the cpufreq scaling policy
 	 */
+	cpufreq_interactive_get_tunables(&t);
 	new_freq = cpufreq_interactive_get_target(cpu_load, load_since_change,
-						pcpu);
+						  pcpu, &t);
+
+	/* Latency sensitive tasks runnable here: at least hispeed_freq */
+	if (nr_latency_sensitive_cpu(data) && new_freq < hispeed_freq)
+		new_freq = min_t(unsigned int, hispeed_freq, pcpu->policy->max);
 
 	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
 					   new_freq, CPUFREQ_RELATION_H,
@@ -340,19 +368,12 @@ static void cpufreq_interactive_timer(unsigned long data)
 
 	new_freq = pcpu->freq_table[index].frequency;
 
-	/*
-	 * Do not scale below floor_freq unless we have been at or above the
-	 * floor frequency for the minimum sample time since last validated.
-	 */
-	if (new_freq < pcpu->floor_freq) {
-		if (cputime64_sub(pcpu->timer_run_time,
-				  pcpu->floor_validate_time)
-		    < min_sample_time) {
-
-			trace_cpufreq_interactive_notyet(data, cpu_load,
-					pcpu->target_freq, new_freq);
-			goto rearm;
-		}
+	if (cpufreq_interactive_policy_hold(&t, new_freq, pcpu->floor_freq,
+					    pcpu->timer_run_time,
+					    pcpu->floor_validate_time)) {
+		trace_cpufreq_interactive_notyet(data, cpu_load,
+				pcpu->target_freq, new_freq);
+		goto rearm;
 	}
 
 	pcpu->floor_freq = new_freq;
@@ -367,19 +388,8 @@ static void cpufreq_interactive_timer(unsigned long data)
 	trace_cpufreq_interactive_target(data, cpu_load, pcpu->target_freq,
 					new_freq);
 
-	if (new_freq < pcpu->target_freq) {
-		pcpu->target_freq = new_freq;
-		spin_lock_irqsave(&down_cpumask_lock, flags);
-		cpumask_set_cpu(data, &down_cpumask);
-		spin_unlock_irqrestore(&down_cpumask_lock, flags);
-		queue_work(down_wq, &freq_scale_down_work);
-	} else {
-		pcpu->target_freq = new_freq;
-		spin_lock_irqsave(&up_cpumask_lock, flags);
-		cpumask_set_cpu(data, &up_cpumask);
-		spin_unlock_irqrestore(&up_cpumask_lock, flags);
-		wake_up_process(up_task);
-	}
+	pcpu->target_freq = new_freq;
+	wake_up_process(speedchange_task);
 
 rearm_if_notmax:
 	/*
@@ -410,14 +420,26 @@ rearm:
 		pcpu->time_in_iowait = get_cpu_iowait_time(
 			data, NULL);
 
-		mod_timer(&pcpu->cpu_timer,
+		mod_timer_pinned(&pcpu->cpu_timer,
 			  jiffies + usecs_to_jiffies(timer_rate));
+
+		/* still idle above min - keep the slack timer behind it */
+		if (pcpu->idling && timer_slack_val >= 0 &&
+		    pcpu->target_freq != pcpu->policy->min)
+			mod_timer_pinned(&pcpu->cpu_slack_timer,
+				pcpu->cpu_timer.expires +
+				usecs_to_jiffies(timer_slack_val));
 	}
 
 exit:
 	return;
 }
 
+/* Only there to wake an idle CPU for its deferrable sampling timer */
+static void cpufreq_interactive_nop_timer(unsigned long data)
+{
+}
+
 static void cpufreq_interactive_idle_start(void)
 {
 	struct cpufreq_interactive_cpuinfo *pcpu =
@@ -447,9 +469,19 @@ static void cpufreq_interactive_idle_start(void)
 			pcpu->time_in_iowait = get_cpu_iowait_time(
 				smp_processor_id(), NULL);
 			pcpu->timer_idlecancel = 0;
-			mod_timer(&pcpu->cpu_timer,
+			mod_timer_pinned(&pcpu->cpu_timer,
 				  jiffies + usecs_to_jiffies(timer_rate));
 		}
+
+		/*
+		 * The sampling timer is deferrable and will not wake this
+		 * CPU by itself; the slack timer does, timer_slack_val
+		 * after the sample was due.
+		 */
+		if (timer_slack_val >= 0)
+			mod_timer_pinned(&pcpu->cpu_slack_timer,
+				pcpu->cpu_timer.expires +
+				usecs_to_jiffies(timer_slack_val));
 #endif
 	} else {
 		/*
@@ -472,6 +504,27 @@ static void cpufreq_interactive_idle_start(void)
 
 }
 
+/*
+ * Leaving idle to run a latency sensitive task: go to hispeed_freq now
+ * rather than on the next timer sample.
+ */
+static void cpufreq_interactive_latency_boost(
+	struct cpufreq_interactive_cpuinfo *pcpu)
+{
+	unsigned int cpu = smp_processor_id();
+
+	if (!pcpu->governor_enabled || !nr_latency_sensitive_cpu(cpu) ||
+	    pcpu->target_freq >= hispeed_freq)
+		return;
+
+	pcpu->floor_freq = min_t(unsigned int, hispeed_freq,
+				 pcpu->policy->max);
+	pcpu->floor_validate_time = ktime_to_us(ktime_get());
+	pcpu->target_freq = pcpu->floor_freq;
+
+	wake_up_process(speedchange_task);
+}
+
 static void cpufreq_interactive_idle_end(void)
 {
 	struct cpufreq_interactive_cpuinfo *pcpu =
@@ -480,6 +533,9 @@ static void cpufreq_interactive_idle_end(void)
 	pcpu->idling = 0;
 	smp_wmb();
 
+	del_timer(&pcpu->cpu_slack_timer);
+	cpufreq_interactive_latency_boost(pcpu);
+
 	/*
 	 * Arm the timer for 1-2 ticks later if not already, and if the timer
 	 * function has already processed the previous load sampling
@@ -501,65 +557,92 @@ static void cpufreq_interactive_idle_end(void)
 			get_cpu_iowait_time(smp_processor_id(),
 						NULL);
 		pcpu->timer_idlecancel = 0;
-		mod_timer(&pcpu->cpu_timer,
+		mod_timer_pinned(&pcpu->cpu_timer,
 			  jiffies + usecs_to_jiffies(timer_rate));
 	}
 
 }
 
-static int cpufreq_interactive_up_task(void *data)
+/*
+ * CPU whose target differs from what was last handed to the driver,
+ * highest target first: with per-CPU policies sharing one clock, the
+ * first request then settles the combined rate and the rest are mostly
+ * no-ops for the driver.
+ */
+static unsigned int cpufreq_interactive_next_speedchange(void)
+{
+	unsigned int cpu, next = nr_cpu_ids;
+	unsigned int next_freq = 0;
+
+	for_each_online_cpu(cpu) {
+		struct cpufreq_interactive_cpuinfo *pcpu =
+			&per_cpu(cpuinfo, cpu);
+		unsigned int target = ACCESS_ONCE(pcpu->target_freq);
+
+		if (!pcpu->governor_enabled || (target == pcpu->target_set))
+			continue;
+
+		if ((next == nr_cpu_ids) || (target > next_freq)) {
+			next = cpu;
+			next_freq = target;
+		}
+	}
+	return next;
+}
+
+static int cpufreq_interactive_speedchange_task(void *data)
 {
 	unsigned int cpu;
-	cpumask_t tmp_mask;
-	unsigned long flags;
+	unsigned int n;
 	struct cpufreq_interactive_cpuinfo *pcpu;
 
 	while (1) {
 		set_current_state(TASK_INTERRUPTIBLE);
-		spin_lock_irqsave(&up_cpumask_lock, flags);
 
-		if (cpumask_empty(&up_cpumask)) {
-			spin_unlock_irqrestore(&up_cpumask_lock, flags);
+		if (cpufreq_interactive_next_speedchange() >= nr_cpu_ids) {
 			schedule();
 
 			if (kthread_should_stop())
 				break;
-
-			spin_lock_irqsave(&up_cpumask_lock, flags);
 		}
 
 		set_current_state(TASK_RUNNING);
-		tmp_mask = up_cpumask;
-		cpumask_clear(&up_cpumask);
-		spin_unlock_irqrestore(&up_cpumask_lock, flags);
+		mutex_lock(&set_speed_lock);
 
-		for_each_cpu(cpu, &tmp_mask) {
+		for (n = 0; n < nr_cpu_ids; n++) {
 			unsigned int j;
 			unsigned int max_freq = 0;
+			unsigned int old_freq;
+
+			cpu = cpufreq_interactive_next_speedchange();
+			if (cpu >= nr_cpu_ids)
+				break;
 
 			pcpu = &per_cpu(cpuinfo, cpu);
 			smp_rmb();
 
-			if (!pcpu->governor_enabled)
-				continue;
-
-			mutex_lock(&set_speed_lock);
-
+			old_freq = pcpu->target_set;
 			for_each_cpu(j, pcpu->policy->cpus) {
 				struct cpufreq_interactive_cpuinfo *pjcpu =
 					&per_cpu(cpuinfo, j);
+				unsigned int target =
+					ACCESS_ONCE(pjcpu->target_freq);
 
-				if (pjcpu->target_freq > max_freq)
-					max_freq = pjcpu->target_freq;
+				pjcpu->target_set = target;
+				if (target > max_freq)
+					max_freq = target;
 			}
 
 			__cpufreq_driver_target(pcpu->policy,
 						max_freq,
 						CPUFREQ_RELATION_H);
-			mutex_unlock(&set_speed_lock);
 
-			trace_cpufreq_interactive_up(cpu, pcpu->target_freq,
-						pcpu->policy->cur);
+			if (pcpu->target_set > old_freq)
+				trace_cpufreq_interactive_up(cpu,
+					pcpu->target_set, pcpu->policy->cur);
+			else
+				trace_cpufreq_interactive_down(cpu,
+					pcpu->target_set, pcpu->policy->cur);
 
 			pcpu->freq_change_time_in_idle =
 				get_cpu_idle_time_us(cpu,
@@ -567,74 +650,24 @@ static int cpufreq_interactive_up_task(void *data)
 			pcpu->freq_change_time_in_iowait =
 				get_cpu_iowait_time(cpu, NULL);
 		}
-	}
-
-	return 0;
-}
-
-static void cpufreq_interactive_freq_down(struct work_struct *work)
-{
-	unsigned int cpu;
-	cpumask_t tmp_mask;
-	unsigned long flags;
-	struct cpufreq_interactive_cpuinfo *pcpu;
-
-	spin_lock_irqsave(&down_cpumask_lock, flags);
-	tmp_mask = down_cpumask;
-	cpumask_clear(&down_cpumask);
-	spin_unlock_irqrestore(&down_cpumask_lock, flags);
-
-	for_each_cpu(cpu, &tmp_mask) {
-		unsigned int j;
-		unsigned int max_freq = 0;
-
-		pcpu = &per_cpu(cpuinfo, cpu);
-		smp_rmb();
-
-		if (!pcpu->governor_enabled)
-			continue;
-
-		mutex_lock(&set_speed_lock);
-
-		for_each_cpu(j, pcpu->policy->cpus) {
-			struct cpufreq_interactive_cpuinfo *pjcpu =
-				&per_cpu(cpuinfo, j);
-
-			if (pjcpu->target_freq > max_freq)
-				max_freq = pjcpu->target_freq;
-		}
-
-		__cpufreq_driver_target(pcpu->policy, max_freq,
-					CPUFREQ_RELATION_H);
 
 		mutex_unlock(&set_speed_lock);
-
-		trace_cpufreq_interactive_down(cpu, pcpu->target_freq,
-					pcpu->policy->cur);
-
-		pcpu->freq_change_time_in_idle =
-			get_cpu_idle_time_us(cpu,
-					     &pcpu->freq_change_time);
-		pcpu->freq_change_time_in_iowait =
-			get_cpu_iowait_time(cpu, NULL);
 	}
+
+	return 0;
 }
 
-static void cpufreq_interactive_boost(void)
+static void cpufreq_interactive_boost(unsigned int freq)
 {
 	int i;
 	int anyboost = 0;
-	unsigned long flags;
 	struct cpufreq_interactive_cpuinfo *pcpu;
 
-	spin_lock_irqsave(&up_cpumask_lock, flags);
-
 	for_each_online_cpu(i) {
 		pcpu = &per_cpu(cpuinfo, i);
 
-		if (pcpu->target_freq < hispeed_freq) {
-			pcpu->target_freq = hispeed_freq;
-			cpumask_set_cpu(i, &up_cpumask);
+		if (pcpu->target_freq < freq) {
+			pcpu->target_freq = freq;
 			anyboost = 1;
 		}
 
@@ -642,14 +675,12 @@ static void cpufreq_interactive_boost(void)
 		 * validated.
 		 */
 
-		pcpu->floor_freq = hispeed_freq;
+		pcpu->floor_freq = freq;
 		pcpu->floor_validate_time = ktime_to_us(ktime_get());
 	}
 
-	spin_unlock_irqrestore(&up_cpumask_lock, flags);
-
 	if (anyboost)
-		wake_up_process(up_task);
+		wake_up_process(speedchange_task);
 }
 
 static void cpufreq_interactive_core_lock_timer(unsigned long data)
@@ -672,22 +703,22 @@ static void cpufreq_interactive_unlock_cores(struct work_struct *wq)
 	pm_qos_update_request(&cl->qos_min_req,
 			PM_QOS_MIN_ONLINE_CPUS_DEFAULT_VALUE);
 
-	pm_qos_update_request(&cl->qos_max_req,
-			PM_QOS_MAX_ONLINE_CPUS_DEFAULT_VALUE);
-
 done:
 	mutex_unlock(&cl->mutex);
 }
 
-/* Lock down to whatever # of cores online
- * right now.
+/* Keep at least input_boost_cores on-line until the boost window
+ * expires.
  *
  * A pm_qos request for 1 online CPU results in
  * an instant cluster switch.
  */
 static void cpufreq_interactive_lock_cores(void)
 {
-	unsigned int ncpus;
+	unsigned long flags;
+	bool pending;
+	u64 event_time;
+	u64 latency;
 
 	mutex_lock(&core_lock.mutex);
 
@@ -695,16 +726,28 @@ static void cpufreq_interactive_lock_cores(void)
 		goto arm_timer;
 	}
 
-	ncpus = num_online_cpus();
-	pm_qos_update_request(&core_lock.qos_min_req, ncpus);
-	pm_qos_update_request(&core_lock.qos_max_req, ncpus);
+	pm_qos_update_request(&core_lock.qos_min_req, input_boost_cores);
 	core_lock.request_active++;
 
 arm_timer:
-	mod_timer(&core_lock.unlock_timer,
-			jiffies + usecs_to_jiffies(core_lock.lock_period));
+	mod_timer(&core_lock.unlock_timer, jiffies +
+		  usecs_to_jiffies(input_boost_hold + input_boost_decay));
 
 	mutex_unlock(&core_lock.mutex);
+
+	spin_lock_irqsave(&input_boost_lock, flags);
+	pending = input_boost_pending;
+	event_time = input_boost_event_time;
+	input_boost_pending = false;
+	spin_unlock_irqrestore(&input_boost_lock, flags);
+
+	if (!pending)
+		return;
+
+	latency = ktime_to_us(ktime_get()) - event_time;
+	input_boost_stats.count++;
+	input_boost_stats.total_us += latency;
+	input_boost_stats.max_us = max(input_boost_stats.max_us, latency);
 }
 
 static int cpufreq_interactive_lock_cores_task(void *data)
@@ -727,9 +770,22 @@ static void cpufreq_interactive_input_event(struct input_handle *handle,
 					    unsigned int type,
 					    unsigned int code, int value)
 {
+	unsigned long flags;
+	u64 now;
+
 	if (input_boost_val && type == EV_SYN && code == SYN_REPORT) {
+		now = ktime_to_us(ktime_get());
+
+		spin_lock_irqsave(&input_boost_lock, flags);
+		input_boost_time = now;
+		if (!input_boost_pending) {
+			input_boost_event_time = now;
+			input_boost_pending = true;
+		}
+		spin_unlock_irqrestore(&input_boost_lock, flags);
+
 		wake_up_process(core_lock.lock_task);
-		cpufreq_interactive_boost();
+		cpufreq_interactive_boost(input_boost_freq ? : hispeed_freq);
 	}
 }
 
@@ -1024,6 +1080,29 @@ static ssize_t store_timer_rate(struct kobject *kobj,
 static struct global_attr timer_rate_attr = __ATTR(timer_rate, 0644,
 		show_timer_rate, store_timer_rate);
 
+static ssize_t show_timer_slack(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", timer_slack_val);
+}
+
+static ssize_t store_timer_slack(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	long val;
+
+	ret = strict_strtol(buf, 10, &val);
+	if (ret < 0)
+		return ret;
+	if (val < -1 || val > INT_MAX)
+		return -EINVAL;
+	timer_slack_val = val;
+	return count;
+}
+
+define_one_global_rw(timer_slack);
+
 static ssize_t show_input_boost(struct kobject *kobj, struct attribute *attr,
 				char *buf)
 {
@@ -1045,6 +1124,102 @@ static ssize_t store_input_boost(struct kobject *kobj, struct attribute *attr,
 
 define_one_global_rw(input_boost);
 
+static ssize_t show_input_boost_cores(struct kobject *kobj,
+				      struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", input_boost_cores);
+}
+
+static ssize_t store_input_boost_cores(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	input_boost_cores = val;
+	return count;
+}
+
+define_one_global_rw(input_boost_cores);
+
+static ssize_t show_input_boost_freq(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", input_boost_freq);
+}
+
+static ssize_t store_input_boost_freq(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	input_boost_freq = val;
+	return count;
+}
+
+define_one_global_rw(input_boost_freq);
+
+static ssize_t show_input_boost_hold(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", input_boost_hold);
+}
+
+static ssize_t store_input_boost_hold(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	input_boost_hold = val;
+	return count;
+}
+
+define_one_global_rw(input_boost_hold);
+
+static ssize_t show_input_boost_decay(struct kobject *kobj,
+				      struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", input_boost_decay);
+}
+
+static ssize_t store_input_boost_decay(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	input_boost_decay = val;
+	return count;
+}
+
+define_one_global_rw(input_boost_decay);
+
+static ssize_t show_input_boost_latency(struct kobject *kobj,
+					struct attribute *attr, char *buf)
+{
+	unsigned int count = input_boost_stats.count;
+
+	return sprintf(buf, "count %u avg_us %llu max_us %llu\n", count,
+		       count ? div_u64(input_boost_stats.total_us, count) : 0,
+		       input_boost_stats.max_us);
+}
+
+define_one_global_ro(input_boost_latency);
+
 static ssize_t show_boost(struct kobject *kobj, struct attribute *attr,
 			  char *buf)
 {
@@ -1064,7 +1239,7 @@ static ssize_t store_boost(struct kobject *kobj, struct attribute *attr,
 	boost_val = val;
 
 	if (boost_val)
-		cpufreq_interactive_boost();
+		cpufreq_interactive_boost(hispeed_freq);
 
 	if (!boost_val)
 		trace_cpufreq_interactive_unboost(hispeed_freq);
@@ -1085,7 +1260,13 @@ static struct attribute *interactive_attributes[] = {
 	&above_hispeed_delay.attr,
 	&min_sample_time_attr.attr,
 	&timer_rate_attr.attr,
+	&timer_slack.attr,
 	&input_boost.attr,
+	&input_boost_cores.attr,
+	&input_boost_freq.attr,
+	&input_boost_hold.attr,
+	&input_boost_decay.attr,
+	&input_boost_latency.attr,
 	&boost.attr,
 	NULL,
 };
@@ -1115,6 +1296,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			pcpu = &per_cpu(cpuinfo, j);
 			pcpu->policy = policy;
 			pcpu->target_freq = policy->cur;
+			pcpu->target_set = pcpu->target_freq;
 			pcpu->freq_table = freq_table;
 			pcpu->freq_change_time_in_idle =
 				get_cpu_idle_time_us(j,
@@ -1161,6 +1343,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			pcpu->governor_enabled = 0;
 			smp_wmb();
 			del_timer_sync(&pcpu->cpu_timer);
+			del_timer_sync(&pcpu->cpu_slack_timer);
 
 			/*
 			 * Reset idle exit time since we may cancel the timer
@@ -1171,7 +1354,6 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			pcpu->idle_exit_time = 0;
 		}
 
-		flush_work(&freq_scale_down_work);
 		if (atomic_dec_return(&active_count) > 0)
 			return 0;
 
@@ -1224,49 +1406,49 @@ static int __init cpufreq_interactive_init(void)
 	min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
 	above_hispeed_delay_val = DEFAULT_ABOVE_HISPEED_DELAY;
 	timer_rate = DEFAULT_TIMER_RATE;
+	input_boost_cores = DEFAULT_INPUT_BOOST_CORES;
+	input_boost_hold = DEFAULT_INPUT_BOOST_HOLD;
+	input_boost_decay = DEFAULT_INPUT_BOOST_DECAY;
 
 	/* Initalize per-cpu timers */
 	for_each_possible_cpu(i) {
 		pcpu = &per_cpu(cpuinfo, i);
-		init_timer(&pcpu->cpu_timer);
+		init_timer_deferrable(&pcpu->cpu_timer);
 		pcpu->cpu_timer.function = cpufreq_interactive_timer;
 		pcpu->cpu_timer.data = i;
+
+		init_timer(&pcpu->cpu_slack_timer);
+		pcpu->cpu_slack_timer.function =
+			cpufreq_interactive_nop_timer;
 	}
 
-	up_task = kthread_create(cpufreq_interactive_up_task, NULL,
-				 "kinteractiveup");
-	if (IS_ERR(up_task))
-		return PTR_ERR(up_task);
+	speedchange_task = kthread_create(
+		cpufreq_interactive_speedchange_task, NULL, "kinteractive");
+	if (IS_ERR(speedchange_task))
+		return PTR_ERR(speedchange_task);
 
-	sched_setscheduler_nocheck(up_task, SCHED_FIFO, &param);
-	get_task_struct(up_task);
+	sched_setscheduler_nocheck(speedchange_task, SCHED_FIFO, &param);
+	get_task_struct(speedchange_task);
 
-	/* No rescuer thread, bind to CPU queuing the work for possibly
-	   warm cache (probably doesn't matter much). */
+	/* Core unlock and input handler registration; speed changes in
+	   both directions go through speedchange_task. No rescuer thread,
+	   bound to the CPU queuing the work. */
 	down_wq = alloc_workqueue("knteractive_down", 0, 1);
 
 	if (!down_wq)
 		goto err_freeuptask;
 
-	INIT_WORK(&freq_scale_down_work,
-		  cpufreq_interactive_freq_down);
-
-	spin_lock_init(&up_cpumask_lock);
-	spin_lock_init(&down_cpumask_lock);
+	spin_lock_init(&input_boost_lock);
 	mutex_init(&set_speed_lock);
 
 	pm_qos_add_request(&core_lock.qos_min_req, PM_QOS_MIN_ONLINE_CPUS,
 			PM_QOS_MIN_ONLINE_CPUS_DEFAULT_VALUE);
 
-	pm_qos_add_request(&core_lock.qos_max_req, PM_QOS_MAX_ONLINE_CPUS,
-			PM_QOS_MAX_ONLINE_CPUS_DEFAULT_VALUE);
-
 	init_timer(&core_lock.unlock_timer);
 	core_lock.unlock_timer.function = cpufreq_interactive_core_lock_timer;
 	core_lock.unlock_timer.data = 0;
 
 	core_lock.request_active = 0;
-	core_lock.lock_period = DEFAULT_CORE_LOCK_PERIOD;
 	mutex_init(&core_lock.mutex);
 
 	core_lock.lock_task = kthread_create(cpufreq_interactive_lock_cores_task, NULL,
@@ -1284,7 +1466,7 @@ static int __init cpufreq_interactive_init(void)
 	return cpufreq_register_governor(&cpufreq_gov_interactive);
 
 err_freeuptask:
-	put_task_struct(up_task);
+	put_task_struct(speedchange_task);
 	return -ENOMEM;
 }
 
@@ -1297,12 +1479,11 @@ module_init(cpufreq_interactive_init);
 static void __exit cpufreq_interactive_exit(void)
 {
 	cpufreq_unregister_governor(&cpufreq_gov_interactive);
-	kthread_stop(up_task);
-	put_task_struct(up_task);
+	kthread_stop(speedchange_task);
+	put_task_struct(speedchange_task);
 	destroy_workqueue(down_wq);
 
 	pm_qos_remove_request(&core_lock.qos_min_req);
-	pm_qos_remove_request(&core_lock.qos_max_req);
 	kthread_stop(core_lock.lock_task);
 	put_task_struct(core_lock.lock_task);
 }
@@ -0,0 +1,148 @@
+/*
+ * drivers/cpufreq/cpufreq_interactive_policy.h
+ *
+ * Frequency selection policy of the interactive governor
+ *
+ * Copyright (C) 2010 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * The decisions here are pure functions of their arguments: no locking,
+ * per-cpu data, timers or tracing. This header includes nothing, so that
+ * tools/power/tegra/policy-replay can build it on the host and replay
+ * recorded load traces through exactly the code the governor runs. The
+ * includer provides u64, bool and POLICY_DIV64(dividend, divisor), a
+ * u64 by u64 division: div64_u64() in the kernel, where 32-bit ARM has
+ * no libgcc helper for an open-coded one.
+ */
+
+#ifndef _CPUFREQ_INTERACTIVE_POLICY_H
+#define _CPUFREQ_INTERACTIVE_POLICY_H
+
+struct cpufreq_interactive_tunables {
+	unsigned long go_maxspeed_load;
+	unsigned long go_hispeed_load;
+	unsigned long boost_factor;
+	unsigned long max_boost;
+	unsigned long sustain_load;
+	unsigned long above_hispeed_delay;	/* us */
+	unsigned long min_sample_time;		/* us */
+	unsigned int hispeed_freq;
+	bool boost;
+};
+
+struct cpufreq_interactive_sample {
+	int load;			/* % since the timer was armed */
+	int load_since_change;		/* % since the last speed change */
+	unsigned int cur;		/* policy limits and current rate */
+	unsigned int min;
+	unsigned int max;
+	unsigned int target;		/* current target of this cpu */
+	u64 now;			/* us */
+	u64 freq_change_time;		/* us */
+	unsigned int floor;		/* input boost floor, 0 if none */
+};
+
+/* Linearly decaying input boost floor, @elapsed us after the last event */
+static inline unsigned int cpufreq_interactive_policy_input_floor(
+	unsigned int freq, u64 elapsed, unsigned long hold,
+	unsigned long decay)
+{
+	if (elapsed < hold)
+		return freq;
+
+	elapsed -= hold;
+	if (elapsed >= decay)
+		return 0;
+
+	return freq - (unsigned int)POLICY_DIV64((u64)freq * elapsed, decay);
+}
+
+/*
+ * Target rate for a sample, before rounding to the frequency table.
+ * Sets *notyet when a raise above hispeed_freq was held back by
+ * above_hispeed_delay.
+ */
+static inline unsigned int cpufreq_interactive_policy_target(
+	const struct cpufreq_interactive_tunables *t,
+	const struct cpufreq_interactive_sample *s, bool *notyet)
+{
+	unsigned int target_freq;
+	int cpu_load = s->load;
+
+	*notyet = false;
+
+	/*
+	 * Choose greater of short-term load (since last idle timer
+	 * started or timer function re-armed itself) or long-term load
+	 * (since last frequency change).
+	 */
+	if (s->load_since_change > cpu_load)
+		cpu_load = s->load_since_change;
+
+	/* Exponential boost policy */
+	if (t->boost_factor) {
+		if (cpu_load >= t->go_maxspeed_load) {
+			target_freq = s->cur * t->boost_factor;
+
+			if (t->max_boost &&
+			    target_freq > s->cur + t->max_boost)
+				target_freq = s->cur + t->max_boost;
+		} else {
+			target_freq = s->cur * cpu_load /
+				(t->sustain_load ? : 100);
+		}
+
+		goto done;
+	}
+
+	/* Jump boost policy */
+	if (cpu_load >= t->go_hispeed_load || t->boost) {
+		if (s->target <= s->min) {
+			target_freq = t->hispeed_freq;
+		} else {
+			target_freq = s->max * cpu_load / 100;
+
+			if (target_freq < t->hispeed_freq)
+				target_freq = t->hispeed_freq;
+
+			if (s->target == t->hispeed_freq &&
+			    target_freq > t->hispeed_freq &&
+			    s->now - s->freq_change_time <
+			    t->above_hispeed_delay) {
+				target_freq = s->target;
+				*notyet = true;
+			}
+		}
+	} else {
+		target_freq = s->max * cpu_load / 100;
+	}
+
+done:
+	if (target_freq < s->floor)
+		target_freq = s->floor;
+	if (target_freq > s->max)
+		target_freq = s->max;
+	return target_freq;
+}
+
+/*
+ * Do not scale below floor_freq unless we have been at or above the
+ * floor frequency for the minimum sample time since last validated.
+ */
+static inline bool cpufreq_interactive_policy_hold(
+	const struct cpufreq_interactive_tunables *t, unsigned int new_freq,
+	unsigned int floor_freq, u64 now, u64 floor_validate_time)
+{
+	return new_freq < floor_freq &&
+		now - floor_validate_time < t->min_sample_time;
+}
+
+#endif /* _CPUFREQ_INTERACTIVE_POLICY_H */
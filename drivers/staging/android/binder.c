@@ -19,15 +19,19 @@
 #include <linux/fdtable.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/nsproxy.h>
+#include <linux/percpu.h>
 #include <linux/poll.h>
 #include <linux/debugfs.h>
 #include <linux/rbtree.h>
+#include <linux/rwsem.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
@@ -37,8 +41,46 @@
 
 #include "binder.h"
 
-static DEFINE_MUTEX(binder_lock);
+#define CREATE_TRACE_POINTS
+#include <trace/events/binder.h>
+
+/*
+ * Locking:
+ *
+ * binder_lock protects the object graph: the proc list, nodes, refs and
+ * death notifications. Procs, threads, nodes and refs are only created
+ * and freed with it held for write, so holding it for read is enough to
+ * keep every object reachable from a proc alive. ioctls run with it
+ * held for read: transactions without objects, returning buffers and
+ * reading work run in parallel and only switch to write (see
+ * binder_lock_exclusive()) for objects, node work, ref counts going to
+ * or from zero and death notifications. It is never held across the
+ * buffer page (un)mapping in binder_free_buf() when a buffer is
+ * returned with BC_FREE_BUFFER.
+ *
+ * proc->inner_lock protects, under binder_lock held for read, the todo
+ * lists of the proc and of its threads, the transaction stacks of its
+ * threads, buffer->transaction of its buffers, the async state of its
+ * nodes, the strong and weak counts of its refs and the looper thread
+ * counts. node->lock protects the node reference counts the same way.
+ * Code holding binder_lock for write may skip both. Neither is held
+ * while taking another spinlock: a transaction takes the locks of the
+ * sending and the receiving proc one after the other.
+ *
+ * proc->buffer_lock protects the allocator of one proc: buffers,
+ * free_buffers, allocated_buffers, pages and free_async_space. It nests
+ * inside binder_lock and outside mmap_sem. buffer->allow_user_free is
+ * cleared under it, so that only one BC_FREE_BUFFER can claim a buffer.
+ *
+ * proc->thread_lock protects proc->threads, so that an ioctl can find
+ * or create its binder_thread without binder_lock.
+ *
+ * binder_mmap_lock serializes binder_mmap(), which is called with
+ * mmap_sem held and so cannot take proc->buffer_lock.
+ */
+static DECLARE_RWSEM(binder_lock);
 static DEFINE_MUTEX(binder_deferred_lock);
+static DEFINE_MUTEX(binder_mmap_lock);
 
 static HLIST_HEAD(binder_procs);
 static HLIST_HEAD(binder_deferred_list);
@@ -48,9 +90,25 @@ static struct dentry *binder_debugfs_dir_entry_root;
 static struct dentry *binder_debugfs_dir_entry_proc;
 static struct binder_node *binder_context_mgr_node;
 static uid_t binder_context_mgr_uid = -1;
-static int binder_last_id;
+static atomic_t binder_last_id;
 static struct workqueue_struct *binder_deferred_workqueue;
 
+/*
+ * Called with binder_lock held for read, returns with it held for write.
+ * Anything looked up before the call has to be looked up again, except
+ * for the objects of the calling thread and its proc.
+ */
+static void binder_lock_exclusive(void)
+{
+	up_read(&binder_lock);
+	down_write(&binder_lock);
+}
+
+static void binder_unlock_exclusive(void)
+{
+	downgrade_write(&binder_lock);
+}
+
 #define BINDER_DEBUG_ENTRY(name) \
 static int binder_##name##_open(struct inode *inode, struct file *file) \
 { \
@@ -106,6 +164,25 @@ module_param_named(debug_mask, binder_debug_mask, uint, S_IWUSR | S_IRUGO);
 static int binder_debug_no_lock;
 module_param_named(proc_no_lock, binder_debug_no_lock, bool, S_IWUSR | S_IRUGO);
 
+/* Pages at the start of each mapping that stay mapped once populated */
+static unsigned int binder_prefault_pages = 8;
+module_param_named(prefault_pages, binder_prefault_pages, uint,
+		   S_IWUSR | S_IRUGO);
+
+/* Run synchronous calls from SCHED_FIFO/RR callers at the caller's policy */
+static int binder_inherit_rt = 1;
+module_param_named(inherit_rt, binder_inherit_rt, bool, S_IWUSR | S_IRUGO);
+
+/* Freed buffers kept mapped per size class, 0 disables the cache */
+static unsigned int binder_buffer_cache_depth = 4;
+module_param_named(buffer_cache_depth, binder_buffer_cache_depth, uint,
+		   S_IWUSR | S_IRUGO);
+
+/* Collect the per (caller, node, code) latency histograms */
+static int binder_latency_stats = 1;
+module_param_named(latency_stats, binder_latency_stats, bool,
+		   S_IWUSR | S_IRUGO);
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -147,22 +224,22 @@ enum binder_stat_types {
 };
 
 struct binder_stats {
-	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
-	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
-	int obj_created[BINDER_STAT_COUNT];
-	int obj_deleted[BINDER_STAT_COUNT];
+	atomic_t br[_IOC_NR(BR_FAILED_REPLY) + 1];
+	atomic_t bc[_IOC_NR(BC_REPLY_SG) + 1];
+	atomic_t obj_created[BINDER_STAT_COUNT];
+	atomic_t obj_deleted[BINDER_STAT_COUNT];
 };
 
 static struct binder_stats binder_stats;
 
 static inline void binder_stats_deleted(enum binder_stat_types type)
 {
-	binder_stats.obj_deleted[type]++;
+	atomic_inc(&binder_stats.obj_deleted[type]);
 }
 
 static inline void binder_stats_created(enum binder_stat_types type)
 {
-	binder_stats.obj_created[type]++;
+	atomic_inc(&binder_stats.obj_created[type]);
 }
 
 struct binder_transaction_log_entry {
@@ -178,7 +255,7 @@ struct binder_transaction_log_entry {
 	int offsets_size;
 };
 struct binder_transaction_log {
-	int next;
+	atomic_t cur;
 	int full;
 	struct binder_transaction_log_entry entry[32];
 };
@@ -189,16 +266,151 @@ static struct binder_transaction_log_entry *binder_transaction_log_add(
 	struct binder_transaction_log *log)
 {
 	struct binder_transaction_log_entry *e;
-	e = &log->entry[log->next];
-	memset(e, 0, sizeof(*e));
-	log->next++;
-	if (log->next == ARRAY_SIZE(log->entry)) {
-		log->next = 0;
+	unsigned int cur = atomic_inc_return(&log->cur) - 1;
+
+	if (cur >= ARRAY_SIZE(log->entry))
 		log->full = 1;
-	}
+	e = &log->entry[cur % ARRAY_SIZE(log->entry)];
+	memset(e, 0, sizeof(*e));
 	return e;
 }
 
+/*
+ * Transaction latency. Completed transactions are pushed into a per-cpu
+ * ring by the thread that finished them, with preemption disabled and no
+ * lock: the local cpu is the only writer. binder_latency_drain() folds
+ * the rings into binder_latency_table under binder_latency_lock, from a
+ * deferrable work once a second and whenever the debugfs file is read.
+ * A reader that falls a whole ring behind drops the oldest samples.
+ */
+#define BINDER_LATENCY_RING_SIZE	256
+#define BINDER_LATENCY_ENTRIES		128
+#define BINDER_LATENCY_BUCKETS		16
+
+struct binder_latency_sample {
+	int from_pid;
+	int node_debug_id;
+	unsigned int code;
+	u32 wait_us;		/* submit until a target thread picked it up */
+	u32 total_us;		/* submit until reply, or wait_us if oneway */
+};
+
+struct binder_latency_ring {
+	unsigned int head;	/* written by the local cpu only */
+	unsigned int tail;	/* written by the drain only */
+	unsigned int dropped;
+	struct binder_latency_sample sample[BINDER_LATENCY_RING_SIZE];
+};
+static DEFINE_PER_CPU(struct binder_latency_ring, binder_latency_ring);
+
+struct binder_latency_entry {
+	int from_pid;
+	int node_debug_id;
+	unsigned int code;
+	unsigned int count;
+	u64 wait_sum;
+	u64 total_sum;
+	u32 wait_max;
+	u32 total_max;
+	/* total_us in [2^(i-1), 2^i), the last bucket is open */
+	unsigned int hist[BINDER_LATENCY_BUCKETS];
+};
+static struct binder_latency_entry binder_latency_table[BINDER_LATENCY_ENTRIES];
+static unsigned int binder_latency_overflow;
+static unsigned int binder_latency_dropped;
+static DEFINE_MUTEX(binder_latency_lock);
+
+static u32 binder_latency_us(ktime_t start, ktime_t end)
+{
+	s64 us = ktime_us_delta(end, start);
+
+	if (us < 0)
+		return 0;
+	return min_t(s64, us, UINT_MAX);
+}
+
+static void binder_latency_account(const struct binder_latency_sample *s)
+{
+	struct binder_latency_entry *e;
+	unsigned int i, n, bucket;
+
+	i = hash_32(s->from_pid ^ (s->node_debug_id << 8) ^ (s->code << 20),
+		    ilog2(BINDER_LATENCY_ENTRIES));
+	for (n = 0; n < BINDER_LATENCY_ENTRIES; n++) {
+		e = &binder_latency_table[i];
+		if (!e->count) {
+			e->from_pid = s->from_pid;
+			e->node_debug_id = s->node_debug_id;
+			e->code = s->code;
+			break;
+		}
+		if (e->from_pid == s->from_pid &&
+		    e->node_debug_id == s->node_debug_id &&
+		    e->code == s->code)
+			break;
+		i = (i + 1) % BINDER_LATENCY_ENTRIES;
+	}
+	if (n == BINDER_LATENCY_ENTRIES) {
+		binder_latency_overflow++;
+		return;
+	}
+
+	e->count++;
+	e->wait_sum += s->wait_us;
+	e->total_sum += s->total_us;
+	if (s->wait_us > e->wait_max)
+		e->wait_max = s->wait_us;
+	if (s->total_us > e->total_max)
+		e->total_max = s->total_us;
+	bucket = min_t(unsigned int, fls(s->total_us),
+		       BINDER_LATENCY_BUCKETS - 1);
+	e->hist[bucket]++;
+}
+
+/* Called with binder_latency_lock held */
+static void binder_latency_drain(void)
+{
+	struct binder_latency_ring *ring;
+	struct binder_latency_sample s;
+	unsigned int head;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ring = &per_cpu(binder_latency_ring, cpu);
+		head = ACCESS_ONCE(ring->head);
+		smp_rmb();
+		if (head - ring->tail > BINDER_LATENCY_RING_SIZE) {
+			ring->dropped += head - ring->tail -
+					 BINDER_LATENCY_RING_SIZE;
+			ring->tail = head - BINDER_LATENCY_RING_SIZE;
+		}
+		while (ring->tail != head) {
+			s = ring->sample[ring->tail % BINDER_LATENCY_RING_SIZE];
+			smp_rmb();
+			/* the writer may have come round to this slot */
+			if (ACCESS_ONCE(ring->head) - ring->tail >=
+			    BINDER_LATENCY_RING_SIZE)
+				ring->dropped++;
+			else
+				binder_latency_account(&s);
+			ring->tail++;
+		}
+		binder_latency_dropped += ring->dropped;
+		ring->dropped = 0;
+	}
+}
+
+static void binder_latency_drain_func(struct work_struct *work);
+static DECLARE_DEFERRED_WORK(binder_latency_work, binder_latency_drain_func);
+
+static void binder_latency_drain_func(struct work_struct *work)
+{
+	mutex_lock(&binder_latency_lock);
+	binder_latency_drain();
+	mutex_unlock(&binder_latency_lock);
+	schedule_delayed_work(&binder_latency_work, HZ);
+}
+
 struct binder_work {
 	struct list_head entry;
 	enum {
@@ -213,6 +425,7 @@ struct binder_work {
 
 struct binder_node {
 	int debug_id;
+	spinlock_t lock;
 	struct binder_work work;
 	union {
 		struct rb_node rb_node;
@@ -264,16 +477,39 @@ struct binder_buffer {
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
-	unsigned debug_id:29;
+	unsigned cached:1;
+	unsigned debug_id:28;
 
 	struct binder_transaction *transaction;
+	struct list_head cache_entry;
 
 	struct binder_node *target_node;
 	size_t data_size;
 	size_t offsets_size;
+	size_t extra_buffers_size;
 	uint8_t data[0];
 };
 
+/*
+ * Small transactions are rounded up to a size class, so that a freed one
+ * can go back to a per-proc cache with its pages still mapped and serve
+ * the next transaction of that class without touching the free tree.
+ */
+static const size_t binder_buffer_class_size[] = {
+	128, 256, 512, 1024, 2048
+};
+#define BINDER_BUFFER_CLASSES	ARRAY_SIZE(binder_buffer_class_size)
+
+static int binder_buffer_class(size_t size)
+{
+	int i;
+
+	for (i = 0; i < BINDER_BUFFER_CLASSES; i++)
+		if (size <= binder_buffer_class_size[i])
+			return i;
+	return -1;
+}
+
 enum binder_deferred_state {
 	BINDER_DEFERRED_PUT_FILES    = 0x01,
 	BINDER_DEFERRED_FLUSH        = 0x02,
@@ -282,6 +518,8 @@ enum binder_deferred_state {
 
 struct binder_proc {
 	struct hlist_node proc_node;
+	spinlock_t inner_lock;
+	spinlock_t thread_lock;
 	struct rb_root threads;
 	struct rb_root nodes;
 	struct rb_root refs_by_desc;
@@ -295,14 +533,23 @@ struct binder_proc {
 	void *buffer;
 	ptrdiff_t user_buffer_offset;
 
+	struct mutex buffer_lock;
 	struct list_head buffers;
 	struct rb_root free_buffers;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
+	struct list_head buffer_cache[BINDER_BUFFER_CLASSES];
+	int buffer_cache_count[BINDER_BUFFER_CLASSES];
 
 	struct page **pages;
 	size_t buffer_size;
 	uint32_t buffer_free;
+	void *prefault_end;
+	unsigned int pages_mapped;
+	unsigned int page_map_count;
+	unsigned int page_unmap_count;
+	unsigned int buffer_cache_hits;
+	unsigned int buffer_cache_misses;
 	struct list_head todo;
 	wait_queue_head_t wait;
 	struct binder_stats stats;
@@ -355,9 +602,49 @@ struct binder_transaction {
 	unsigned int	flags;
 	long	priority;
 	long	saved_priority;
+	int	policy;
+	int	rt_priority;
+	int	saved_policy;
+	int	saved_rt_priority;
 	uid_t	sender_euid;
+	/* latency stats, kept here as from and buffer may be gone by then */
+	int	from_pid;
+	int	node_debug_id;
+	ktime_t	submit_time;
+	ktime_t	wake_time;
 };
 
+static void binder_latency_add(struct binder_transaction *t, ktime_t now)
+{
+	struct binder_latency_ring *ring;
+	struct binder_latency_sample *s;
+
+	if (!binder_latency_stats)
+		return;
+
+	ring = &get_cpu_var(binder_latency_ring);
+	s = &ring->sample[ring->head % BINDER_LATENCY_RING_SIZE];
+	s->from_pid = t->from_pid;
+	s->node_debug_id = t->node_debug_id;
+	s->code = t->code;
+	s->wait_us = binder_latency_us(t->submit_time, t->wake_time);
+	s->total_us = binder_latency_us(t->submit_time, now);
+	smp_wmb();
+	ring->head++;
+	put_cpu_var(binder_latency_ring);
+}
+
+/* t is done: replied to, or picked up by a thread if it is oneway */
+static void binder_latency_done(struct binder_transaction *t, ktime_t now)
+{
+	trace_binder_transaction_done(t->debug_id, t->from_pid,
+				      t->node_debug_id, t->code,
+				      binder_latency_us(t->submit_time,
+							t->wake_time),
+				      binder_latency_us(t->submit_time, now));
+	binder_latency_add(t, now);
+}
+
 static void
 binder_defer_work(struct binder_proc *proc, enum binder_deferred_state defer);
 
@@ -516,6 +803,46 @@ static void binder_set_nice(long nice)
 	binder_user_error("binder: %d RLIMIT_NICE not set\n", current->pid);
 }
 
+static int binder_is_rt_policy(int policy)
+{
+	policy &= ~SCHED_RESET_ON_FORK;
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+/* current's policy, with SCHED_RESET_ON_FORK if set, for a later restore */
+static int binder_current_policy(void)
+{
+	return current->policy |
+		(current->sched_reset_on_fork ? SCHED_RESET_ON_FORK : 0);
+}
+
+/*
+ * Move current to a real-time policy and priority, or to a normal policy
+ * at the given nice. Real-time policies are set without the capability
+ * check: binder only ever hands out the policy of a caller, or gives a
+ * thread back its own.
+ */
+static void binder_set_priority(int policy, int rt_priority, long nice)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	if (binder_is_rt_policy(policy)) {
+		if (binder_current_policy() == policy &&
+		    current->rt_priority == rt_priority)
+			return;
+		param.sched_priority = rt_priority;
+		if (sched_setscheduler_nocheck(current, policy, &param))
+			binder_debug(BINDER_DEBUG_PRIORITY_CAP,
+				     "binder: %d: policy %d prio %d refused\n",
+				     current->pid, policy, rt_priority);
+		return;
+	}
+
+	if (binder_is_rt_policy(current->policy))
+		sched_setscheduler_nocheck(current, policy, &param);
+	binder_set_nice(nice);
+}
+
 static size_t binder_buffer_size(struct binder_proc *proc,
 				 struct binder_buffer *buffer)
 {
@@ -584,16 +911,18 @@ static void binder_insert_allocated_buffer(struct binder_proc *proc,
 	rb_insert_color(&new_buffer->rb_node, &proc->allocated_buffers);
 }
 
+/* Called with proc->buffer_lock held */
 static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 						  void __user *user_ptr)
 {
-	struct rb_node *n = proc->allocated_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	struct binder_buffer *kern_ptr;
 
 	kern_ptr = user_ptr - proc->user_buffer_offset
 		- offsetof(struct binder_buffer, data);
 
+	n = proc->allocated_buffers.rb_node;
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(buffer->free);
@@ -603,9 +932,9 @@ static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 		else if (kern_ptr > buffer)
 			n = n->rb_right;
 		else
-			return buffer;
+			break;
 	}
-	return NULL;
+	return n ? buffer : NULL;
 }
 
 static int binder_update_page_range(struct binder_proc *proc, int allocate,
@@ -649,7 +978,11 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		struct page **page_array_ptr;
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
 
-		BUG_ON(*page);
+		if (*page) {
+			/* kept mapped below prefault_end */
+			BUG_ON(page_addr >= proc->prefault_end);
+			continue;
+		}
 		*page = alloc_page(GFP_KERNEL | __GFP_ZERO);
 		if (*page == NULL) {
 			printk(KERN_ERR "binder: %d: binder_alloc_buf failed "
@@ -676,6 +1009,8 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 			goto err_vm_insert_page_failed;
 		}
 		/* vm_insert_page does not seem to increment the refcount */
+		proc->pages_mapped++;
+		proc->page_map_count++;
 	}
 	if (mm) {
 		up_write(&mm->mmap_sem);
@@ -687,9 +1022,13 @@ free_range:
 	for (page_addr = end - PAGE_SIZE; page_addr >= start;
 	     page_addr -= PAGE_SIZE) {
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
+		if (page_addr < proc->prefault_end || !*page)
+			continue;
 		if (vma)
 			zap_page_range(vma, (uintptr_t)page_addr +
 				proc->user_buffer_offset, PAGE_SIZE, NULL);
+		proc->pages_mapped--;
+		proc->page_unmap_count++;
 err_vm_insert_page_failed:
 		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
 err_map_kernel_failed:
@@ -706,17 +1045,90 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
+static void __binder_free_buf(struct binder_proc *proc,
+			      struct binder_buffer *buffer);
+
+static struct binder_buffer *binder_buffer_cache_get(struct binder_proc *proc,
+						     int class)
 {
-	struct rb_node *n = proc->free_buffers.rb_node;
+	struct binder_buffer *buffer;
+
+	if (class < 0)
+		return NULL;
+	if (list_empty(&proc->buffer_cache[class])) {
+		proc->buffer_cache_misses++;
+		return NULL;
+	}
+	buffer = list_first_entry(&proc->buffer_cache[class],
+				  struct binder_buffer, cache_entry);
+	list_del(&buffer->cache_entry);
+	proc->buffer_cache_count[class]--;
+	proc->buffer_cache_hits++;
+	buffer->cached = 0;
+	return buffer;
+}
+
+/*
+ * Keep a freed buffer, and the pages under it, for the next transaction
+ * of its class. It stays on allocated_buffers, where BC_FREE_BUFFER
+ * cannot match it since allow_user_free is clear.
+ */
+static int binder_buffer_cache_put(struct binder_proc *proc,
+				   struct binder_buffer *buffer)
+{
+	size_t size = ALIGN(buffer->data_size, sizeof(void *)) +
+		ALIGN(buffer->offsets_size, sizeof(void *)) +
+		buffer->extra_buffers_size;
+	int class = binder_buffer_class(size);
+
+	if (class < 0 ||
+	    proc->buffer_cache_count[class] >= binder_buffer_cache_depth)
+		return 0;
+
+	if (buffer->async_transaction) {
+		proc->free_async_space += size + sizeof(struct binder_buffer);
+		buffer->async_transaction = 0;
+	}
+	buffer->cached = 1;
+	buffer->target_node = NULL;
+	list_add(&buffer->cache_entry, &proc->buffer_cache[class]);
+	proc->buffer_cache_count[class]++;
+	return 1;
+}
+
+static int binder_buffer_cache_flush(struct binder_proc *proc)
+{
+	struct binder_buffer *buffer, *tmp;
+	int class, count = 0;
+
+	for (class = 0; class < BINDER_BUFFER_CLASSES; class++) {
+		list_for_each_entry_safe(buffer, tmp,
+					 &proc->buffer_cache[class],
+					 cache_entry) {
+			list_del(&buffer->cache_entry);
+			buffer->cached = 0;
+			__binder_free_buf(proc, buffer);
+			count++;
+		}
+		proc->buffer_cache_count[class] = 0;
+	}
+	return count;
+}
+
+static struct binder_buffer *__binder_alloc_buf(struct binder_proc *proc,
+						size_t data_size,
+						size_t offsets_size,
+						size_t extra_buffers_size,
+						int is_async)
+{
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
-	struct rb_node *best_fit = NULL;
+	struct rb_node *best_fit;
 	void *has_page_addr;
 	void *end_page_addr;
-	size_t size;
+	size_t size, alloc_size;
+	int class;
 
 	if (proc->vma == NULL) {
 		printk(KERN_ERR "binder: %d: binder_alloc_buf, no vma\n",
@@ -733,6 +1145,15 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		return NULL;
 	}
 
+	if (size + extra_buffers_size < size ||
+	    extra_buffers_size != ALIGN(extra_buffers_size, sizeof(void *))) {
+		binder_user_error("binder: %d: got transaction with invalid "
+			"extra buffers size %zd\n", proc->pid,
+			extra_buffers_size);
+		return NULL;
+	}
+	size += extra_buffers_size;
+
 	if (is_async &&
 	    proc->free_async_space < size + sizeof(struct binder_buffer)) {
 		binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
@@ -741,15 +1162,28 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		return NULL;
 	}
 
+	class = binder_buffer_class(size);
+	buffer = binder_buffer_cache_get(proc, class);
+	if (buffer) {
+		binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+			     "binder: %d: binder_alloc_buf size %zd got "
+			     "cached %p\n", proc->pid, size, buffer);
+		goto out;
+	}
+	alloc_size = class < 0 ? size : binder_buffer_class_size[class];
+
+retry:
+	n = proc->free_buffers.rb_node;
+	best_fit = NULL;
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(!buffer->free);
 		buffer_size = binder_buffer_size(proc, buffer);
 
-		if (size < buffer_size) {
+		if (alloc_size < buffer_size) {
 			best_fit = n;
 			n = n->rb_left;
-		} else if (size > buffer_size)
+		} else if (alloc_size > buffer_size)
 			n = n->rb_right;
 		else {
 			best_fit = n;
@@ -757,6 +1191,9 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		}
 	}
 	if (best_fit == NULL) {
+		/* cached buffers may be what splits the free space */
+		if (binder_buffer_cache_flush(proc))
+			goto retry;
 		printk(KERN_ERR "binder: %d: binder_alloc_buf size %zd failed, "
 		       "no address space\n", proc->pid, size);
 		return NULL;
@@ -773,10 +1210,10 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	has_page_addr =
 		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK);
 	if (n == NULL) {
-		if (size + sizeof(struct binder_buffer) + 4 >= buffer_size)
-			buffer_size = size; /* no room for other buffers */
+		if (alloc_size + sizeof(struct binder_buffer) + 4 >= buffer_size)
+			buffer_size = alloc_size; /* no room for other buffers */
 		else
-			buffer_size = size + sizeof(struct binder_buffer);
+			buffer_size = alloc_size + sizeof(struct binder_buffer);
 	}
 	end_page_addr =
 		(void *)PAGE_ALIGN((uintptr_t)buffer->data + buffer_size);
@@ -789,8 +1226,9 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	rb_erase(best_fit, &proc->free_buffers);
 	buffer->free = 0;
 	binder_insert_allocated_buffer(proc, buffer);
-	if (buffer_size != size) {
-		struct binder_buffer *new_buffer = (void *)buffer->data + size;
+	if (buffer_size != alloc_size) {
+		struct binder_buffer *new_buffer =
+			(void *)buffer->data + alloc_size;
 		list_add(&new_buffer->entry, &buffer->entry);
 		new_buffer->free = 1;
 		binder_insert_free_buffer(proc, new_buffer);
@@ -798,8 +1236,10 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: binder_alloc_buf size %zd got "
 		     "%p\n", proc->pid, size, buffer);
+out:
 	buffer->data_size = data_size;
 	buffer->offsets_size = offsets_size;
+	buffer->extra_buffers_size = extra_buffers_size;
 	buffer->async_transaction = is_async;
 	if (is_async) {
 		proc->free_async_space -= size + sizeof(struct binder_buffer);
@@ -812,6 +1252,21 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size,
+					      size_t extra_buffers_size,
+					      int is_async)
+{
+	struct binder_buffer *buffer;
+
+	mutex_lock(&proc->buffer_lock);
+	buffer = __binder_alloc_buf(proc, data_size, offsets_size,
+				    extra_buffers_size, is_async);
+	mutex_unlock(&proc->buffer_lock);
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -869,15 +1324,16 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 	}
 }
 
-static void binder_free_buf(struct binder_proc *proc,
-			    struct binder_buffer *buffer)
+static void __binder_free_buf(struct binder_proc *proc,
+			      struct binder_buffer *buffer)
 {
 	size_t size, buffer_size;
 
 	buffer_size = binder_buffer_size(proc, buffer);
 
 	size = ALIGN(buffer->data_size, sizeof(void *)) +
-		ALIGN(buffer->offsets_size, sizeof(void *));
+		ALIGN(buffer->offsets_size, sizeof(void *)) +
+		buffer->extra_buffers_size;
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: binder_free_buf %p size %zd buffer"
@@ -924,6 +1380,15 @@ static void binder_free_buf(struct binder_proc *proc,
 	binder_insert_free_buffer(proc, buffer);
 }
 
+static void binder_free_buf(struct binder_proc *proc,
+			    struct binder_buffer *buffer)
+{
+	mutex_lock(&proc->buffer_lock);
+	if (!binder_buffer_cache_put(proc, buffer))
+		__binder_free_buf(proc, buffer);
+	mutex_unlock(&proc->buffer_lock);
+}
+
 static struct binder_node *binder_get_node(struct binder_proc *proc,
 					   void __user *ptr)
 {
@@ -969,7 +1434,8 @@ static struct binder_node *binder_new_node(struct binder_proc *proc,
 	binder_stats_created(BINDER_STAT_NODE);
 	rb_link_node(&node->rb_node, parent, p);
 	rb_insert_color(&node->rb_node, &proc->nodes);
-	node->debug_id = ++binder_last_id;
+	node->debug_id = atomic_inc_return(&binder_last_id);
+	spin_lock_init(&node->lock);
 	node->proc = proc;
 	node->ptr = ptr;
 	node->cookie = cookie;
@@ -1104,7 +1570,7 @@ static struct binder_ref *binder_get_ref_for_node(struct binder_proc *proc,
 	if (new_ref == NULL)
 		return NULL;
 	binder_stats_created(BINDER_STAT_REF);
-	new_ref->debug_id = ++binder_last_id;
+	new_ref->debug_id = atomic_inc_return(&binder_last_id);
 	new_ref->proc = proc;
 	new_ref->node = node;
 	rb_link_node(&new_ref->rb_node_node, parent, p);
@@ -1233,15 +1699,22 @@ static void binder_pop_transaction(struct binder_thread *target_thread,
 				   struct binder_transaction *t)
 {
 	if (target_thread) {
+		spin_lock(&target_thread->proc->inner_lock);
 		BUG_ON(target_thread->transaction_stack != t);
 		BUG_ON(target_thread->transaction_stack->from != target_thread);
 		target_thread->transaction_stack =
 			target_thread->transaction_stack->from_parent;
 		t->from = NULL;
+		spin_unlock(&target_thread->proc->inner_lock);
 	}
 	t->need_reply = 0;
-	if (t->buffer)
-		t->buffer->transaction = NULL;
+	/* t->buffer, if any, belongs to t->to_proc */
+	if (t->to_proc) {
+		spin_lock(&t->to_proc->inner_lock);
+		if (t->buffer)
+			t->buffer->transaction = NULL;
+		spin_unlock(&t->to_proc->inner_lock);
+	}
 	kfree(t);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION);
 }
@@ -1368,6 +1841,10 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 				task_close_fd(proc, fp->handle);
 			break;
 
+		case BINDER_TYPE_PTR:
+			/* the gathered copy lives in the buffer itself */
+			break;
+
 		default:
 			printk(KERN_ERR "binder: transaction release %d bad "
 			       "object type %lx\n", debug_id, fp->type);
@@ -1376,13 +1853,47 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+/*
+ * Release a buffer with binder_lock held for read. The target node ref
+ * of a buffer without objects can be dropped here unless it is the last
+ * strong ref of the node; anything else may queue node work or free
+ * nodes and refs, and is done with binder_lock held for write.
+ */
+static void binder_transaction_buffer_release_shared(struct binder_proc *proc,
+					struct binder_buffer *buffer)
+{
+	struct binder_node *node = buffer->target_node;
+	int done = 0;
+
+	if (buffer->offsets_size == 0) {
+		if (node) {
+			spin_lock(&node->lock);
+			if (node->local_strong_refs > 1 ||
+			    (node->local_strong_refs &&
+			     node->internal_strong_refs)) {
+				node->local_strong_refs--;
+				done = 1;
+			}
+			spin_unlock(&node->lock);
+		} else
+			done = 1;
+	}
+	if (done)
+		return;
+	binder_lock_exclusive();
+	binder_transaction_buffer_release(proc, buffer, NULL);
+	binder_unlock_exclusive();
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
-			       struct binder_transaction_data *tr, int reply)
+			       struct binder_transaction_data *tr, int reply,
+			       size_t extra_buffers_size)
 {
 	struct binder_transaction *t;
 	struct binder_work *tcomplete;
 	size_t *offp, *off_end;
+	uint8_t *sg_bufp, *sg_buf_end;
 	struct binder_proc *target_proc;
 	struct binder_thread *target_thread = NULL;
 	struct binder_node *target_node = NULL;
@@ -1391,6 +1902,19 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_transaction *in_reply_to = NULL;
 	struct binder_transaction_log_entry *e;
 	uint32_t return_error;
+	long saved_priority;
+	int saved_policy, saved_rt_priority;
+	int exclusive = 0;
+
+	/*
+	 * Objects create and look up nodes and refs, which needs binder_lock
+	 * held for write. Plain data only touches the todo lists, the stacks
+	 * and the target node count, under the inner and node locks.
+	 */
+	if (tr->offsets_size) {
+		binder_lock_exclusive();
+		exclusive = 1;
+	}
 
 	e = binder_transaction_log_add(&binder_transaction_log);
 	e->call_type = reply ? 2 : !!(tr->flags & TF_ONE_WAY);
@@ -1401,16 +1925,23 @@ static void binder_transaction(struct binder_proc *proc,
 	e->offsets_size = tr->offsets_size;
 
 	if (reply) {
+		spin_lock(&proc->inner_lock);
 		in_reply_to = thread->transaction_stack;
 		if (in_reply_to == NULL) {
+			spin_unlock(&proc->inner_lock);
 			binder_user_error("binder: %d:%d got reply transaction "
 					  "with no transaction stack\n",
 					  proc->pid, thread->pid);
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		saved_policy = in_reply_to->saved_policy;
+		saved_rt_priority = in_reply_to->saved_rt_priority;
+		saved_priority = in_reply_to->saved_priority;
 		if (in_reply_to->to_thread != thread) {
+			spin_unlock(&proc->inner_lock);
+			binder_set_priority(saved_policy, saved_rt_priority,
+					    saved_priority);
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad transaction stack,"
 				" transaction %d has target %d:%d\n",
@@ -1424,12 +1955,17 @@ static void binder_transaction(struct binder_proc *proc,
 			goto err_bad_call_stack;
 		}
 		thread->transaction_stack = in_reply_to->to_parent;
+		spin_unlock(&proc->inner_lock);
+		binder_set_priority(saved_policy, saved_rt_priority,
+				    saved_priority);
 		target_thread = in_reply_to->from;
 		if (target_thread == NULL) {
 			return_error = BR_DEAD_REPLY;
 			goto err_dead_binder;
 		}
+		spin_lock(&target_thread->proc->inner_lock);
 		if (target_thread->transaction_stack != in_reply_to) {
+			spin_unlock(&target_thread->proc->inner_lock);
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad target transaction stack %d, "
 				"expected %d\n",
@@ -1442,6 +1978,7 @@ static void binder_transaction(struct binder_proc *proc,
 			target_thread = NULL;
 			goto err_dead_binder;
 		}
+		spin_unlock(&target_thread->proc->inner_lock);
 		target_proc = target_thread->proc;
 	} else {
 		if (tr->target.handle) {
@@ -1472,10 +2009,12 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_invalid_target_handle;
 		}
+		spin_lock(&proc->inner_lock);
 		if (!(tr->flags & TF_ONE_WAY) && thread->transaction_stack) {
 			struct binder_transaction *tmp;
 			tmp = thread->transaction_stack;
 			if (tmp->to_thread != thread) {
+				spin_unlock(&proc->inner_lock);
 				binder_user_error("binder: %d:%d got new "
 					"transaction with bad transaction stack"
 					", transaction %d has target %d:%d\n",
@@ -1492,6 +2031,7 @@ static void binder_transaction(struct binder_proc *proc,
 				tmp = tmp->from_parent;
 			}
 		}
+		spin_unlock(&proc->inner_lock);
 	}
 	if (target_thread) {
 		e->to_thread = target_thread->pid;
@@ -1518,8 +2058,15 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 	binder_stats_created(BINDER_STAT_TRANSACTION_COMPLETE);
 
-	t->debug_id = ++binder_last_id;
+	t->debug_id = atomic_inc_return(&binder_last_id);
 	e->debug_id = t->debug_id;
+	t->from_pid = proc->pid;
+	t->node_debug_id = target_node ? target_node->debug_id : 0;
+	t->submit_time = ktime_get();
+	trace_binder_transaction(t->debug_id, reply, proc->pid, thread->pid,
+				 target_proc->pid,
+				 target_thread ? target_thread->pid : 0,
+				 t->node_debug_id, tr->code, tr->flags);
 
 	if (reply)
 		binder_debug(BINDER_DEBUG_TRANSACTION,
@@ -1548,8 +2095,11 @@ static void binder_transaction(struct binder_proc *proc,
 	t->code = tr->code;
 	t->flags = tr->flags;
 	t->priority = task_nice(current);
+	t->policy = current->policy;
+	t->rt_priority = current->rt_priority;
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
-		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
+		tr->offsets_size, extra_buffers_size,
+		!reply && (t->flags & TF_ONE_WAY));
 	if (t->buffer == NULL) {
 		return_error = BR_FAILED_REPLY;
 		goto err_binder_alloc_buf_failed;
@@ -1558,8 +2108,11 @@ static void binder_transaction(struct binder_proc *proc,
 	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
 	t->buffer->target_node = target_node;
-	if (target_node)
+	if (target_node) {
+		spin_lock(&target_node->lock);
 		binder_inc_node(target_node, 1, 0, NULL);
+		spin_unlock(&target_node->lock);
+	}
 
 	offp = (size_t *)(t->buffer->data + ALIGN(tr->data_size, sizeof(void *)));
 
@@ -1583,6 +2136,8 @@ static void binder_transaction(struct binder_proc *proc,
 		goto err_bad_offset;
 	}
 	off_end = (void *)offp + tr->offsets_size;
+	sg_bufp = (uint8_t *)off_end;
+	sg_buf_end = sg_bufp + extra_buffers_size;
 	for (; offp < off_end; offp++) {
 		struct flat_binder_object *fp;
 		if (*offp > t->buffer->data_size - sizeof(*fp) ||
@@ -1725,6 +2280,35 @@ static void binder_transaction(struct binder_proc *proc,
 			fp->handle = target_fd;
 		} break;
 
+		case BINDER_TYPE_PTR: {
+			struct binder_buffer_object *bp = (void *)fp;
+			size_t len = ALIGN(bp->length, sizeof(void *));
+
+			/* the offsets checks above assume one object size */
+			BUILD_BUG_ON(sizeof(*bp) != sizeof(*fp));
+			if (bp->flags || len < bp->length ||
+			    len > sg_buf_end - sg_bufp) {
+				binder_user_error("binder: %d:%d got transaction "
+					"with too large buffer, %zd of %zd "
+					"left\n", proc->pid, thread->pid,
+					bp->length, sg_buf_end - sg_bufp);
+				return_error = BR_FAILED_REPLY;
+				goto err_bad_offset;
+			}
+			if (copy_from_user(sg_bufp, bp->buffer, bp->length)) {
+				binder_user_error("binder: %d:%d got transaction "
+					"with invalid buffer ptr\n",
+					proc->pid, thread->pid);
+				return_error = BR_FAILED_REPLY;
+				goto err_copy_data_failed;
+			}
+			binder_debug(BINDER_DEBUG_TRANSACTION,
+				     "        buffer %p size %zd -> %p\n",
+				     bp->buffer, bp->length, sg_bufp);
+			bp->buffer = sg_bufp + target_proc->user_buffer_offset;
+			sg_bufp += len;
+		} break;
+
 		default:
 			binder_user_error("binder: %d:%d got transactio"
 				"n with invalid object type, %lx\n",
@@ -1735,27 +2319,38 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 	if (reply) {
 		BUG_ON(t->buffer->async_transaction != 0);
+		binder_latency_done(in_reply_to, t->submit_time);
 		binder_pop_transaction(target_thread, in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
 		t->need_reply = 1;
+		spin_lock(&proc->inner_lock);
 		t->from_parent = thread->transaction_stack;
 		thread->transaction_stack = t;
+		spin_unlock(&proc->inner_lock);
 	} else {
 		BUG_ON(target_node == NULL);
 		BUG_ON(t->buffer->async_transaction != 1);
+	}
+	t->work.type = BINDER_WORK_TRANSACTION;
+	spin_lock(&target_proc->inner_lock);
+	if (!reply && (t->flags & TF_ONE_WAY)) {
 		if (target_node->has_async_transaction) {
 			target_list = &target_node->async_todo;
 			target_wait = NULL;
 		} else
 			target_node->has_async_transaction = 1;
 	}
-	t->work.type = BINDER_WORK_TRANSACTION;
 	list_add_tail(&t->work.entry, target_list);
+	spin_unlock(&target_proc->inner_lock);
 	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
+	spin_lock(&proc->inner_lock);
 	list_add_tail(&tcomplete->entry, &thread->todo);
+	spin_unlock(&proc->inner_lock);
 	if (target_wait)
 		wake_up_interruptible(target_wait);
+	if (exclusive)
+		binder_unlock_exclusive();
 	return;
 
 err_get_unused_fd_failed:
@@ -1767,7 +2362,10 @@ err_binder_new_node_failed:
 err_bad_object_type:
 err_bad_offset:
 err_copy_data_failed:
-	binder_transaction_buffer_release(target_proc, t->buffer, offp);
+	if (exclusive)
+		binder_transaction_buffer_release(target_proc, t->buffer, offp);
+	else
+		binder_transaction_buffer_release_shared(target_proc, t->buffer);
 	t->buffer->transaction = NULL;
 	binder_free_buf(target_proc, t->buffer);
 err_binder_alloc_buf_failed:
@@ -1796,9 +2394,53 @@ err_no_context_mgr_node:
 	BUG_ON(thread->return_error != BR_OK);
 	if (in_reply_to) {
 		thread->return_error = BR_TRANSACTION_COMPLETE;
+		if (!exclusive) {
+			binder_lock_exclusive();
+			exclusive = 1;
+		}
 		binder_send_failed_reply(in_reply_to, return_error);
 	} else
 		thread->return_error = return_error;
+	if (exclusive)
+		binder_unlock_exclusive();
+}
+
+/*
+ * Ref count changes that do not take a count to or from zero only touch
+ * the ref itself, so they are done with binder_lock held for read.
+ * Returns 0 if the change has to be made with it held for write.
+ */
+static int binder_update_ref_shared(struct binder_proc *proc,
+				    struct binder_thread *thread,
+				    uint32_t target, uint32_t cmd)
+{
+	struct binder_ref *ref;
+	int strong = cmd == BC_ACQUIRE || cmd == BC_RELEASE;
+	int inc = cmd == BC_INCREFS || cmd == BC_ACQUIRE;
+	int *count;
+	int done = 0;
+
+	ref = binder_get_ref(proc, target);
+	if (ref == NULL)
+		return 0;
+	if (target == 0 && inc && ref->node != binder_context_mgr_node)
+		return 0;
+	count = strong ? &ref->strong : &ref->weak;
+	spin_lock(&proc->inner_lock);
+	if (inc ? *count > 0 : *count > 1) {
+		*count += inc ? 1 : -1;
+		done = 1;
+	}
+	spin_unlock(&proc->inner_lock);
+	if (done)
+		binder_debug(BINDER_DEBUG_USER_REFS,
+			     "binder: %d:%d %s ref %d desc %d s %d w %d for node %d\n",
+			     proc->pid, thread->pid,
+			     inc ? (strong ? "Acquire" : "IncRefs") :
+			     (strong ? "Release" : "DecRefs"),
+			     ref->debug_id, ref->desc, ref->strong, ref->weak,
+			     ref->node->debug_id);
+	return done;
 }
 
 int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
@@ -1807,15 +2449,16 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 	uint32_t cmd;
 	void __user *ptr = buffer + *consumed;
 	void __user *end = buffer + size;
+	int exclusive = 0;
 
 	while (ptr < end && thread->return_error == BR_OK) {
 		if (get_user(cmd, (uint32_t __user *)ptr))
 			return -EFAULT;
 		ptr += sizeof(uint32_t);
 		if (_IOC_NR(cmd) < ARRAY_SIZE(binder_stats.bc)) {
-			binder_stats.bc[_IOC_NR(cmd)]++;
-			proc->stats.bc[_IOC_NR(cmd)]++;
-			thread->stats.bc[_IOC_NR(cmd)]++;
+			atomic_inc(&binder_stats.bc[_IOC_NR(cmd)]);
+			atomic_inc(&proc->stats.bc[_IOC_NR(cmd)]);
+			atomic_inc(&thread->stats.bc[_IOC_NR(cmd)]);
 		}
 		switch (cmd) {
 		case BC_INCREFS:
@@ -1829,6 +2472,10 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (get_user(target, (uint32_t __user *)ptr))
 				return -EFAULT;
 			ptr += sizeof(uint32_t);
+			if (binder_update_ref_shared(proc, thread, target, cmd))
+				break;
+			binder_lock_exclusive();
+			exclusive = 1;
 			if (target == 0 && binder_context_mgr_node &&
 			    (cmd == BC_INCREFS || cmd == BC_ACQUIRE)) {
 				ref = binder_get_ref_for_node(proc,
@@ -1886,6 +2533,8 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (get_user(cookie, (void * __user *)ptr))
 				return -EFAULT;
 			ptr += sizeof(void *);
+			binder_lock_exclusive();
+			exclusive = 1;
 			node = binder_get_node(proc, node_ptr);
 			if (node == NULL) {
 				binder_user_error("binder: %d:%d "
@@ -1946,30 +2595,37 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 		case BC_FREE_BUFFER: {
 			void __user *data_ptr;
 			struct binder_buffer *buffer;
+			int claimed;
 
 			if (get_user(data_ptr, (void * __user *)ptr))
 				return -EFAULT;
 			ptr += sizeof(void *);
 
+			mutex_lock(&proc->buffer_lock);
 			buffer = binder_buffer_lookup(proc, data_ptr);
+			claimed = buffer && buffer->allow_user_free;
+			if (claimed)
+				buffer->allow_user_free = 0;
+			mutex_unlock(&proc->buffer_lock);
 			if (buffer == NULL) {
 				binder_user_error("binder: %d:%d "
 					"BC_FREE_BUFFER u%p no match\n",
 					proc->pid, thread->pid, data_ptr);
 				break;
 			}
-			if (!buffer->allow_user_free) {
+			if (!claimed) {
 				binder_user_error("binder: %d:%d "
 					"BC_FREE_BUFFER u%p matched "
 					"unreturned buffer\n",
 					proc->pid, thread->pid, data_ptr);
 				break;
 			}
+
+			spin_lock(&proc->inner_lock);
 			binder_debug(BINDER_DEBUG_FREE_BUFFER,
 				     "binder: %d:%d BC_FREE_BUFFER u%p found buffer %d for %s transaction\n",
 				     proc->pid, thread->pid, data_ptr, buffer->debug_id,
 				     buffer->transaction ? "active" : "finished");
-
 			if (buffer->transaction) {
 				buffer->transaction->buffer = NULL;
 				buffer->transaction = NULL;
@@ -1981,8 +2637,17 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				else
 					list_move_tail(buffer->target_node->async_todo.next, &thread->todo);
 			}
-			binder_transaction_buffer_release(proc, buffer, NULL);
+			spin_unlock(&proc->inner_lock);
+			binder_transaction_buffer_release_shared(proc, buffer);
+
+			/*
+			 * The buffer is unreachable now that allow_user_free
+			 * is clear and the transaction is detached; give the
+			 * pages back without stalling everyone else's IPC.
+			 */
+			up_read(&binder_lock);
 			binder_free_buf(proc, buffer);
+			down_read(&binder_lock);
 			break;
 		}
 
@@ -1993,7 +2658,19 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (copy_from_user(&tr, ptr, sizeof(tr)))
 				return -EFAULT;
 			ptr += sizeof(tr);
-			binder_transaction(proc, thread, &tr, cmd == BC_REPLY);
+			binder_transaction(proc, thread, &tr, cmd == BC_REPLY, 0);
+			break;
+		}
+
+		case BC_TRANSACTION_SG:
+		case BC_REPLY_SG: {
+			struct binder_transaction_data_sg tr;
+
+			if (copy_from_user(&tr, ptr, sizeof(tr)))
+				return -EFAULT;
+			ptr += sizeof(tr);
+			binder_transaction(proc, thread, &tr.transaction_data,
+					   cmd == BC_REPLY_SG, tr.buffers_size);
 			break;
 		}
 
@@ -2001,6 +2678,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			binder_debug(BINDER_DEBUG_THREADS,
 				     "binder: %d:%d BC_REGISTER_LOOPER\n",
 				     proc->pid, thread->pid);
+			spin_lock(&proc->inner_lock);
 			if (thread->looper & BINDER_LOOPER_STATE_ENTERED) {
 				thread->looper |= BINDER_LOOPER_STATE_INVALID;
 				binder_user_error("binder: %d:%d ERROR:"
@@ -2017,6 +2695,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				proc->requested_threads--;
 				proc->requested_threads_started++;
 			}
+			spin_unlock(&proc->inner_lock);
 			thread->looper |= BINDER_LOOPER_STATE_REGISTERED;
 			break;
 		case BC_ENTER_LOOPER:
@@ -2052,6 +2731,8 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (get_user(cookie, (void __user * __user *)ptr))
 				return -EFAULT;
 			ptr += sizeof(void *);
+			binder_lock_exclusive();
+			exclusive = 1;
 			ref = binder_get_ref(proc, target);
 			if (ref == NULL) {
 				binder_user_error("binder: %d:%d %s "
@@ -2147,6 +2828,8 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				return -EFAULT;
 
 			ptr += sizeof(void *);
+			binder_lock_exclusive();
+			exclusive = 1;
 			list_for_each_entry(w, &proc->delivered_death, entry) {
 				struct binder_ref_death *tmp_death = container_of(w, struct binder_ref_death, work);
 				if (tmp_death->cookie == cookie) {
@@ -2181,6 +2864,10 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			       proc->pid, thread->pid, cmd);
 			return -EINVAL;
 		}
+		if (exclusive) {
+			binder_unlock_exclusive();
+			exclusive = 0;
+		}
 		*consumed = ptr - buffer;
 	}
 	return 0;
@@ -2190,9 +2877,9 @@ void binder_stat_br(struct binder_proc *proc, struct binder_thread *thread,
 		    uint32_t cmd)
 {
 	if (_IOC_NR(cmd) < ARRAY_SIZE(binder_stats.br)) {
-		binder_stats.br[_IOC_NR(cmd)]++;
-		proc->stats.br[_IOC_NR(cmd)]++;
-		thread->stats.br[_IOC_NR(cmd)]++;
+		atomic_inc(&binder_stats.br[_IOC_NR(cmd)]);
+		atomic_inc(&proc->stats.br[_IOC_NR(cmd)]);
+		atomic_inc(&thread->stats.br[_IOC_NR(cmd)]);
 	}
 }
 
@@ -2209,10 +2896,15 @@ static int binder_has_thread_work(struct binder_thread *thread)
 		(thread->looper & BINDER_LOOPER_STATE_NEED_RETURN);
 }
 
-static int binder_thread_read(struct binder_proc *proc,
-			      struct binder_thread *thread,
-			      void  __user *buffer, int size,
-			      signed long *consumed, int non_block)
+/*
+ * Called with binder_lock held for read. Node and death work is handed
+ * out with it held for write; *exclusive tells the caller to drop back.
+ */
+static int __binder_thread_read(struct binder_proc *proc,
+				struct binder_thread *thread,
+				void  __user *buffer, int size,
+				signed long *consumed, int non_block,
+				int *exclusive)
 {
 	void __user *ptr = buffer + *consumed;
 	void __user *end = buffer + size;
@@ -2227,8 +2919,10 @@ static int binder_thread_read(struct binder_proc *proc,
 	}
 
 retry:
+	spin_lock(&proc->inner_lock);
 	wait_for_proc_work = thread->transaction_stack == NULL &&
 				list_empty(&thread->todo);
+	spin_unlock(&proc->inner_lock);
 
 	if (thread->return_error != BR_OK && ptr < end) {
 		if (thread->return_error2 != BR_OK) {
@@ -2248,9 +2942,16 @@ retry:
 
 
 	thread->looper |= BINDER_LOOPER_STATE_WAITING;
-	if (wait_for_proc_work)
+	if (wait_for_proc_work) {
+		spin_lock(&proc->inner_lock);
 		proc->ready_threads++;
-	mutex_unlock(&binder_lock);
+		spin_unlock(&proc->inner_lock);
+	}
+	if (*exclusive) {
+		up_write(&binder_lock);
+		*exclusive = 0;
+	} else
+		up_read(&binder_lock);
 	if (wait_for_proc_work) {
 		if (!(thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
 					BINDER_LOOPER_STATE_ENTERED))) {
@@ -2274,9 +2975,12 @@ retry:
 		} else
 			ret = wait_event_interruptible(thread->wait, binder_has_thread_work(thread));
 	}
-	mutex_lock(&binder_lock);
-	if (wait_for_proc_work)
+	down_read(&binder_lock);
+	if (wait_for_proc_work) {
+		spin_lock(&proc->inner_lock);
 		proc->ready_threads--;
+		spin_unlock(&proc->inner_lock);
+	}
 	thread->looper &= ~BINDER_LOOPER_STATE_WAITING;
 
 	if (ret)
@@ -2287,19 +2991,42 @@ retry:
 		struct binder_transaction_data tr;
 		struct binder_work *w;
 		struct binder_transaction *t = NULL;
+		struct list_head *list;
 
+		spin_lock(&proc->inner_lock);
 		if (!list_empty(&thread->todo))
-			w = list_first_entry(&thread->todo, struct binder_work, entry);
+			list = &thread->todo;
 		else if (!list_empty(&proc->todo) && wait_for_proc_work)
-			w = list_first_entry(&proc->todo, struct binder_work, entry);
+			list = &proc->todo;
 		else {
+			spin_unlock(&proc->inner_lock);
 			if (ptr - buffer == 4 && !(thread->looper & BINDER_LOOPER_STATE_NEED_RETURN)) /* no data added */
 				goto retry;
 			break;
 		}
 
-		if (end - ptr < sizeof(tr) + 4)
+		if (end - ptr < sizeof(tr) + 4) {
+			spin_unlock(&proc->inner_lock);
 			break;
+		}
+
+		/*
+		 * Transactions are taken off the list before they are copied
+		 * out, as other threads may be reading proc->todo too, and put
+		 * back if that faults. Node and death work is only handled
+		 * with binder_lock held for write, and still in place.
+		 */
+		w = list_first_entry(list, struct binder_work, entry);
+		if (w->type == BINDER_WORK_TRANSACTION ||
+		    w->type == BINDER_WORK_TRANSACTION_COMPLETE)
+			list_del(&w->entry);
+		else if (!*exclusive) {
+			spin_unlock(&proc->inner_lock);
+			binder_lock_exclusive();
+			*exclusive = 1;
+			continue;
+		}
+		spin_unlock(&proc->inner_lock);
 
 		switch (w->type) {
 		case BINDER_WORK_TRANSACTION: {
@@ -2307,8 +3034,12 @@ retry:
 		} break;
 		case BINDER_WORK_TRANSACTION_COMPLETE: {
 			cmd = BR_TRANSACTION_COMPLETE;
-			if (put_user(cmd, (uint32_t __user *)ptr))
+			if (put_user(cmd, (uint32_t __user *)ptr)) {
+				spin_lock(&proc->inner_lock);
+				list_add(&w->entry, list);
+				spin_unlock(&proc->inner_lock);
 				return -EFAULT;
+			}
 			ptr += sizeof(uint32_t);
 
 			binder_stat_br(proc, thread, cmd);
@@ -2316,7 +3047,6 @@ retry:
 				     "binder: %d:%d BR_TRANSACTION_COMPLETE\n",
 				     proc->pid, thread->pid);
 
-			list_del(&w->entry);
 			kfree(w);
 			binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
 		} break;
@@ -2424,13 +3154,6 @@ retry:
 			struct binder_node *target_node = t->buffer->target_node;
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
-			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = NULL;
@@ -2457,12 +3180,14 @@ retry:
 					ALIGN(t->buffer->data_size,
 					    sizeof(void *));
 
-		if (put_user(cmd, (uint32_t __user *)ptr))
+		if (put_user(cmd, (uint32_t __user *)ptr) ||
+		    copy_to_user(ptr + sizeof(uint32_t), &tr, sizeof(tr))) {
+			spin_lock(&proc->inner_lock);
+			list_add(&t->work.entry, list);
+			spin_unlock(&proc->inner_lock);
 			return -EFAULT;
-		ptr += sizeof(uint32_t);
-		if (copy_to_user(ptr, &tr, sizeof(tr)))
-			return -EFAULT;
-		ptr += sizeof(tr);
+		}
+		ptr += sizeof(uint32_t) + sizeof(tr);
 
 		binder_stat_br(proc, thread, cmd);
 		binder_debug(BINDER_DEBUG_TRANSACTION,
@@ -2476,14 +3201,51 @@ retry:
 			     t->buffer->data_size, t->buffer->offsets_size,
 			     tr.data.ptr.buffer, tr.data.ptr.offsets);
 
-		list_del(&t->work.entry);
+		if (cmd == BR_TRANSACTION) {
+			/*
+			 * Take on the caller's priority only once the
+			 * transaction is copied out: a fault above puts it
+			 * back on the list, and must not leave current boosted.
+			 */
+			struct binder_node *target_node = t->buffer->target_node;
+
+			t->saved_priority = task_nice(current);
+			t->saved_policy = binder_current_policy();
+			t->saved_rt_priority = current->rt_priority;
+			if (binder_inherit_rt && binder_is_rt_policy(t->policy) &&
+			    !(t->flags & TF_ONE_WAY)) {
+				/* never lower a thread that is already higher */
+				if (!rt_task(current) ||
+				    current->rt_priority < t->rt_priority)
+					binder_set_priority(t->policy |
+							    SCHED_RESET_ON_FORK,
+							    t->rt_priority, 0);
+			} else if (t->priority < target_node->min_priority &&
+				   !(t->flags & TF_ONE_WAY))
+				binder_set_nice(t->priority);
+			else if (!(t->flags & TF_ONE_WAY) ||
+				 t->saved_priority > target_node->min_priority)
+				binder_set_nice(target_node->min_priority);
+
+			t->wake_time = ktime_get();
+			trace_binder_transaction_received(t->debug_id,
+				proc->pid, thread->pid,
+				binder_latency_us(t->submit_time,
+						  t->wake_time));
+			if (t->flags & TF_ONE_WAY)
+				binder_latency_done(t, t->wake_time);
+		}
+		spin_lock(&proc->inner_lock);
 		t->buffer->allow_user_free = 1;
 		if (cmd == BR_TRANSACTION && !(t->flags & TF_ONE_WAY)) {
 			t->to_parent = thread->transaction_stack;
 			t->to_thread = thread;
 			thread->transaction_stack = t;
-		} else {
+			t = NULL;
+		} else
 			t->buffer->transaction = NULL;
+		spin_unlock(&proc->inner_lock);
+		if (t) {
 			kfree(t);
 			binder_stats_deleted(BINDER_STAT_TRANSACTION);
 		}
@@ -2493,21 +3255,39 @@ retry:
 done:
 
 	*consumed = ptr - buffer;
+	spin_lock(&proc->inner_lock);
 	if (proc->requested_threads + proc->ready_threads == 0 &&
 	    proc->requested_threads_started < proc->max_threads &&
 	    (thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
 	     BINDER_LOOPER_STATE_ENTERED)) /* the user-space code fails to */
 	     /*spawn a new thread if we leave this out */) {
 		proc->requested_threads++;
+		spin_unlock(&proc->inner_lock);
 		binder_debug(BINDER_DEBUG_THREADS,
 			     "binder: %d:%d BR_SPAWN_LOOPER\n",
 			     proc->pid, thread->pid);
 		if (put_user(BR_SPAWN_LOOPER, (uint32_t __user *)buffer))
 			return -EFAULT;
-	}
+	} else
+		spin_unlock(&proc->inner_lock);
 	return 0;
 }
 
+static int binder_thread_read(struct binder_proc *proc,
+			      struct binder_thread *thread,
+			      void  __user *buffer, int size,
+			      signed long *consumed, int non_block)
+{
+	int exclusive = 0;
+	int ret;
+
+	ret = __binder_thread_read(proc, thread, buffer, size, consumed,
+				   non_block, &exclusive);
+	if (exclusive)
+		binder_unlock_exclusive();
+	return ret;
+}
+
 static void binder_release_work(struct list_head *list)
 {
 	struct binder_work *w;
@@ -2533,9 +3313,11 @@ static void binder_release_work(struct list_head *list)
 
 }
 
-static struct binder_thread *binder_get_thread(struct binder_proc *proc)
+static struct binder_thread *binder_lookup_thread(struct binder_proc *proc,
+						  struct rb_node ***pp,
+						  struct rb_node **pparent)
 {
-	struct binder_thread *thread = NULL;
+	struct binder_thread *thread;
 	struct rb_node *parent = NULL;
 	struct rb_node **p = &proc->threads.rb_node;
 
@@ -2548,24 +3330,50 @@ static struct binder_thread *binder_get_thread(struct binder_proc *proc)
 		else if (current->pid > thread->pid)
 			p = &(*p)->rb_right;
 		else
-			break;
+			return thread;
 	}
-	if (*p == NULL) {
-		thread = kzalloc(sizeof(*thread), GFP_KERNEL);
-		if (thread == NULL)
-			return NULL;
-		binder_stats_created(BINDER_STAT_THREAD);
-		thread->proc = proc;
-		thread->pid = current->pid;
-		init_waitqueue_head(&thread->wait);
-		INIT_LIST_HEAD(&thread->todo);
-		rb_link_node(&thread->rb_node, parent, p);
-		rb_insert_color(&thread->rb_node, &proc->threads);
-		thread->looper |= BINDER_LOOPER_STATE_NEED_RETURN;
-		thread->return_error = BR_OK;
-		thread->return_error2 = BR_OK;
-	}
-	return thread;
+	*pp = p;
+	*pparent = parent;
+	return NULL;
+}
+
+/*
+ * Called without binder_lock. Only current inserts its own pid, so the
+ * second lookup after the allocation cannot find a thread; it is only
+ * redone because other threads may have rebalanced the tree meanwhile.
+ */
+static struct binder_thread *binder_get_thread(struct binder_proc *proc)
+{
+	struct binder_thread *thread;
+	struct binder_thread *new_thread;
+	struct rb_node *parent;
+	struct rb_node **p;
+
+	spin_lock(&proc->thread_lock);
+	thread = binder_lookup_thread(proc, &p, &parent);
+	spin_unlock(&proc->thread_lock);
+	if (thread)
+		return thread;
+
+	new_thread = kzalloc(sizeof(*new_thread), GFP_KERNEL);
+	if (new_thread == NULL)
+		return NULL;
+	binder_stats_created(BINDER_STAT_THREAD);
+	new_thread->proc = proc;
+	new_thread->pid = current->pid;
+	init_waitqueue_head(&new_thread->wait);
+	INIT_LIST_HEAD(&new_thread->todo);
+	new_thread->looper |= BINDER_LOOPER_STATE_NEED_RETURN;
+	new_thread->return_error = BR_OK;
+	new_thread->return_error2 = BR_OK;
+
+	spin_lock(&proc->thread_lock);
+	thread = binder_lookup_thread(proc, &p, &parent);
+	BUG_ON(thread);
+	rb_link_node(&new_thread->rb_node, parent, p);
+	rb_insert_color(&new_thread->rb_node, &proc->threads);
+	spin_unlock(&proc->thread_lock);
+	return new_thread;
 }
 
 static int binder_free_thread(struct binder_proc *proc,
@@ -2575,7 +3383,9 @@ static int binder_free_thread(struct binder_proc *proc,
 	struct binder_transaction *send_reply = NULL;
 	int active_transactions = 0;
 
+	spin_lock(&proc->thread_lock);
 	rb_erase(&thread->rb_node, &proc->threads);
+	spin_unlock(&proc->thread_lock);
 	t = thread->transaction_stack;
 	if (t && t->to_thread == thread)
 		send_reply = t;
@@ -2616,12 +3426,16 @@ static unsigned int binder_poll(struct file *filp,
 	struct binder_thread *thread = NULL;
 	int wait_for_proc_work;
 
-	mutex_lock(&binder_lock);
 	thread = binder_get_thread(proc);
+	if (thread == NULL)
+		return POLLERR;
 
+	down_read(&binder_lock);
+	spin_lock(&proc->inner_lock);
 	wait_for_proc_work = thread->transaction_stack == NULL &&
 		list_empty(&thread->todo) && thread->return_error == BR_OK;
-	mutex_unlock(&binder_lock);
+	spin_unlock(&proc->inner_lock);
+	up_read(&binder_lock);
 
 	if (wait_for_proc_work) {
 		if (binder_has_proc_work(proc, thread))
@@ -2646,6 +3460,8 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	struct binder_thread *thread;
 	unsigned int size = _IOC_SIZE(cmd);
 	void __user *ubuf = (void __user *)arg;
+	int exclusive;
+	int max_threads;
 
 	/*printk(KERN_INFO "binder_ioctl: %d:%d %x %lx\n", proc->pid, current->pid, cmd, arg);*/
 
@@ -2653,13 +3469,19 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	if (ret)
 		return ret;
 
-	mutex_lock(&binder_lock);
 	thread = binder_get_thread(proc);
 	if (thread == NULL) {
 		ret = -ENOMEM;
-		goto err;
+		goto err_no_thread;
 	}
 
+	/* setting the context manager and freeing a thread change the graph */
+	exclusive = cmd == BINDER_SET_CONTEXT_MGR || cmd == BINDER_THREAD_EXIT;
+	if (exclusive)
+		down_write(&binder_lock);
+	else
+		down_read(&binder_lock);
+
 	switch (cmd) {
 	case BINDER_WRITE_READ: {
 		struct binder_write_read bwr;
@@ -2706,10 +3528,13 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		break;
 	}
 	case BINDER_SET_MAX_THREADS:
-		if (copy_from_user(&proc->max_threads, ubuf, sizeof(proc->max_threads))) {
+		if (copy_from_user(&max_threads, ubuf, sizeof(max_threads))) {
 			ret = -EINVAL;
 			goto err;
 		}
+		spin_lock(&proc->inner_lock);
+		proc->max_threads = max_threads;
+		spin_unlock(&proc->inner_lock);
 		break;
 	case BINDER_SET_CONTEXT_MGR:
 		if (binder_context_mgr_node != NULL) {
@@ -2765,7 +3590,11 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 err:
 	if (thread)
 		thread->looper &= ~BINDER_LOOPER_STATE_NEED_RETURN;
-	mutex_unlock(&binder_lock);
+	if (exclusive)
+		up_write(&binder_lock);
+	else
+		up_read(&binder_lock);
+err_no_thread:
 	wait_event_interruptible(binder_user_error_wait, binder_stop_on_user_error < 2);
 	if (ret && ret != -ERESTARTSYS)
 		printk(KERN_INFO "binder: %d:%d ioctl %x %lx returned %d\n", proc->pid, current->pid, cmd, arg, ret);
@@ -2807,6 +3636,7 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	struct binder_proc *proc = filp->private_data;
 	const char *failure_string;
 	struct binder_buffer *buffer;
+	size_t prefault;
 
 	if ((vma->vm_end - vma->vm_start) > SZ_4M)
 		vma->vm_end = vma->vm_start + SZ_4M;
@@ -2824,6 +3654,7 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	}
 	vma->vm_flags = (vma->vm_flags | VM_DONTCOPY) & ~VM_MAYWRITE;
 
+	mutex_lock(&binder_mmap_lock);
 	if (proc->buffer) {
 		ret = -EBUSY;
 		failure_string = "already mapped";
@@ -2838,6 +3669,7 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	}
 	proc->buffer = area->addr;
 	proc->user_buffer_offset = vma->vm_start - (uintptr_t)proc->buffer;
+	mutex_unlock(&binder_mmap_lock);
 
 #ifdef CONFIG_CPU_CACHE_VIPT
 	if (cache_is_vipt_aliasing()) {
@@ -2858,11 +3690,16 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	vma->vm_ops = &binder_vm_ops;
 	vma->vm_private_data = proc;
 
-	if (binder_update_page_range(proc, 1, proc->buffer, proc->buffer + PAGE_SIZE, vma)) {
+	prefault = clamp_t(size_t, binder_prefault_pages, 1,
+			   proc->buffer_size / PAGE_SIZE);
+	if (binder_update_page_range(proc, 1, proc->buffer,
+				     proc->buffer + prefault * PAGE_SIZE, vma)) {
 		ret = -ENOMEM;
 		failure_string = "alloc small buf";
 		goto err_alloc_small_buf_failed;
 	}
+	/* only now, so that a failed prefault above is unwound in full */
+	proc->prefault_end = proc->buffer + prefault * PAGE_SIZE;
 	buffer = proc->buffer;
 	INIT_LIST_HEAD(&proc->buffers);
 	list_add(&buffer->entry, &proc->buffers);
@@ -2881,10 +3718,12 @@ err_alloc_small_buf_failed:
 	kfree(proc->pages);
 	proc->pages = NULL;
 err_alloc_pages_failed:
+	mutex_lock(&binder_mmap_lock);
 	vfree(proc->buffer);
 	proc->buffer = NULL;
 err_get_vm_area_failed:
 err_already_mapped:
+	mutex_unlock(&binder_mmap_lock);
 err_bad_arg:
 	printk(KERN_ERR "binder_mmap: %d %lx-%lx %s failed %d\n",
 	       proc->pid, vma->vm_start, vma->vm_end, failure_string, ret);
@@ -2894,6 +3733,7 @@ err_bad_arg:
 static int binder_open(struct inode *nodp, struct file *filp)
 {
 	struct binder_proc *proc;
+	int i;
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE, "binder_open: %d:%d\n",
 		     current->group_leader->pid, current->pid);
@@ -2903,16 +3743,21 @@ static int binder_open(struct inode *nodp, struct file *filp)
 		return -ENOMEM;
 	get_task_struct(current);
 	proc->tsk = current;
+	spin_lock_init(&proc->inner_lock);
+	spin_lock_init(&proc->thread_lock);
+	mutex_init(&proc->buffer_lock);
+	for (i = 0; i < BINDER_BUFFER_CLASSES; i++)
+		INIT_LIST_HEAD(&proc->buffer_cache[i]);
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
 	proc->default_priority = task_nice(current);
-	mutex_lock(&binder_lock);
+	down_write(&binder_lock);
 	binder_stats_created(BINDER_STAT_PROC);
 	hlist_add_head(&proc->proc_node, &binder_procs);
 	proc->pid = current->group_leader->pid;
 	INIT_LIST_HEAD(&proc->delivered_death);
 	filp->private_data = proc;
-	mutex_unlock(&binder_lock);
+	up_write(&binder_lock);
 
 	if (binder_debugfs_dir_entry_proc) {
 		char strbuf[11];
@@ -2937,6 +3782,8 @@ static void binder_deferred_flush(struct binder_proc *proc)
 {
 	struct rb_node *n;
 	int wake_count = 0;
+
+	spin_lock(&proc->thread_lock);
 	for (n = rb_first(&proc->threads); n != NULL; n = rb_next(n)) {
 		struct binder_thread *thread = rb_entry(n, struct binder_thread, rb_node);
 		thread->looper |= BINDER_LOOPER_STATE_NEED_RETURN;
@@ -2945,6 +3792,7 @@ static void binder_deferred_flush(struct binder_proc *proc)
 			wake_count++;
 		}
 	}
+	spin_unlock(&proc->thread_lock);
 	wake_up_interruptible_all(&proc->wait);
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
@@ -3034,6 +3882,8 @@ static void binder_deferred_release(struct binder_proc *proc)
 	binder_release_work(&proc->todo);
 	buffers = 0;
 
+	mutex_lock(&proc->buffer_lock);
+	binder_buffer_cache_flush(proc);
 	while ((n = rb_first(&proc->allocated_buffers))) {
 		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
 							rb_node);
@@ -3046,9 +3896,10 @@ static void binder_deferred_release(struct binder_proc *proc)
 			       proc->pid, t->debug_id);
 			/*BUG();*/
 		}
-		binder_free_buf(proc, buffer);
+		__binder_free_buf(proc, buffer);
 		buffers++;
 	}
+	mutex_unlock(&proc->buffer_lock);
 
 	binder_stats_deleted(BINDER_STAT_PROC);
 
@@ -3092,7 +3943,7 @@ static void binder_deferred_func(struct work_struct *work)
 
 	int defer;
 	do {
-		mutex_lock(&binder_lock);
+		down_write(&binder_lock);
 		mutex_lock(&binder_deferred_lock);
 		if (!hlist_empty(&binder_deferred_list)) {
 			proc = hlist_entry(binder_deferred_list.first,
@@ -3119,7 +3970,7 @@ static void binder_deferred_func(struct work_struct *work)
 		if (defer & BINDER_DEFERRED_RELEASE)
 			binder_deferred_release(proc); /* frees proc */
 
-		mutex_unlock(&binder_lock);
+		up_write(&binder_lock);
 		if (files)
 			put_files_struct(files);
 	} while (proc);
@@ -3165,9 +4016,11 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 static void print_binder_buffer(struct seq_file *m, const char *prefix,
 				struct binder_buffer *buffer)
 {
-	seq_printf(m, "%s %d: %p size %zd:%zd %s\n",
+	seq_printf(m, "%s %d: %p size %zd:%zd:%zd %s\n",
 		   prefix, buffer->debug_id, buffer->data,
 		   buffer->data_size, buffer->offsets_size,
+		   buffer->extra_buffers_size,
+		   buffer->cached ? "cached" :
 		   buffer->transaction ? "active" : "delivered");
 }
 
@@ -3284,9 +4137,11 @@ static void print_binder_proc(struct seq_file *m,
 	seq_printf(m, "proc %d\n", proc->pid);
 	header_pos = m->count;
 
+	spin_lock(&proc->thread_lock);
 	for (n = rb_first(&proc->threads); n != NULL; n = rb_next(n))
 		print_binder_thread(m, rb_entry(n, struct binder_thread,
 						rb_node), print_all);
+	spin_unlock(&proc->thread_lock);
 	for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n)) {
 		struct binder_node *node = rb_entry(n, struct binder_node,
 						    rb_node);
@@ -3300,9 +4155,11 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
+	mutex_lock(&proc->buffer_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		print_binder_buffer(m, "  buffer",
 				    rb_entry(n, struct binder_buffer, rb_node));
+	mutex_unlock(&proc->buffer_lock);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -3351,7 +4208,9 @@ static const char *binder_command_strings[] = {
 	"BC_EXIT_LOOPER",
 	"BC_REQUEST_DEATH_NOTIFICATION",
 	"BC_CLEAR_DEATH_NOTIFICATION",
-	"BC_DEAD_BINDER_DONE"
+	"BC_DEAD_BINDER_DONE",
+	"BC_TRANSACTION_SG",
+	"BC_REPLY_SG"
 };
 
 static const char *binder_objstat_strings[] = {
@@ -3372,17 +4231,21 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 	BUILD_BUG_ON(ARRAY_SIZE(stats->bc) !=
 		     ARRAY_SIZE(binder_command_strings));
 	for (i = 0; i < ARRAY_SIZE(stats->bc); i++) {
-		if (stats->bc[i])
+		int count = atomic_read(&stats->bc[i]);
+
+		if (count)
 			seq_printf(m, "%s%s: %d\n", prefix,
-				   binder_command_strings[i], stats->bc[i]);
+				   binder_command_strings[i], count);
 	}
 
 	BUILD_BUG_ON(ARRAY_SIZE(stats->br) !=
 		     ARRAY_SIZE(binder_return_strings));
 	for (i = 0; i < ARRAY_SIZE(stats->br); i++) {
-		if (stats->br[i])
+		int count = atomic_read(&stats->br[i]);
+
+		if (count)
 			seq_printf(m, "%s%s: %d\n", prefix,
-				   binder_return_strings[i], stats->br[i]);
+				   binder_return_strings[i], count);
 	}
 
 	BUILD_BUG_ON(ARRAY_SIZE(stats->obj_created) !=
@@ -3390,11 +4253,13 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 	BUILD_BUG_ON(ARRAY_SIZE(stats->obj_created) !=
 		     ARRAY_SIZE(stats->obj_deleted));
 	for (i = 0; i < ARRAY_SIZE(stats->obj_created); i++) {
-		if (stats->obj_created[i] || stats->obj_deleted[i])
+		int created = atomic_read(&stats->obj_created[i]);
+		int deleted = atomic_read(&stats->obj_deleted[i]);
+
+		if (created || deleted)
 			seq_printf(m, "%s%s: active %d total %d\n", prefix,
 				binder_objstat_strings[i],
-				stats->obj_created[i] - stats->obj_deleted[i],
-				stats->obj_created[i]);
+				created - deleted, created);
 	}
 }
 
@@ -3407,8 +4272,10 @@ static void print_binder_proc_stats(struct seq_file *m,
 
 	seq_printf(m, "proc %d\n", proc->pid);
 	count = 0;
+	spin_lock(&proc->thread_lock);
 	for (n = rb_first(&proc->threads); n != NULL; n = rb_next(n))
 		count++;
+	spin_unlock(&proc->thread_lock);
 	seq_printf(m, "  threads: %d\n", count);
 	seq_printf(m, "  requested threads: %d+%d/%d\n"
 			"  ready threads %d\n"
@@ -3432,9 +4299,16 @@ static void print_binder_proc_stats(struct seq_file *m,
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
 	count = 0;
+	mutex_lock(&proc->buffer_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		count++;
 	seq_printf(m, "  buffers: %d\n", count);
+	seq_printf(m, "  pages: %u mapped, %u maps, %u unmaps\n",
+		   proc->pages_mapped, proc->page_map_count,
+		   proc->page_unmap_count);
+	seq_printf(m, "  buffer cache: %u hits, %u misses\n",
+		   proc->buffer_cache_hits, proc->buffer_cache_misses);
+	mutex_unlock(&proc->buffer_lock);
 
 	count = 0;
 	list_for_each_entry(w, &proc->todo, entry) {
@@ -3460,7 +4334,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		down_write(&binder_lock);
 
 	seq_puts(m, "binder state:\n");
 
@@ -3472,7 +4346,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		up_write(&binder_lock);
 	return 0;
 }
 
@@ -3483,7 +4357,7 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		down_write(&binder_lock);
 
 	seq_puts(m, "binder stats:\n");
 
@@ -3492,7 +4366,7 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc_stats(m, proc);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		up_write(&binder_lock);
 	return 0;
 }
 
@@ -3503,13 +4377,13 @@ static int binder_transactions_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		down_write(&binder_lock);
 
 	seq_puts(m, "binder transactions:\n");
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 0);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		up_write(&binder_lock);
 	return 0;
 }
 
@@ -3519,11 +4393,11 @@ static int binder_proc_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		down_write(&binder_lock);
 	seq_puts(m, "binder proc state:\n");
 	print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		up_write(&binder_lock);
 	return 0;
 }
 
@@ -3541,17 +4415,80 @@ static void print_binder_transaction_log_entry(struct seq_file *m,
 static int binder_transaction_log_show(struct seq_file *m, void *unused)
 {
 	struct binder_transaction_log *log = m->private;
+	int next = atomic_read(&log->cur) % ARRAY_SIZE(log->entry);
 	int i;
 
 	if (log->full) {
-		for (i = log->next; i < ARRAY_SIZE(log->entry); i++)
+		for (i = next; i < ARRAY_SIZE(log->entry); i++)
 			print_binder_transaction_log_entry(m, &log->entry[i]);
 	}
-	for (i = 0; i < log->next; i++)
+	for (i = 0; i < next; i++)
 		print_binder_transaction_log_entry(m, &log->entry[i]);
 	return 0;
 }
 
+static void print_binder_latency_entry(struct seq_file *m,
+				       struct binder_latency_entry *e)
+{
+	int i;
+
+	seq_printf(m, "%d -> node %d code %u: count %u "
+		   "wait avg %llu max %u total avg %llu max %u us\n",
+		   e->from_pid, e->node_debug_id, e->code, e->count,
+		   div_u64(e->wait_sum, e->count), e->wait_max,
+		   div_u64(e->total_sum, e->count), e->total_max);
+	seq_puts(m, "  total us:");
+	for (i = 0; i < BINDER_LATENCY_BUCKETS - 1; i++)
+		if (e->hist[i])
+			seq_printf(m, " <%u:%u", 1U << i, e->hist[i]);
+	if (e->hist[i])
+		seq_printf(m, " >=%u:%u", 1U << (i - 1), e->hist[i]);
+	seq_puts(m, "\n");
+}
+
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	int i;
+
+	mutex_lock(&binder_latency_lock);
+	binder_latency_drain();
+	seq_printf(m, "binder latency: dropped %u overflow %u\n",
+		   binder_latency_dropped, binder_latency_overflow);
+	for (i = 0; i < BINDER_LATENCY_ENTRIES; i++)
+		if (binder_latency_table[i].count)
+			print_binder_latency_entry(m, &binder_latency_table[i]);
+	mutex_unlock(&binder_latency_lock);
+	return 0;
+}
+
+static int binder_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, binder_latency_show, inode->i_private);
+}
+
+/* Any write clears the histograms */
+static ssize_t binder_latency_write(struct file *file,
+				    const char __user *buf, size_t count,
+				    loff_t *ppos)
+{
+	mutex_lock(&binder_latency_lock);
+	binder_latency_drain();
+	memset(binder_latency_table, 0, sizeof(binder_latency_table));
+	binder_latency_dropped = 0;
+	binder_latency_overflow = 0;
+	mutex_unlock(&binder_latency_lock);
+	return count;
+}
+
+static const struct file_operations binder_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = binder_latency_open,
+	.read = seq_read,
+	.write = binder_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static const struct file_operations binder_fops = {
 	.owner = THIS_MODULE,
 	.poll = binder_poll,
@@ -3612,7 +4549,13 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("latency",
+				    S_IRUGO | S_IWUSR,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 	}
+	schedule_delayed_work(&binder_latency_work, HZ);
 	return ret;
 }
 
@@ -32,6 +32,8 @@ enum {
 	BINDER_TYPE_HANDLE	= B_PACK_CHARS('s', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_WEAK_HANDLE	= B_PACK_CHARS('w', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_FD		= B_PACK_CHARS('f', 'd', '*', B_TYPE_LARGE),
+	/* not upstream's 'pt' object, whose layout differs */
+	BINDER_TYPE_PTR		= B_PACK_CHARS('g', 'p', '*', B_TYPE_LARGE),
 };
 
 enum {
@@ -61,6 +63,21 @@ struct flat_binder_object {
 	void			*cookie;
 };
 
+/*
+ * A BINDER_TYPE_PTR object in a BC_TRANSACTION_SG or BC_REPLY_SG names a
+ * user buffer that is gathered into the target's transaction buffer,
+ * after the data and offsets, in the same pass that copies the parcel.
+ * The driver rewrites buffer to the address of the copy in the target's
+ * mapping. It has the size of a flat_binder_object, so it can sit in the
+ * same offsets array.
+ */
+struct binder_buffer_object {
+	unsigned long		type;
+	unsigned long		flags;		/* must be 0 */
+	void			*buffer;
+	size_t			length;
+};
+
 /*
  * On 64-bit platforms where user code may run in 32-bits the driver must
  * translate the buffer (and local binder) addresses apropriately.
@@ -147,6 +164,11 @@ struct binder_transaction_data {
 	} data;
 };
 
+struct binder_transaction_data_sg {
+	struct binder_transaction_data transaction_data;
+	size_t buffers_size;	/* sum of the aligned BINDER_TYPE_PTR lengths */
+};
+
 struct binder_ptr_cookie {
 	void *ptr;
 	void *cookie;
@@ -324,6 +346,19 @@ enum BinderDriverCommandProtocol {
 	/*
 	 * void *: cookie
 	 */
+
+	/*
+	 * Type 'g' rather than 'c': upstream uses 'c' 17 and 18 for commands
+	 * with an incompatible binder_buffer_object, which must keep failing
+	 * here. The numbers follow on from the 'c' commands, so per-command
+	 * statistics stay one dense array.
+	 */
+	BC_TRANSACTION_SG = _IOW('g', 17, struct binder_transaction_data_sg),
+	BC_REPLY_SG = _IOW('g', 18, struct binder_transaction_data_sg),
+	/*
+	 * binder_transaction_data_sg: the sent command, with room for the
+	 * buffers of its BINDER_TYPE_PTR objects.
+	 */
 };
 
 #endif /* _LINUX_BINDER_H */
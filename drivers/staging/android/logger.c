@@ -20,31 +20,69 @@
 #include <linux/sched.h>
 #include <linux/module.h>
 #include <linux/fs.h>
+#include <linux/log2.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/uaccess.h>
 #include <linux/poll.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
 #include <linux/time.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
 
+/* the largest entry a writer can produce, header included */
+#define LOGGER_ENTRY_MAX_LEN	(sizeof(struct logger_entry) + \
+				 LOGGER_ENTRY_MAX_PAYLOAD)
+
+/* payloads up to this size are gathered on the stack rather than kmalloc */
+#define LOGGER_WRITE_STACK_LEN	256
+
+/* the smallest ring a log is split into, so one cpu keeps some history */
+#define LOGGER_RING_MIN_SIZE	(64 * 1024)
+
+/* as many rings as the mmap() header page has room for */
+#define LOGGER_MAX_RINGS	((PAGE_SIZE - sizeof(struct logger_mmap_header)) \
+				 / sizeof(struct logger_mmap_ring))
+
+/*
+ * struct logger_ring - one of the per-cpu rings of a log
+ *
+ * Positions are byte counts since the log was created, so that a reader
+ * lapped by the writers is simply one whose position is behind 'tail'; the
+ * offset into 'buffer' is the position modulo 'size', a power of two.
+ * Writers hold 'lock' only to copy a complete entry into the ring, and
+ * only the writers on the cpus mapped to the ring ever contend for it.
+ * Readers hold it to copy an entry out.
+ */
+struct logger_ring {
+	spinlock_t		lock;	/* protects everything below */
+	unsigned char		*buffer;/* storage of this ring */
+	size_t			size;	/* size of the ring */
+	unsigned long		w_pos;	/* current write position */
+	unsigned long		tail;	/* oldest entry not yet overwritten */
+	unsigned long		head;	/* new readers start here */
+	struct logger_mmap_ring	*shared;/* w_pos and tail, for mmap() */
+};
+
 /*
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
  * This structure lives from module insertion until module removal, so it does
- * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * not need additional reference counting. Writers go straight to the ring of
+ * their cpu; the mutex 'mutex' only serializes the readers of the log.
  */
 struct logger_log {
-	unsigned char 		*buffer;/* the ring buffer itself */
 	struct miscdevice	misc;	/* misc device representing the log */
 	wait_queue_head_t	wq;	/* wait queue for readers */
 	struct list_head	readers; /* this log's readers */
-	struct mutex		mutex;	/* mutex protecting buffer */
-	size_t			w_off;	/* current write head offset */
-	size_t			head;	/* new readers start here */
-	size_t			size;	/* size of the log */
+	struct mutex		mutex;	/* mutex protecting the readers */
+	unsigned long		size;	/* of all rings, the budget until init */
+	struct logger_ring	*rings;	/* the rings, one per cpu if they fit */
+	unsigned int		nr_rings;
+	struct logger_mmap_header *mmap_hdr; /* the mmap(), rings follow */
 };
 
 /*
@@ -56,13 +94,17 @@ struct logger_log {
 struct logger_reader {
 	struct logger_log	*log;	/* associated log */
 	struct list_head	list;	/* entry in logger_log's list */
-	size_t			r_off;	/* current read head offset */
 	bool			r_all;	/* reader can read all entries */
 	int			r_ver;	/* reader ABI version */
+	unsigned char		*entry;	/* the entry being read, copied out */
+	unsigned long		r_pos[0]; /* read position in each ring */
 };
 
-/* logger_offset - returns index 'n' into the log via (optimized) modulus */
-#define logger_offset(n)	((n) & (log->size - 1))
+/* ring_offset - returns index 'pos' into the ring via (optimized) modulus */
+#define ring_offset(ring, pos)	((pos) & ((ring)->size - 1))
+
+/* pos_before - is position 'a' before position 'b'? */
+#define pos_before(a, b)	((long)((a) - (b)) < 0)
 
 /*
  * file_get_log - Given a file structure, return the associated log
@@ -88,39 +130,51 @@ static inline struct logger_log *file_get_log(struct file *file)
 }
 
 /*
- * get_entry_header - returns a pointer to the logger_entry header within
- * 'log' starting at offset 'off'. A temporary logger_entry 'scratch' must
- * be provided. Typically the return value will be a pointer within
- * 'logger->buf'.  However, a pointer to 'scratch' may be returned if
- * the log entry spans the end and beginning of the circular buffer.
+ * ring_copy_from - copies 'len' bytes at position 'pos' of 'ring' to 'buf',
+ * wrapping around the end of the ring.
+ *
+ * Caller needs to hold ring->lock.
  */
-static struct logger_entry *get_entry_header(struct logger_log *log,
-		size_t off, struct logger_entry *scratch)
+static void ring_copy_from(struct logger_ring *ring, unsigned long pos,
+			   void *buf, size_t count)
 {
-	size_t len = min(sizeof(struct logger_entry), log->size - off);
-	if (len != sizeof(struct logger_entry)) {
-		memcpy(((void *) scratch), log->buffer + off, len);
-		memcpy(((void *) scratch) + len, log->buffer,
-			sizeof(struct logger_entry) - len);
-		return scratch;
-	}
+	size_t off = ring_offset(ring, pos);
+	size_t len = min(count, ring->size - off);
 
-	return (struct logger_entry *) (log->buffer + off);
+	memcpy(buf, ring->buffer + off, len);
+	if (count != len)
+		memcpy(buf + len, ring->buffer, count - len);
+}
+
+/*
+ * ring_copy_to - copies 'len' bytes from 'buf' to position 'pos' of 'ring',
+ * wrapping around the end of the ring.
+ *
+ * Caller needs to hold ring->lock.
+ */
+static void ring_copy_to(struct logger_ring *ring, unsigned long pos,
+			 const void *buf, size_t count)
+{
+	size_t off = ring_offset(ring, pos);
+	size_t len = min(count, ring->size - off);
+
+	memcpy(ring->buffer + off, buf, len);
+	if (count != len)
+		memcpy(ring->buffer, buf + len, count - len);
 }
 
 /*
- * get_entry_msg_len - Grabs the length of the message of the entry
- * starting from from 'off'.
+ * get_entry_len - Grabs the length of the entry, header included, starting
+ * at position 'pos' of 'ring'.
  *
- * Caller needs to hold log->mutex.
+ * Caller needs to hold ring->lock.
  */
-static __u32 get_entry_msg_len(struct logger_log *log, size_t off)
+static size_t get_entry_len(struct logger_ring *ring, unsigned long pos)
 {
-	struct logger_entry scratch;
-	struct logger_entry *entry;
+	struct logger_entry entry;
 
-	entry = get_entry_header(log, off, &scratch);
-	return entry->len;
+	ring_copy_from(ring, pos, &entry, sizeof(struct logger_entry));
+	return sizeof(struct logger_entry) + entry.len;
 }
 
 static size_t get_user_hdr_len(int ver)
@@ -156,78 +210,157 @@ static ssize_t copy_header_to_user(int ver, struct logger_entry *entry,
 }
 
 /*
- * do_read_log_to_user - reads exactly 'count' bytes from 'log' into the
- * user-space buffer 'buf'. Returns 'count' on success.
+ * ring_fix_up_reader - pulls the reader's position in ring 'i' forward to
+ * the oldest entry left if it was lapped by the writers.
+ *
+ * Caller must hold log->mutex and ring->lock.
+ */
+static void ring_fix_up_reader(struct logger_reader *reader, int i)
+{
+	struct logger_ring *ring = &reader->log->rings[i];
+
+	if (pos_before(reader->r_pos[i], ring->tail) ||
+	    pos_before(ring->w_pos, reader->r_pos[i]))
+		reader->r_pos[i] = ring->tail;
+}
+
+/*
+ * ring_next_entry - Copies the header of the next entry in ring 'i' that
+ * the reader may read to 'entry', skipping the entries of other users for
+ * readers without r_all. Returns false if there is none.
+ *
+ * Caller must hold log->mutex and ring->lock.
+ */
+static bool ring_next_entry(struct logger_reader *reader, int i,
+			    struct logger_entry *entry)
+{
+	struct logger_ring *ring = &reader->log->rings[i];
+	unsigned long *pos = &reader->r_pos[i];
+
+	ring_fix_up_reader(reader, i);
+	while (*pos != ring->w_pos) {
+		ring_copy_from(ring, *pos, entry, sizeof(struct logger_entry));
+		if (reader->r_all || entry->euid == current_euid())
+			return true;
+		*pos += sizeof(struct logger_entry) + entry->len;
+	}
+
+	return false;
+}
+
+static inline bool entry_before(struct logger_entry *a, struct logger_entry *b)
+{
+	return a->sec < b->sec || (a->sec == b->sec && a->nsec < b->nsec);
+}
+
+/*
+ * get_next_entry - Merges the rings of the reader's log: copies the header
+ * of the oldest entry the reader has not read yet to 'entry', and returns
+ * the ring it is in, or -1 if there is nothing to read.
+ *
+ * Entries are stamped under the ring lock, so each ring is in time order.
+ * Across rings, an entry stamped just before one on another cpu can still
+ * be committed just after the reader went past the later one; such entries
+ * are returned late rather than lost.
  *
  * Caller must hold log->mutex.
  */
-static ssize_t do_read_log_to_user(struct logger_log *log,
-				   struct logger_reader *reader,
-				   char __user *buf,
-				   size_t count)
+static int get_next_entry(struct logger_reader *reader,
+			  struct logger_entry *entry)
 {
-	struct logger_entry scratch;
-	struct logger_entry *entry;
-	size_t len;
-	size_t msg_start;
+	struct logger_log *log = reader->log;
+	struct logger_entry next;
+	int i, ret = -1;
 
-	/*
-	 * First, copy the header to userspace, using the version of
-	 * the header requested
-	 */
-	entry = get_entry_header(log, reader->r_off, &scratch);
-	if (copy_header_to_user(reader->r_ver, entry, buf))
-		return -EFAULT;
+	for (i = 0; i < log->nr_rings; i++) {
+		struct logger_ring *ring = &log->rings[i];
+		bool found;
 
-	count -= get_user_hdr_len(reader->r_ver);
-	buf += get_user_hdr_len(reader->r_ver);
-	msg_start = logger_offset(reader->r_off + sizeof(struct logger_entry));
+		spin_lock(&ring->lock);
+		found = ring_next_entry(reader, i, &next);
+		spin_unlock(&ring->lock);
+
+		if (found && (ret < 0 || entry_before(&next, entry))) {
+			*entry = next;
+			ret = i;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * do_read_log_to_user - copies the next entry of the reader, in ring 'i'
+ * with header 'hdr', into the user-space buffer 'buf'. Returns the number
+ * of bytes copied, or -EAGAIN if the writers lapped the reader since the
+ * header was read.
+ *
+ * Caller must hold log->mutex.
+ */
+static ssize_t do_read_log_to_user(struct logger_reader *reader, int i,
+				   struct logger_entry *hdr,
+				   char __user *buf)
+{
+	struct logger_ring *ring = &reader->log->rings[i];
+	struct logger_entry *entry = (struct logger_entry *)reader->entry;
+	size_t len = sizeof(struct logger_entry) + hdr->len;
 
 	/*
-	 * We read from the msg in two disjoint operations. First, we read from
-	 * the current msg head offset up to 'count' bytes or to the end of
-	 * the log, whichever comes first.
+	 * First, copy the entry out of the ring, as the ring lock can not be
+	 * held across a fault on the user buffer.
 	 */
-	len = min(count, log->size - msg_start);
-	if (copy_to_user(buf, log->buffer + msg_start, len))
-		return -EFAULT;
+	spin_lock(&ring->lock);
+	if (pos_before(reader->r_pos[i], ring->tail)) {
+		spin_unlock(&ring->lock);
+		return -EAGAIN;
+	}
+	ring_copy_from(ring, reader->r_pos[i], entry, len);
+	reader->r_pos[i] += len;
+	spin_unlock(&ring->lock);
 
 	/*
-	 * Second, we read any remaining bytes, starting back at the head of
-	 * the log.
+	 * Then copy the header to userspace, using the version of the header
+	 * requested, followed by the payload.
 	 */
-	if (count != len)
-		if (copy_to_user(buf + len, log->buffer, count - len))
-			return -EFAULT;
+	if (copy_header_to_user(reader->r_ver, entry, buf))
+		return -EFAULT;
 
-	reader->r_off = logger_offset(reader->r_off +
-		sizeof(struct logger_entry) + count);
+	buf += get_user_hdr_len(reader->r_ver);
+	if (copy_to_user(buf, entry->msg, entry->len))
+		return -EFAULT;
 
-	return count + get_user_hdr_len(reader->r_ver);
+	return get_user_hdr_len(reader->r_ver) + entry->len;
 }
 
 /*
- * get_next_entry_by_uid - Starting at 'off', returns an offset into
- * 'log->buffer' which contains the first entry readable by 'euid'
+ * do_read_batch_to_user - appends whole entries to the 'done' bytes already
+ * read into 'buf', for as long as there are entries and they fit in
+ * 'count'. Returns the total number of bytes read.
+ *
+ * Caller must hold log->mutex.
  */
-static size_t get_next_entry_by_uid(struct logger_log *log,
-		size_t off, uid_t euid)
+static ssize_t do_read_batch_to_user(struct logger_reader *reader,
+				     char __user *buf, size_t count,
+				     ssize_t done)
 {
-	while (off != log->w_off) {
-		struct logger_entry *entry;
-		struct logger_entry scratch;
-		size_t next_len;
-
-		entry = get_entry_header(log, off, &scratch);
+	struct logger_entry entry;
+	ssize_t ret;
+	int i;
 
-		if (entry->euid == euid)
-			return off;
+	while ((i = get_next_entry(reader, &entry)) >= 0) {
+		if (count - done < get_user_hdr_len(reader->r_ver) + entry.len)
+			break;
 
-		next_len = sizeof(struct logger_entry) + entry->len;
-		off = logger_offset(off + next_len);
+		ret = do_read_log_to_user(reader, i, &entry, buf + done);
+		if (ret == -EAGAIN)
+			continue;
+		/* entries already read are gone from the log, report them */
+		if (ret < 0)
+			return done;
+		done += ret;
 	}
 
-	return off;
+	return done;
 }
 
 /*
@@ -237,7 +370,8 @@ static size_t get_next_entry_by_uid(struct logger_log *log,
  *
  * 	- O_NONBLOCK works
  * 	- If there are no log entries to read, blocks until log is written to
- * 	- Atomically reads exactly one log entry
+ * 	- Atomically reads exactly one log entry, the oldest of all rings,
+ * 	  or as many whole entries as fit for LOGGER_VERSION_BATCH readers
  *
  * Will set errno to EINVAL if read
  * buffer is insufficient to hold next entry.
@@ -247,7 +381,9 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 {
 	struct logger_reader *reader = file->private_data;
 	struct logger_log *log = reader->log;
+	struct logger_entry entry;
 	ssize_t ret;
+	int i;
 	DEFINE_WAIT(wait);
 
 start:
@@ -255,7 +391,7 @@ start:
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
 		mutex_lock(&log->mutex);
-		ret = (log->w_off == reader->r_off);
+		ret = (get_next_entry(reader, &entry) < 0);
 		mutex_unlock(&log->mutex);
 		if (!ret)
 			break;
@@ -279,26 +415,28 @@ start:
 
 	mutex_lock(&log->mutex);
 
-	if (!reader->r_all)
-		reader->r_off = get_next_entry_by_uid(log,
-			reader->r_off, current_euid());
+	do {
+		/* is there still something to read or did we race? */
+		i = get_next_entry(reader, &entry);
+		if (unlikely(i < 0)) {
+			mutex_unlock(&log->mutex);
+			goto start;
+		}
 
-	/* is there still something to read or did we race? */
-	if (unlikely(log->w_off == reader->r_off)) {
-		mutex_unlock(&log->mutex);
-		goto start;
-	}
+		/* get the size of the next entry */
+		ret = get_user_hdr_len(reader->r_ver) + entry.len;
+		if (count < ret) {
+			ret = -EINVAL;
+			goto out;
+		}
 
-	/* get the size of the next entry */
-	ret = get_user_hdr_len(reader->r_ver) +
-		get_entry_msg_len(log, reader->r_off);
-	if (count < ret) {
-		ret = -EINVAL;
-		goto out;
-	}
+		/* get exactly one entry from the log */
+		ret = do_read_log_to_user(reader, i, &entry, buf);
+	} while (ret == -EAGAIN);
 
-	/* get exactly one entry from the log */
-	ret = do_read_log_to_user(log, reader, buf, ret);
+	/* batching readers get as many more whole entries as fit */
+	if (reader->r_ver >= LOGGER_VERSION_BATCH && ret > 0)
+		ret = do_read_batch_to_user(reader, buf, count, ret);
 
 out:
 	mutex_unlock(&log->mutex);
@@ -307,129 +445,58 @@ out:
 }
 
 /*
- * get_next_entry - return the offset of the first valid entry at least 'len'
- * bytes after 'off'.
- *
- * Caller must hold log->mutex.
- */
-static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
-{
-	size_t count = 0;
-
-	do {
-		size_t nr = sizeof(struct logger_entry) +
-			get_entry_msg_len(log, off);
-		off = logger_offset(off + nr);
-		count += nr;
-	} while (count < len);
-
-	return off;
-}
-
-/*
- * clock_interval - is a < c < b in mod-space? Put another way, does the line
- * from a to b cross c?
- */
-static inline int clock_interval(size_t a, size_t b, size_t c)
-{
-	if (b < a) {
-		if (a < c || b >= c)
-			return 1;
-	} else {
-		if (a < c && b >= c)
-			return 1;
-	}
-
-	return 0;
-}
-
-/*
- * fix_up_readers - walk the list of all readers and "fix up" any who were
- * lapped by the writer; also do the same for the default "start head".
- * We do this by "pulling forward" the readers and start head to the first
- * entry after the new write head.
- *
- * The caller needs to hold log->mutex.
- */
-static void fix_up_readers(struct logger_log *log, size_t len)
-{
-	size_t old = log->w_off;
-	size_t new = logger_offset(old + len);
-	struct logger_reader *reader;
-
-	if (clock_interval(old, new, log->head))
-		log->head = get_next_entry(log, log->head, len);
-
-	list_for_each_entry(reader, &log->readers, list)
-		if (clock_interval(old, new, reader->r_off))
-			reader->r_off = get_next_entry(log, reader->r_off, len);
-}
-
-/*
- * do_write_log - writes 'len' bytes from 'buf' to 'log'
+ * do_write_log - writes the entry 'header' with payload 'msg' to 'ring',
+ * first pulling the ring's tail and start head forward past the entries
+ * it overwrites. Readers lapped this way catch up on their next read.
  *
- * The caller needs to hold log->mutex.
+ * The caller needs to hold ring->lock.
  */
-static void do_write_log(struct logger_log *log, const void *buf, size_t count)
+static void do_write_log(struct logger_ring *ring,
+			 struct logger_entry *header, const void *msg)
 {
-	size_t len;
+	size_t len = sizeof(struct logger_entry) + header->len;
 
-	len = min(count, log->size - log->w_off);
-	memcpy(log->buffer + log->w_off, buf, len);
+	while (ring->w_pos + len - ring->tail > ring->size)
+		ring->tail += get_entry_len(ring, ring->tail);
+	if (pos_before(ring->head, ring->tail))
+		ring->head = ring->tail;
 
-	if (count != len)
-		memcpy(log->buffer, buf + len, count - len);
+	/* mappers must see the new tail before the entries it overwrites */
+	ring->shared->tail = ring->tail;
+	smp_wmb();
 
-	log->w_off = logger_offset(log->w_off + count);
+	ring_copy_to(ring, ring->w_pos, header, sizeof(struct logger_entry));
+	ring_copy_to(ring, ring->w_pos + sizeof(struct logger_entry),
+		     msg, header->len);
+	ring->w_pos += len;
 
-}
-
-/*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
- *
- * The caller needs to hold log->mutex.
- *
- * Returns 'count' on success, negative error code on failure.
- */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
-{
-	size_t len;
-
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
-
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
-			return -EFAULT;
-
-	log->w_off = logger_offset(log->w_off + count);
-
-	return count;
+	smp_wmb();
+	ring->shared->w_pos = ring->w_pos;
 }
 
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
  * them above all else.
+ *
+ * The payload is gathered from userspace before the ring of this cpu is
+ * locked, so a fault never holds up another writer, and a failed copy
+ * leaves the log untouched. Writers on different cpus share nothing but
+ * the readers' wait queue, which is only touched if someone waits on it.
  */
 ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
+	struct logger_ring *ring;
 	struct logger_entry header;
 	struct timespec now;
+	char stack_msg[LOGGER_WRITE_STACK_LEN];
+	char *msg = stack_msg;
 	ssize_t ret = 0;
 
-	now = current_kernel_time();
-
 	header.pid = current->tgid;
 	header.tid = current->pid;
-	header.sec = now.tv_sec;
-	header.nsec = now.tv_nsec;
 	header.euid = current_euid();
 	header.len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
 	header.hdr_size = sizeof(struct logger_entry);
@@ -438,41 +505,47 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
+	if (header.len > sizeof(stack_msg)) {
+		msg = kmalloc(header.len, GFP_KERNEL);
+		if (!msg)
+			return -ENOMEM;
+	}
 
 	while (nr_segs-- > 0) {
 		size_t len;
-		ssize_t nr;
 
 		/* figure out how much of this vector we can keep */
 		len = min_t(size_t, iov->iov_len, header.len - ret);
 
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
+		/* gather this segment's payload */
+		if (len && copy_from_user(msg + ret, iov->iov_base, len)) {
+			ret = -EFAULT;
+			goto out;
 		}
 
 		iov++;
-		ret += nr;
+		ret += len;
 	}
 
-	mutex_unlock(&log->mutex);
+	ring = &log->rings[raw_smp_processor_id() % log->nr_rings];
+	spin_lock(&ring->lock);
+
+	/* stamped under the lock, so that every ring is in time order */
+	getnstimeofday(&now);
+	header.sec = now.tv_sec;
+	header.nsec = now.tv_nsec;
+
+	do_write_log(ring, &header, msg);
+	spin_unlock(&ring->lock);
 
 	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
+	smp_mb();
+	if (waitqueue_active(&log->wq))
+		wake_up_interruptible(&log->wq);
+
+out:
+	if (msg != stack_msg)
+		kfree(msg);
 
 	return ret;
 }
@@ -499,11 +572,20 @@ static int logger_open(struct inode *inode, struct file *file)
 
 	if (file->f_mode & FMODE_READ) {
 		struct logger_reader *reader;
+		int i;
 
-		reader = kmalloc(sizeof(struct logger_reader), GFP_KERNEL);
+		reader = kmalloc(sizeof(struct logger_reader) +
+				 log->nr_rings * sizeof(unsigned long),
+				 GFP_KERNEL);
 		if (!reader)
 			return -ENOMEM;
 
+		reader->entry = kmalloc(LOGGER_ENTRY_MAX_LEN, GFP_KERNEL);
+		if (!reader->entry) {
+			kfree(reader);
+			return -ENOMEM;
+		}
+
 		reader->log = log;
 		reader->r_ver = 1;
 		reader->r_all = in_egroup_p(inode->i_gid) ||
@@ -512,7 +594,11 @@ static int logger_open(struct inode *inode, struct file *file)
 		INIT_LIST_HEAD(&reader->list);
 
 		mutex_lock(&log->mutex);
-		reader->r_off = log->head;
+		for (i = 0; i < log->nr_rings; i++) {
+			spin_lock(&log->rings[i].lock);
+			reader->r_pos[i] = log->rings[i].head;
+			spin_unlock(&log->rings[i].lock);
+		}
 		list_add_tail(&reader->list, &log->readers);
 		mutex_unlock(&log->mutex);
 
@@ -532,7 +618,13 @@ static int logger_release(struct inode *ignored, struct file *file)
 {
 	if (file->f_mode & FMODE_READ) {
 		struct logger_reader *reader = file->private_data;
+		struct logger_log *log = reader->log;
+
+		mutex_lock(&log->mutex);
 		list_del(&reader->list);
+		mutex_unlock(&log->mutex);
+
+		kfree(reader->entry);
 		kfree(reader);
 	}
 
@@ -552,6 +644,7 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 {
 	struct logger_reader *reader;
 	struct logger_log *log;
+	struct logger_entry entry;
 	unsigned int ret = POLLOUT | POLLWRNORM;
 
 	if (!(file->f_mode & FMODE_READ))
@@ -563,24 +656,51 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
-	if (!reader->r_all)
-		reader->r_off = get_next_entry_by_uid(log,
-			reader->r_off, current_euid());
-
-	if (log->w_off != reader->r_off)
+	if (get_next_entry(reader, &entry) >= 0)
 		ret |= POLLIN | POLLRDNORM;
 	mutex_unlock(&log->mutex);
 
 	return ret;
 }
 
+/*
+ * logger_mmap - the log's mmap file operation
+ *
+ * Maps the header page and all rings of the log read-only, for readers
+ * that may read all entries; see struct logger_mmap_header. The mapping
+ * starts at offset 0 and covers all of it.
+ */
+static int logger_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct logger_reader *reader;
+	struct logger_log *log;
+	unsigned long start = vma->vm_start;
+
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+
+	reader = file->private_data;
+	log = reader->log;
+
+	if (!reader->r_all)
+		return -EPERM;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	if (vma->vm_pgoff || vma->vm_end - start != PAGE_SIZE + log->size)
+		return -EINVAL;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, log->mmap_hdr, 0);
+}
+
 static long logger_set_version(struct logger_reader *reader, void __user *arg)
 {
 	int version;
 	if (copy_from_user(&version, arg, sizeof(int)))
 		return -EFAULT;
 
-	if ((version < 1) || (version > 2))
+	if ((version < 1) || (version > LOGGER_VERSION_BATCH))
 		return -EINVAL;
 
 	reader->r_ver = version;
@@ -591,13 +711,17 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct logger_log *log = file_get_log(file);
 	struct logger_reader *reader;
+	struct logger_ring *ring;
+	struct logger_entry entry;
 	long ret = -EINVAL;
 	void __user *argp = (void __user *) arg;
+	int i;
 
 	mutex_lock(&log->mutex);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
+		/* of all rings together, the most GET_LOG_LEN can report */
 		ret = log->size;
 		break;
 	case LOGGER_GET_LOG_LEN:
@@ -606,10 +730,14 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		reader = file->private_data;
-		if (log->w_off >= reader->r_off)
-			ret = log->w_off - reader->r_off;
-		else
-			ret = (log->size - reader->r_off) + log->w_off;
+		ret = 0;
+		for (i = 0; i < log->nr_rings; i++) {
+			ring = &log->rings[i];
+			spin_lock(&ring->lock);
+			ring_fix_up_reader(reader, i);
+			ret += ring->w_pos - reader->r_pos[i];
+			spin_unlock(&ring->lock);
+		}
 		break;
 	case LOGGER_GET_NEXT_ENTRY_LEN:
 		if (!(file->f_mode & FMODE_READ)) {
@@ -618,13 +746,8 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 		reader = file->private_data;
 
-		if (!reader->r_all)
-			reader->r_off = get_next_entry_by_uid(log,
-				reader->r_off, current_euid());
-
-		if (log->w_off != reader->r_off)
-			ret = get_user_hdr_len(reader->r_ver) +
-				get_entry_msg_len(log, reader->r_off);
+		if (get_next_entry(reader, &entry) >= 0)
+			ret = get_user_hdr_len(reader->r_ver) + entry.len;
 		else
 			ret = 0;
 		break;
@@ -633,9 +756,14 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			ret = -EBADF;
 			break;
 		}
-		list_for_each_entry(reader, &log->readers, list)
-			reader->r_off = log->w_off;
-		log->head = log->w_off;
+		for (i = 0; i < log->nr_rings; i++) {
+			ring = &log->rings[i];
+			spin_lock(&ring->lock);
+			list_for_each_entry(reader, &log->readers, list)
+				reader->r_pos[i] = ring->w_pos;
+			ring->head = ring->w_pos;
+			spin_unlock(&ring->lock);
+		}
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -666,6 +794,7 @@ static const struct file_operations logger_fops = {
 	.read = logger_read,
 	.aio_write = logger_aio_write,
 	.poll = logger_poll,
+	.mmap = logger_mmap,
 	.unlocked_ioctl = logger_ioctl,
 	.compat_ioctl = logger_ioctl,
 	.open = logger_open,
@@ -673,14 +802,14 @@ static const struct file_operations logger_fops = {
 };
 
 /*
- * Defines a log structure with name 'NAME' and a size of 'SIZE' bytes, which
- * must be a power of two, and greater than
- * (LOGGER_ENTRY_MAX_PAYLOAD + sizeof(struct logger_entry)).
+ * Defines a log structure with name 'NAME' and 'SIZE' bytes shared by its
+ * rings, which are allocated at init once the number of cpus is known.
+ * The size can be overridden with the VAR_size parameter, e.g.
+ * logger.log_main_size=1048576 on the kernel command line, for devices
+ * that can afford more history per cpu.
  */
 #define DEFINE_LOGGER_DEVICE(VAR, NAME, SIZE) \
-static unsigned char _buf_ ## VAR[SIZE]; \
 static struct logger_log VAR = { \
-	.buffer = _buf_ ## VAR, \
 	.misc = { \
 		.minor = MISC_DYNAMIC_MINOR, \
 		.name = NAME, \
@@ -690,10 +819,9 @@ static struct logger_log VAR = { \
 	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .wq), \
 	.readers = LIST_HEAD_INIT(VAR .readers), \
 	.mutex = __MUTEX_INITIALIZER(VAR .mutex), \
-	.w_off = 0, \
-	.head = 0, \
 	.size = SIZE, \
-};
+}; \
+module_param_named(VAR##_size, VAR.size, ulong, 0444);
 
 DEFINE_LOGGER_DEVICE(log_main, LOGGER_LOG_MAIN, 256*1024)
 DEFINE_LOGGER_DEVICE(log_events, LOGGER_LOG_EVENTS, 256*1024)
@@ -713,19 +841,74 @@ static struct logger_log *get_log_from_minor(int minor)
 	return NULL;
 }
 
+/*
+ * init_rings - splits the log->size budget into one power-of-two ring per
+ * possible cpu, as many as the budget has room for at LOGGER_RING_MIN_SIZE
+ * each and the mmap() header page can describe, with cpus sharing them
+ * beyond that. The rings never add up to more than the budget. The header
+ * page and the rings are a single vmalloc area, laid out as they are mapped.
+ */
+static int __init init_rings(struct logger_log *log)
+{
+	unsigned long budget = max_t(unsigned long, log->size,
+				     LOGGER_RING_MIN_SIZE);
+	unsigned int nr_rings = min_t(unsigned int, nr_cpu_ids,
+				      LOGGER_MAX_RINGS);
+	size_t ring_size;
+	unsigned char *buffer;
+	int i;
+
+	nr_rings = clamp_t(unsigned int, budget / LOGGER_RING_MIN_SIZE,
+			   1, nr_rings);
+	ring_size = rounddown_pow_of_two(budget / nr_rings);
+
+	log->rings = kcalloc(nr_rings, sizeof(struct logger_ring), GFP_KERNEL);
+	if (!log->rings)
+		return -ENOMEM;
+
+	log->mmap_hdr = vmalloc_user(PAGE_SIZE + nr_rings * ring_size);
+	if (!log->mmap_hdr) {
+		kfree(log->rings);
+		return -ENOMEM;
+	}
+	log->mmap_hdr->version = 1;
+	log->mmap_hdr->nr_rings = nr_rings;
+	buffer = (unsigned char *)log->mmap_hdr + PAGE_SIZE;
+
+	for (i = 0; i < nr_rings; i++) {
+		spin_lock_init(&log->rings[i].lock);
+		log->rings[i].buffer = buffer + i * ring_size;
+		log->rings[i].size = ring_size;
+		log->rings[i].shared = &log->mmap_hdr->ring[i];
+		log->rings[i].shared->offset = PAGE_SIZE + i * ring_size;
+		log->rings[i].shared->size = ring_size;
+	}
+	log->nr_rings = nr_rings;
+	log->size = nr_rings * ring_size;
+
+	return 0;
+}
+
 static int __init init_log(struct logger_log *log)
 {
 	int ret;
 
+	ret = init_rings(log);
+	if (unlikely(ret))
+		return ret;
+
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
 		printk(KERN_ERR "logger: failed to register misc "
 		       "device for log '%s'!\n", log->misc.name);
+		vfree(log->mmap_hdr);
+		kfree(log->rings);
 		return ret;
 	}
 
-	printk(KERN_INFO "logger: created %luK log '%s'\n",
-	       (unsigned long) log->size >> 10, log->misc.name);
+	printk(KERN_INFO "logger: created %luK log '%s' in %u rings\n",
+	       log->size >> 10, log->misc.name,
+	       log->nr_rings);
 
 	return 0;
 }
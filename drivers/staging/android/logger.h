@@ -51,6 +51,40 @@ struct logger_entry {
 	char		msg[0];		/* the entry's payload */
 };
 
+/*
+ * Version 3 of the logger_entry ABI returns entries laid out as version 2
+ * does, but read() returns as many whole entries as fit in the buffer,
+ * back to back with no padding, rather than exactly one; so all headers but
+ * the first may be unaligned.
+ */
+#define LOGGER_VERSION_BATCH	3
+
+/*
+ * The read-only view a reader with access to all entries can mmap(): one
+ * page holding a struct logger_mmap_header, followed by the log's rings at
+ * the offsets given in it. Each ring holds whole version 2 entries, some
+ * wrapping around its end; positions are byte counts modulo 2^32, and the
+ * offset of a position in a ring is the position modulo the ring's size.
+ *
+ * Entries from 'tail' up to 'w_pos' are complete. Writers move 'tail'
+ * before overwriting an entry and 'w_pos' after finishing one, so a mapper
+ * reads 'w_pos', copies entries out, and then re-reads 'tail': whatever it
+ * copied from before the new tail may have been overwritten meanwhile.
+ * Entries of all rings are merged by their timestamps.
+ */
+struct logger_mmap_ring {
+	__u32		w_pos;		/* end of the last complete entry */
+	__u32		tail;		/* oldest entry not overwritten */
+	__u32		offset;		/* of the ring from the mapping start */
+	__u32		size;		/* of the ring, a power of two */
+};
+
+struct logger_mmap_header {
+	__u32		version;	/* of this layout, 1 */
+	__u32		nr_rings;
+	struct logger_mmap_ring	ring[0];
+};
+
 #define LOGGER_LOG_RADIO	"log_radio"	/* radio-related messages */
 #define LOGGER_LOG_EVENTS	"log_events"	/* system/hardware events */
 #define LOGGER_LOG_SYSTEM	"log_system"	/* system/framework messages */
@@ -12,6 +12,18 @@
  * and kill processes with a oom_adj value of 0 or higher when the free memory
  * drops below 1024 pages.
  *
+ * Candidates come from the oom_adj buckets the kernel keeps up to date on
+ * oom_adj writes, fork, exec and exit (see include/linux/oom.h): only the
+ * highest non-empty buckets at or above the minimum oom_adj are looked at,
+ * rather than every process in the system.
+ *
+ * With /sys/module/lowmemorykiller/parameters/pressure set, a threshold being
+ * crossed is not enough on its own: a process is only killed once reclaim is
+ * struggling, i.e. of the last pressure_window pages reclaim scanned it freed
+ * fewer than pressure_efficiency percent, or direct reclaim stalled for
+ * pressure_stall_ms in total since the last check. A page cache that is
+ * cold, rather than hot, then gets reclaimed instead of costing a process.
+ *
  * The driver considers memory used for caches to be free, but if a large
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
@@ -35,6 +47,10 @@
 #include <linux/oom.h>
 #include <linux/sched.h>
 #include <linux/notifier.h>
+#include <linux/swap.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/vmpressure.h>
 
 static uint32_t lowmem_debug_level = 2;
 static int lowmem_adj[6] = {
@@ -52,6 +68,16 @@ static size_t lowmem_minfree[6] = {
 };
 static int lowmem_minfree_size = 4;
 
+static bool lowmem_pressure_mode;
+static unsigned long lowmem_pressure_window = SWAP_CLUSTER_MAX * 16;
+static unsigned int lowmem_pressure_efficiency = 40;
+static unsigned int lowmem_pressure_stall_ms = 100;
+
+static DEFINE_SPINLOCK(lowmem_pressure_lock);
+static struct vmpressure_stat lowmem_pressure_last;
+static unsigned long lowmem_pressure_expires;
+static bool lowmem_pressure;
+
 static struct task_struct *lowmem_deathpending;
 static unsigned long lowmem_deathpending_timeout;
 
@@ -79,10 +105,52 @@ task_notify_func(struct notifier_block *self, unsigned long val, void *data)
 	return NOTIFY_OK;
 }
 
+/*
+ * Whether reclaim has been failing to keep up since the last verdict. A new
+ * verdict is reached once reclaim has scanned a full window, or a second
+ * after the last one; until then, and while another cpu is busy reaching
+ * one, the last verdict stands.
+ */
+static bool lowmem_reclaim_struggling(void)
+{
+	struct vmpressure_stat now;
+	unsigned long scanned, reclaimed, stall_us;
+	bool full;
+
+	if (!spin_trylock(&lowmem_pressure_lock))
+		return lowmem_pressure;
+
+	vmpressure_read(&now);
+	scanned = now.scanned - lowmem_pressure_last.scanned;
+	full = scanned >= lowmem_pressure_window;
+	if (full || time_after_eq(jiffies, lowmem_pressure_expires)) {
+		reclaimed = now.reclaimed - lowmem_pressure_last.reclaimed;
+		stall_us = now.stall_us - lowmem_pressure_last.stall_us;
+
+		lowmem_pressure = (full && reclaimed <
+				   scanned / 100 * lowmem_pressure_efficiency) ||
+			stall_us >= lowmem_pressure_stall_ms * USEC_PER_MSEC;
+		lowmem_print(3, "lowmem_pressure scanned %lu, reclaimed %lu, "
+			     "stalled %luus in %lu, %s\n",
+			     scanned, reclaimed, stall_us,
+			     now.stalls - lowmem_pressure_last.stalls,
+			     lowmem_pressure ? "struggling" : "keeping up");
+
+		lowmem_pressure_last = now;
+		lowmem_pressure_expires = jiffies + HZ;
+	}
+	spin_unlock(&lowmem_pressure_lock);
+
+	return lowmem_pressure;
+}
+
 static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
 	struct task_struct *p;
 	struct task_struct *selected = NULL;
+	struct signal_struct *sig;
+	struct hlist_node *node;
+	int oom_adj;
 	int rem = 0;
 	int tasksize;
 	int i;
@@ -129,43 +197,49 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			     sc->nr_to_scan, sc->gfp_mask, rem);
 		return rem;
 	}
+	if (lowmem_pressure_mode && !lowmem_reclaim_struggling()) {
+		lowmem_print(4, "lowmem_shrink %lu, %x, reclaim keeping up, "
+			     "return %d\n", sc->nr_to_scan, sc->gfp_mask, rem);
+		return rem;
+	}
 	selected_oom_adj = min_adj;
 
-	read_lock(&tasklist_lock);
-	for_each_process(p) {
-		struct mm_struct *mm;
-		struct signal_struct *sig;
-		int oom_adj;
-
-		task_lock(p);
-		mm = p->mm;
-		sig = p->signal;
-		if (!mm || !sig) {
-			task_unlock(p);
-			continue;
-		}
-		oom_adj = sig->oom_adj;
-		if (oom_adj < min_adj) {
+	/*
+	 * The highest bucket with a killable process in it has the victim:
+	 * its largest process. curr_target is a live thread of the group,
+	 * and stays a valid task under rcu even if it exits meanwhile.
+	 * oom_adj_lock is the outer lock: task_lock() nests inside it, and
+	 * it is never taken with a task or sighand lock held.
+	 */
+	spin_lock(&oom_adj_lock);
+	rcu_read_lock();
+	for (oom_adj = OOM_ADJUST_MAX; oom_adj >= min_adj && !selected;
+	     oom_adj--) {
+		hlist_for_each_entry(sig, node, oom_adj_bucket(oom_adj),
+				     oom_adj_node) {
+			p = find_lock_task_mm(sig->curr_target);
+			if (!p)
+				continue;
+			tasksize = get_mm_rss(p->mm);
 			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_adj < selected_oom_adj)
+			if (tasksize <= 0)
 				continue;
-			if (oom_adj == selected_oom_adj &&
-			    tasksize <= selected_tasksize)
+			if (selected && tasksize <= selected_tasksize)
 				continue;
+			selected = p;
+			selected_tasksize = tasksize;
+			selected_oom_adj = oom_adj;
+			lowmem_print(2, "select %d (%s), adj %d, size %d, "
+				     "to kill\n",
+				     p->pid, p->comm, oom_adj, tasksize);
 		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_adj = oom_adj;
-		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_adj, tasksize);
 	}
+	if (selected)
+		get_task_struct(selected);
+	rcu_read_unlock();
+	spin_unlock(&oom_adj_lock);
+
+	/* the scan is done; take the victim's siglock without oom_adj_lock */
 	if (selected) {
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
 			     selected->pid, selected->comm,
@@ -174,10 +248,10 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		lowmem_deathpending_timeout = jiffies + HZ;
 		force_sig(SIGKILL, selected);
 		rem -= selected_tasksize;
+		put_task_struct(selected);
 	}
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     sc->nr_to_scan, sc->gfp_mask, rem);
-	read_unlock(&tasklist_lock);
 	return rem;
 }
 
@@ -188,6 +262,8 @@ static struct shrinker lowmem_shrinker = {
 
 static int __init lowmem_init(void)
 {
+	vmpressure_read(&lowmem_pressure_last);
+	lowmem_pressure_expires = jiffies + HZ;
 	task_free_register(&task_nb);
 	register_shrinker(&lowmem_shrinker);
 	return 0;
@@ -204,6 +280,13 @@ module_param_array_named(adj, lowmem_adj, int, &lowmem_adj_size,
 			 S_IRUGO | S_IWUSR);
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
+module_param_named(pressure, lowmem_pressure_mode, bool, S_IRUGO | S_IWUSR);
+module_param_named(pressure_window, lowmem_pressure_window, ulong,
+		   S_IRUGO | S_IWUSR);
+module_param_named(pressure_efficiency, lowmem_pressure_efficiency, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(pressure_stall_ms, lowmem_pressure_stall_ms, uint,
+		   S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
 
 module_init(lowmem_init);
@@ -1691,6 +1691,18 @@ static inline void tegra_dc_mask_interrupt(struct tegra_dc *dc, u32 int_val)
 	tegra_dc_writel(dc, val, DC_CMD_INT_MASK);
 }
 
+/* Take a vblank ref-count bit and make sure V_BLANK_INT is delivered.  The
+ * bit is dropped by its owner once it has no more vblank work queued; the
+ * vblank worker then masks the interrupt again. */
+void tegra_dc_hold_vblank(struct tegra_dc *dc, int bit)
+{
+	mutex_lock(&dc->lock);
+	set_bit(bit, &dc->vblank_ref_count);
+	if (dc->enabled)
+		tegra_dc_unmask_interrupt(dc, V_BLANK_INT);
+	mutex_unlock(&dc->lock);
+}
+
 static int tegra_dc_program_mode(struct tegra_dc *dc, struct tegra_dc_mode *mode)
 {
 	unsigned long val;
@@ -2068,6 +2080,10 @@ static void tegra_dc_vblank(struct work_struct *work)
 	if (!tegra_dc_windows_are_dirty(dc))
 		clear_bit(V_BLANK_FLIP, &dc->vblank_ref_count);
 
+	/* Apply cursor state latched since the last vblank. */
+	if (dc->ext)
+		tegra_dc_ext_vblank(dc->ext);
+
 	/* Update the SD brightness */
 	if (dc->enabled && dc->out->sd_settings) {
 		nvsd_updated = nvsd_update_brightness(dc);
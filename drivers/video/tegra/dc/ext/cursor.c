@@ -82,25 +82,111 @@ static void set_cursor_image_hw(struct tegra_dc *dc,
 		DC_DISP_CURSOR_START_ADDR);
 }
 
-int tegra_dc_ext_set_cursor_image(struct tegra_dc_ext_user *user,
-				  struct tegra_dc_ext_cursor_image *args)
+static int validate_cursor_image(struct tegra_dc_ext_cursor_image *args)
+{
+	u32 size;
+
+	size = args->flags & (TEGRA_DC_EXT_CURSOR_IMAGE_FLAGS_SIZE_32x32 |
+			      TEGRA_DC_EXT_CURSOR_IMAGE_FLAGS_SIZE_64x64);
+
+	if (size != TEGRA_DC_EXT_CURSOR_IMAGE_FLAGS_SIZE_32x32 &&
+	    size !=  TEGRA_DC_EXT_CURSOR_IMAGE_FLAGS_SIZE_64x64)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void set_cursor_position_hw(struct tegra_dc *dc, bool enable,
+				   u32 position)
+{
+	u32 win_options;
+
+	win_options = tegra_dc_readl(dc, DC_DISP_DISP_WIN_OPTIONS);
+	if (!!(win_options & CURSOR_ENABLE) != enable) {
+		win_options &= ~CURSOR_ENABLE;
+		if (enable)
+			win_options |= CURSOR_ENABLE;
+		tegra_dc_writel(dc, win_options, DC_DISP_DISP_WIN_OPTIONS);
+	}
+
+	tegra_dc_writel(dc, position, DC_DISP_CURSOR_POSITION);
+}
+
+/*
+ * Latch a new cursor position; it is programmed from the vblank worker so
+ * that any number of moves within one frame result in a single update.
+ * Must be called with cursor.lock held.
+ */
+static void latch_cursor(struct tegra_dc_ext *ext,
+			 struct tegra_dc_ext_cursor *args)
+{
+	struct tegra_dc_ext_cursor_pending *pending = &ext->cursor.pending;
+	bool hold;
+
+	spin_lock(&ext->cursor.pending_lock);
+	pending->enable = !!(args->flags & TEGRA_DC_EXT_CURSOR_FLAGS_VISIBLE);
+	pending->position = CURSOR_POSITION(args->x, args->y);
+	hold = !pending->dirty;
+	pending->dirty = true;
+	spin_unlock(&ext->cursor.pending_lock);
+
+	/* Only the first latch since the last update unmasks the interrupt. */
+	if (hold)
+		tegra_dc_hold_vblank(ext->dc, V_BLANK_CURSOR);
+}
+
+/*
+ * Drop any cursor state that has not reached the hardware yet, along with
+ * its hold on the vblank interrupt: the vblank worker does not run while
+ * the DC is disabled, so it would never drop it itself.
+ */
+void tegra_dc_ext_cursor_reset(struct tegra_dc_ext *ext)
+{
+	spin_lock(&ext->cursor.pending_lock);
+	ext->cursor.pending.dirty = false;
+	clear_bit(V_BLANK_CURSOR, &ext->dc->vblank_ref_count);
+	spin_unlock(&ext->cursor.pending_lock);
+}
+
+/* Called from the vblank worker, with dc->lock held. */
+void tegra_dc_ext_vblank(struct tegra_dc_ext *ext)
+{
+	struct tegra_dc_ext_cursor_pending *pending = &ext->cursor.pending;
+	struct tegra_dc *dc = ext->dc;
+
+	spin_lock(&ext->cursor.pending_lock);
+
+	if (pending->dirty) {
+		set_cursor_position_hw(dc, pending->enable, pending->position);
+
+		tegra_dc_writel(dc, GENERAL_ACT_REQ << 8, DC_CMD_STATE_CONTROL);
+		tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
+
+		pending->dirty = false;
+	}
+
+	/* Nothing left to apply; the interrupt can be masked. */
+	clear_bit(V_BLANK_CURSOR, &dc->vblank_ref_count);
+
+	spin_unlock(&ext->cursor.pending_lock);
+}
+
+static int set_cursor_image(struct tegra_dc_ext_user *user,
+			    struct tegra_dc_ext_cursor_image *args,
+			    struct tegra_dc_ext_cursor *pos)
 {
 	struct tegra_dc_ext *ext = user->ext;
 	struct tegra_dc *dc = ext->dc;
 	struct nvmap_handle_ref *handle, *old_handle;
 	dma_addr_t phys_addr;
-	u32 size;
 	int ret;
 
 	if (!user->nvmap)
 		return -EFAULT;
 
-	size = args->flags & (TEGRA_DC_EXT_CURSOR_IMAGE_FLAGS_SIZE_32x32 |
-			      TEGRA_DC_EXT_CURSOR_IMAGE_FLAGS_SIZE_64x64);
-
-	if (size != TEGRA_DC_EXT_CURSOR_IMAGE_FLAGS_SIZE_32x32 &&
-	    size !=  TEGRA_DC_EXT_CURSOR_IMAGE_FLAGS_SIZE_64x64)
-		return -EINVAL;
+	ret = validate_cursor_image(args);
+	if (ret)
+		return ret;
 
 	mutex_lock(&ext->cursor.lock);
 
@@ -126,6 +212,17 @@ int tegra_dc_ext_set_cursor_image(struct tegra_dc_ext_user *user,
 
 	set_cursor_image_hw(dc, args, phys_addr);
 
+	/*
+	 * Program the new position in the same update as the image, and drop
+	 * any older position still waiting for vblank.
+	 */
+	if (pos) {
+		tegra_dc_ext_cursor_reset(ext);
+		set_cursor_position_hw(dc,
+			!!(pos->flags & TEGRA_DC_EXT_CURSOR_FLAGS_VISIBLE),
+			CURSOR_POSITION(pos->x, pos->y));
+	}
+
 	tegra_dc_writel(dc, GENERAL_ACT_REQ << 8, DC_CMD_STATE_CONTROL);
 	tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
 
@@ -148,14 +245,17 @@ unlock:
 	return ret;
 }
 
+int tegra_dc_ext_set_cursor_image(struct tegra_dc_ext_user *user,
+				  struct tegra_dc_ext_cursor_image *args)
+{
+	return set_cursor_image(user, args, NULL);
+}
+
 int tegra_dc_ext_set_cursor(struct tegra_dc_ext_user *user,
 			    struct tegra_dc_ext_cursor *args)
 {
 	struct tegra_dc_ext *ext = user->ext;
-	struct tegra_dc *dc = ext->dc;
-	u32 win_options;
-	bool enable;
-	int ret;
+	int ret = 0;
 
 	mutex_lock(&ext->cursor.lock);
 
@@ -169,35 +269,19 @@ int tegra_dc_ext_set_cursor(struct tegra_dc_ext_user *user,
 		goto unlock;
 	}
 
-	enable = !!(args->flags & TEGRA_DC_EXT_CURSOR_FLAGS_VISIBLE);
-
-	mutex_lock(&dc->lock);
-
-	win_options = tegra_dc_readl(dc, DC_DISP_DISP_WIN_OPTIONS);
-	if (!!(win_options & CURSOR_ENABLE) != enable) {
-		win_options &= ~CURSOR_ENABLE;
-		if (enable)
-			win_options |= CURSOR_ENABLE;
-		tegra_dc_writel(dc, win_options, DC_DISP_DISP_WIN_OPTIONS);
-	}
-
-	tegra_dc_writel(dc, CURSOR_POSITION(args->x, args->y),
-		DC_DISP_CURSOR_POSITION);
-
-	tegra_dc_writel(dc, GENERAL_ACT_REQ << 8, DC_CMD_STATE_CONTROL);
-	tegra_dc_writel(dc, GENERAL_ACT_REQ, DC_CMD_STATE_CONTROL);
-
-	/* TODO: need to sync here?  hopefully can avoid this, but need to
-	 * figure out interaction w/ rest of GENERAL_ACT_REQ */
-
-	mutex_unlock(&dc->lock);
-
-	mutex_unlock(&ext->cursor.lock);
-
-	return 0;
+	latch_cursor(ext, args);
 
 unlock:
 	mutex_unlock(&ext->cursor.lock);
 
 	return ret;
 }
+
+int tegra_dc_ext_set_cursor_batch(struct tegra_dc_ext_user *user,
+				  struct tegra_dc_ext_cursor_update *args)
+{
+	if (args->flags & TEGRA_DC_EXT_CURSOR_UPDATE_IMAGE)
+		return set_cursor_image(user, &args->image, &args->cursor);
+
+	return tegra_dc_ext_set_cursor(user, &args->cursor);
+}
@@ -145,6 +145,7 @@ static void set_enable(struct tegra_dc_ext *ext, bool en)
 	mutex_lock(&ext->cursor.lock);
 
 	ext->enabled = en;
+	tegra_dc_ext_cursor_reset(ext);
 
 	mutex_unlock(&ext->cursor.lock);
 	for (i = ext->dc->n_windows - 1; i >= 0 ; i--)
@@ -728,6 +729,15 @@ static long tegra_dc_ioctl(struct file *filp, unsigned int cmd,
 
 		return tegra_dc_ext_set_cursor(user, &args);
 	}
+	case TEGRA_DC_EXT_SET_CURSOR_BATCH:
+	{
+		struct tegra_dc_ext_cursor_update args;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		return tegra_dc_ext_set_cursor_batch(user, &args);
+	}
 
 	case TEGRA_DC_EXT_SET_CSC:
 	{
@@ -902,6 +912,7 @@ struct tegra_dc_ext *tegra_dc_ext_register(struct nvhost_device *ndev,
 		goto cleanup_nvmap;
 
 	mutex_init(&ext->cursor.lock);
+	spin_lock_init(&ext->cursor.pending_lock);
 
 	head_count++;
 
@@ -23,6 +23,7 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/poll.h>
+#include <linux/spinlock.h>
 
 #include <mach/dc.h>
 #include <mach/nvmap.h>
@@ -60,6 +61,13 @@ struct tegra_dc_ext_win {
 	atomic_t		nr_pending_flips;
 };
 
+/* Cursor state written by ioctls and applied from the vblank worker */
+struct tegra_dc_ext_cursor_pending {
+	bool			dirty;
+	bool			enable;
+	u32			position;
+};
+
 struct tegra_dc_ext {
 	struct tegra_dc			*dc;
 
@@ -74,6 +82,9 @@ struct tegra_dc_ext {
 		struct tegra_dc_ext_user	*user;
 		struct nvmap_handle_ref		*cur_handle;
 		struct mutex			lock;
+
+		spinlock_t			pending_lock;
+		struct tegra_dc_ext_cursor_pending pending;
 	} cursor;
 
 	bool				enabled;
@@ -93,7 +104,8 @@ struct tegra_dc_ext_event_list {
 };
 
 #define TEGRA_DC_EXT_CAPABILITIES \
-	TEGRA_DC_EXT_CAPABILITIES_CURSOR_MODE
+	(TEGRA_DC_EXT_CAPABILITIES_CURSOR_MODE | \
+	 TEGRA_DC_EXT_CAPABILITIES_CURSOR_BATCH)
 
 struct tegra_dc_ext_control_user {
 	struct tegra_dc_ext_control	*control;
@@ -133,6 +145,9 @@ extern int tegra_dc_ext_set_cursor_image(struct tegra_dc_ext_user *user,
 					 struct tegra_dc_ext_cursor_image *);
 extern int tegra_dc_ext_set_cursor(struct tegra_dc_ext_user *user,
 				   struct tegra_dc_ext_cursor *);
+extern int tegra_dc_ext_set_cursor_batch(struct tegra_dc_ext_user *user,
+					 struct tegra_dc_ext_cursor_update *);
+extern void tegra_dc_ext_cursor_reset(struct tegra_dc_ext *ext);
 
 extern int tegra_dc_ext_control_init(void);
 
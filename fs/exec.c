@@ -855,6 +855,8 @@ static int exec_mmap(struct mm_struct *mm)
 		return 0;
 	}
 	mmdrop(active_mm);
+	/* a kernel thread turning into a user process */
+	oom_adj_bucket_add(tsk->signal);
 	return 0;
 }
 
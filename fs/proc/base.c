@@ -1147,6 +1147,8 @@ err_sighand:
 	unlock_task_sighand(task, &flags);
 err_task_lock:
 	task_unlock(task);
+	if (!err)
+		oom_adj_bucket_update(task->signal);
 	put_task_struct(task);
 out:
 	return err < 0 ? err : count;
@@ -1281,6 +1283,8 @@ err_sighand:
 	unlock_task_sighand(task, &flags);
 err_task_lock:
 	task_unlock(task);
+	if (!err)
+		oom_adj_bucket_update(task->signal);
 	put_task_struct(task);
 out:
 	return err < 0 ? err : count;
@@ -66,6 +66,37 @@ static inline void oom_killer_enable(void)
 
 extern struct task_struct *find_lock_task_mm(struct task_struct *p);
 
+#ifdef CONFIG_OOM_ADJ_BUCKETS
+/*
+ * Live thread groups that have an mm, on one list per oom_adj value, so
+ * that a killer picking the highest oom_adj finds its candidates without
+ * walking every process. Protected by oom_adj_lock, under which task_lock()
+ * may be taken; so none of the updates may be called with a task or
+ * sighand lock held.
+ */
+#define OOM_ADJ_BUCKETS		(OOM_ADJUST_MAX - OOM_DISABLE + 1)
+#define oom_adj_bucket(adj)	(&oom_adj_buckets[(adj) - OOM_DISABLE])
+
+extern spinlock_t oom_adj_lock;
+extern struct hlist_head oom_adj_buckets[OOM_ADJ_BUCKETS];
+
+extern void oom_adj_bucket_add(struct signal_struct *sig);
+extern void oom_adj_bucket_update(struct signal_struct *sig);
+extern void oom_adj_bucket_del(struct signal_struct *sig);
+#else
+static inline void oom_adj_bucket_add(struct signal_struct *sig)
+{
+}
+
+static inline void oom_adj_bucket_update(struct signal_struct *sig)
+{
+}
+
+static inline void oom_adj_bucket_del(struct signal_struct *sig)
+{
+}
+#endif
+
 /* sysctls */
 extern int sysctl_oom_dump_tasks;
 extern int sysctl_oom_kill_allocating_task;
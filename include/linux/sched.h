@@ -137,6 +137,9 @@ extern int nr_threads;
 DECLARE_PER_CPU(unsigned long, process_counts);
 extern int nr_processes(void);
 extern unsigned long nr_running(void);
+extern unsigned long avg_nr_running(void);
+extern unsigned long avg_nr_running_cpu(int cpu);
+extern unsigned long nr_latency_sensitive_cpu(int cpu);
 extern unsigned long nr_uninterruptible(void);
 extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
@@ -648,6 +651,9 @@ struct signal_struct {
 	int oom_score_adj;	/* OOM kill score adjustment */
 	int oom_score_adj_min;	/* OOM kill score adjustment minimum value.
 				 * Only settable by CAP_SYS_RESOURCE. */
+#ifdef CONFIG_OOM_ADJ_BUCKETS
+	struct hlist_node oom_adj_node;	/* in oom_adj_buckets[oom_adj] */
+#endif
 
 	struct mutex cred_guard_mutex;	/* guard against foreign influences on
 					 * credential calculations
@@ -1304,6 +1310,8 @@ struct task_struct {
 	/* Revert to default priority/policy when forking */
 	unsigned sched_reset_on_fork:1;
 	unsigned sched_contributes_to_load:1;
+	/* counted in rq nr_latency_sensitive */
+	unsigned sched_latency_queued:1;
 
 	pid_t pid;
 	pid_t tgid;
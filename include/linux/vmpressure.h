@@ -0,0 +1,39 @@
+#ifndef _LINUX_VMPRESSURE_H
+#define _LINUX_VMPRESSURE_H
+
+#include <linux/string.h>
+
+/*
+ * Running totals of global page reclaim, for consumers that want to tell
+ * real memory pressure (reclaim scans a lot and frees little, allocators
+ * stall) apart from memory merely being full of cold page cache.
+ * Totals only ever grow; consumers work on the difference between two
+ * vmpressure_read() snapshots.
+ */
+struct vmpressure_stat {
+	unsigned long scanned;		/* inactive pages looked at */
+	unsigned long reclaimed;	/* of which freed */
+	unsigned long stalls;		/* direct reclaim entries */
+	unsigned long stall_us;		/* time spent in direct reclaim */
+};
+
+#ifdef CONFIG_VMPRESSURE
+extern void vmpressure(unsigned long scanned, unsigned long reclaimed);
+extern void vmpressure_stall(unsigned long us);
+extern void vmpressure_read(struct vmpressure_stat *stat);
+#else
+static inline void vmpressure(unsigned long scanned, unsigned long reclaimed)
+{
+}
+
+static inline void vmpressure_stall(unsigned long us)
+{
+}
+
+static inline void vmpressure_read(struct vmpressure_stat *stat)
+{
+	memset(stat, 0, sizeof(*stat));
+}
+#endif
+
+#endif /* _LINUX_VMPRESSURE_H */
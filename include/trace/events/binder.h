@@ -0,0 +1,103 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM binder
+
+#if !defined(_TRACE_BINDER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BINDER_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(binder_transaction,
+	TP_PROTO(int debug_id, int reply, int from_proc, int from_thread,
+		 int to_proc, int to_thread, int to_node, unsigned int code,
+		 unsigned int flags),
+	TP_ARGS(debug_id, reply, from_proc, from_thread, to_proc, to_thread,
+		to_node, code, flags),
+
+	TP_STRUCT__entry(
+	    __field(         int, debug_id    )
+	    __field(         int, reply       )
+	    __field(         int, from_proc   )
+	    __field(         int, from_thread )
+	    __field(         int, to_proc     )
+	    __field(         int, to_thread   )
+	    __field(         int, to_node     )
+	    __field(unsigned int, code        )
+	    __field(unsigned int, flags       )
+	),
+
+	TP_fast_assign(
+	    __entry->debug_id = debug_id;
+	    __entry->reply = reply;
+	    __entry->from_proc = from_proc;
+	    __entry->from_thread = from_thread;
+	    __entry->to_proc = to_proc;
+	    __entry->to_thread = to_thread;
+	    __entry->to_node = to_node;
+	    __entry->code = code;
+	    __entry->flags = flags;
+	),
+
+	TP_printk("transaction=%d %s from %d:%d to %d:%d node=%d code=%u "
+		  "flags=0x%x",
+		  __entry->debug_id, __entry->reply ? "reply" : "call",
+		  __entry->from_proc, __entry->from_thread,
+		  __entry->to_proc, __entry->to_thread, __entry->to_node,
+		  __entry->code, __entry->flags)
+);
+
+TRACE_EVENT(binder_transaction_received,
+	TP_PROTO(int debug_id, int proc, int thread, unsigned long wait_us),
+	TP_ARGS(debug_id, proc, thread, wait_us),
+
+	TP_STRUCT__entry(
+	    __field(          int, debug_id )
+	    __field(          int, proc     )
+	    __field(          int, thread   )
+	    __field(unsigned long, wait_us  )
+	),
+
+	TP_fast_assign(
+	    __entry->debug_id = debug_id;
+	    __entry->proc = proc;
+	    __entry->thread = thread;
+	    __entry->wait_us = wait_us;
+	),
+
+	TP_printk("transaction=%d by %d:%d wait=%luus",
+		  __entry->debug_id, __entry->proc, __entry->thread,
+		  __entry->wait_us)
+);
+
+TRACE_EVENT(binder_transaction_done,
+	TP_PROTO(int debug_id, int from_proc, int to_node, unsigned int code,
+		 unsigned long wait_us, unsigned long total_us),
+	TP_ARGS(debug_id, from_proc, to_node, code, wait_us, total_us),
+
+	TP_STRUCT__entry(
+	    __field(          int, debug_id  )
+	    __field(          int, from_proc )
+	    __field(          int, to_node   )
+	    __field( unsigned int, code      )
+	    __field(unsigned long, wait_us   )
+	    __field(unsigned long, total_us  )
+	),
+
+	TP_fast_assign(
+	    __entry->debug_id = debug_id;
+	    __entry->from_proc = from_proc;
+	    __entry->to_node = to_node;
+	    __entry->code = code;
+	    __entry->wait_us = wait_us;
+	    __entry->total_us = total_us;
+	),
+
+	TP_printk("transaction=%d from %d node=%d code=%u wait=%luus "
+		  "total=%luus",
+		  __entry->debug_id, __entry->from_proc, __entry->to_node,
+		  __entry->code, __entry->wait_us, __entry->total_us)
+);
+
+#endif /* _TRACE_BINDER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
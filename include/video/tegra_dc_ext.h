@@ -139,6 +139,19 @@ struct tegra_dc_ext_cursor {
 	__u32 flags;
 };
 
+/*
+ * Batched cursor update.  The position and visibility in 'cursor' are latched
+ * and programmed once at the next vblank, so several moves within a frame
+ * cost a single register update.  If TEGRA_DC_EXT_CURSOR_UPDATE_IMAGE is set
+ * in flags, 'image' is applied together with the position in one update.
+ */
+#define TEGRA_DC_EXT_CURSOR_UPDATE_IMAGE	1
+struct tegra_dc_ext_cursor_update {
+	struct tegra_dc_ext_cursor		cursor;
+	struct tegra_dc_ext_cursor_image	image;
+	__u32					flags;
+};
+
 /*
  * Color conversion is performed as follows:
  *
@@ -244,6 +257,9 @@ struct tegra_dc_ext_status {
 #define TEGRA_DC_EXT_SET_LUT \
 	_IOW('D', 0x0A, struct tegra_dc_ext_lut)
 
+#define TEGRA_DC_EXT_SET_CURSOR_BATCH \
+	_IOW('D', 0x0B, struct tegra_dc_ext_cursor_update)
+
 enum tegra_dc_ext_control_output_type {
 	TEGRA_DC_EXT_DSI,
 	TEGRA_DC_EXT_LVDS,
@@ -300,6 +316,7 @@ struct tegra_dc_ext_control_event_hotplug {
 
 
 #define TEGRA_DC_EXT_CAPABILITIES_CURSOR_MODE	(1 << 0)
+#define TEGRA_DC_EXT_CAPABILITIES_CURSOR_BATCH	(1 << 1)
 struct tegra_dc_ext_control_capabilities {
 	__u32 caps;
 	/* Leave some wiggle room for future expansion */
@@ -279,6 +279,9 @@ struct task_group {
 #ifdef CONFIG_SCHED_AUTOGROUP
 	struct autogroup *autogroup;
 #endif
+
+	/* cpufreq hint: runnable tasks of this group want fast response */
+	int latency_sensitive;
 };
 
 /* task_group_lock serializes the addition/removal of task groups */
@@ -472,6 +475,14 @@ struct rq {
 #endif
 	int skip_clock_update;
 
+	/* runnable tasks from latency sensitive task groups */
+	unsigned int nr_latency_sensitive;
+
+	/* time-averaged nr_running, see avg_nr_running() */
+	u64 nr_last_stamp;
+	unsigned int ave_nr_running;
+	seqcount_t ave_seqcnt;
+
 	/* capture load from *all* tasks on this cpu: */
 	struct load_weight load;
 	unsigned long nr_load_updates;
@@ -1756,14 +1767,55 @@ static const struct sched_class rt_sched_class;
 
 #include "sched_stats.h"
 
+/*
+ * Exponentially decaying average of nr_running, kept in FSHIFT fixed
+ * point. The average is folded in whenever nr_running changes, weighted
+ * by the time the previous value was in effect; NR_AVE_PERIOD (~268ms)
+ * is the time constant. Time is rq->clock, which stops while the cpu is
+ * idle with the tick off, so readers project the average to
+ * cpu_clock() instead.
+ */
+#define NR_AVE_PERIOD_EXP	28
+#define NR_AVE_SCALE(x)		((x) << FSHIFT)
+#define NR_AVE_PERIOD		(1 << NR_AVE_PERIOD_EXP)
+#define NR_AVE_DIV_PERIOD(x)	((x) >> NR_AVE_PERIOD_EXP)
+
+static inline unsigned int do_avg_nr_running(struct rq *rq, u64 now)
+{
+	s64 nr, deltax;
+	unsigned int ave_nr_running = rq->ave_nr_running;
+
+	deltax = now - rq->nr_last_stamp;
+	nr = NR_AVE_SCALE(rq->nr_running);
+
+	/* a remote reader's clock may lag the last update a little */
+	if (deltax <= 0)
+		return ave_nr_running;
+	if (deltax > NR_AVE_PERIOD)
+		ave_nr_running = nr;
+	else
+		ave_nr_running +=
+			NR_AVE_DIV_PERIOD(deltax * (nr - ave_nr_running));
+
+	return ave_nr_running;
+}
+
 static void inc_nr_running(struct rq *rq)
 {
+	write_seqcount_begin(&rq->ave_seqcnt);
+	rq->ave_nr_running = do_avg_nr_running(rq, rq->clock);
+	rq->nr_last_stamp = rq->clock;
 	rq->nr_running++;
+	write_seqcount_end(&rq->ave_seqcnt);
 }
 
 static void dec_nr_running(struct rq *rq)
 {
+	write_seqcount_begin(&rq->ave_seqcnt);
+	rq->ave_nr_running = do_avg_nr_running(rq, rq->clock);
+	rq->nr_last_stamp = rq->clock;
 	rq->nr_running--;
+	write_seqcount_end(&rq->ave_seqcnt);
 }
 
 static void set_load_weight(struct task_struct *p)
@@ -1784,11 +1836,36 @@ static void set_load_weight(struct task_struct *p)
 	load->inv_weight = prio_to_wmult[prio];
 }
 
+/*
+ * Group hint is sampled at enqueue, so that dequeue stays balanced even
+ * if the group setting changes while the task is queued.
+ */
+static inline void enqueue_latency_sensitive(struct rq *rq,
+					     struct task_struct *p)
+{
+#ifdef CONFIG_CGROUP_SCHED
+	if (task_group(p)->latency_sensitive) {
+		p->sched_latency_queued = 1;
+		rq->nr_latency_sensitive++;
+	}
+#endif
+}
+
+static inline void dequeue_latency_sensitive(struct rq *rq,
+					     struct task_struct *p)
+{
+	if (p->sched_latency_queued) {
+		p->sched_latency_queued = 0;
+		rq->nr_latency_sensitive--;
+	}
+}
+
 static void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_queued(p);
 	p->sched_class->enqueue_task(rq, p, flags);
+	enqueue_latency_sensitive(rq, p);
 }
 
 static void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
@@ -1796,6 +1873,7 @@ static void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
 	update_rq_clock(rq);
 	sched_info_dequeued(p);
 	p->sched_class->dequeue_task(rq, p, flags);
+	dequeue_latency_sensitive(rq, p);
 }
 
 /*
@@ -2842,6 +2920,7 @@ void sched_fork(struct task_struct *p)
 	int cpu = get_cpu();
 
 	__sched_fork(p);
+	p->sched_latency_queued = 0;
 	/*
 	 * We mark the process as running here. This guarantees that
 	 * nobody will actually run it, and a signal or other external
@@ -3218,6 +3297,51 @@ unsigned long nr_running(void)
 	return sum;
 }
 
+/*
+ * avg_nr_running_cpu, avg_nr_running:
+ *
+ * time-averaged number of runnable threads on one cpu / on all online
+ * cpus, in FSHIFT fixed point (FIXED_1 == one thread). Unlike
+ * nr_running() these do not jump on every wakeup, so they can be used
+ * to size the set of online cores.
+ */
+unsigned long avg_nr_running_cpu(int cpu)
+{
+	struct rq *q = cpu_rq(cpu);
+	unsigned long ave;
+	unsigned int seqcnt;
+	u64 now = cpu_clock(cpu);
+
+	do {
+		seqcnt = read_seqcount_begin(&q->ave_seqcnt);
+		ave = do_avg_nr_running(q, now);
+	} while (read_seqcount_retry(&q->ave_seqcnt, seqcnt));
+
+	return ave;
+}
+
+unsigned long avg_nr_running(void)
+{
+	unsigned long i, sum = 0;
+
+	for_each_online_cpu(i)
+		sum += avg_nr_running_cpu(i);
+
+	return sum;
+}
+
+/*
+ * nr_latency_sensitive_cpu:
+ *
+ * number of runnable tasks on cpu that belong to a task group marked
+ * latency sensitive (cpu.latency_sensitive); a hint for cpufreq governors.
+ */
+unsigned long nr_latency_sensitive_cpu(int cpu)
+{
+	return cpu_rq(cpu)->nr_latency_sensitive;
+}
+EXPORT_SYMBOL_GPL(nr_latency_sensitive_cpu);
+
 unsigned long nr_uninterruptible(void)
 {
 	unsigned long i, sum = 0;
@@ -8085,6 +8209,7 @@ void __init sched_init(void)
 
 		rq = cpu_rq(i);
 		raw_spin_lock_init(&rq->lock);
+		seqcount_init(&rq->ave_seqcnt);
 		rq->nr_running = 0;
 		rq->calc_load_active = 0;
 		rq->calc_load_update = jiffies + LOAD_FREQ;
@@ -9061,6 +9186,19 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+static int cpu_latency_sensitive_write_u64(struct cgroup *cgrp,
+					   struct cftype *cft, u64 val)
+{
+	cgroup_tg(cgrp)->latency_sensitive = !!val;
+	return 0;
+}
+
+static u64 cpu_latency_sensitive_read_u64(struct cgroup *cgrp,
+					  struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->latency_sensitive;
+}
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -9081,6 +9219,11 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_rt_period_write_uint,
 	},
 #endif
+	{
+		.name = "latency_sensitive",
+		.read_u64 = cpu_latency_sensitive_read_u64,
+		.write_u64 = cpu_latency_sensitive_write_u64,
+	},
 };
 
 static int cpu_cgroup_populate(struct cgroup_subsys *ss, struct cgroup *cont)
@@ -130,6 +130,43 @@ struct task_struct *find_lock_task_mm(struct task_struct *p)
 	return NULL;
 }
 
+#ifdef CONFIG_OOM_ADJ_BUCKETS
+DEFINE_SPINLOCK(oom_adj_lock);
+struct hlist_head oom_adj_buckets[OOM_ADJ_BUCKETS];
+
+/* Put a thread group that just got an mm on the list for its oom_adj */
+void oom_adj_bucket_add(struct signal_struct *sig)
+{
+	spin_lock(&oom_adj_lock);
+	hlist_del_init(&sig->oom_adj_node);
+	hlist_add_head(&sig->oom_adj_node, oom_adj_bucket(sig->oom_adj));
+	spin_unlock(&oom_adj_lock);
+}
+
+/*
+ * Move a thread group to the list for its new oom_adj; one that exited
+ * since its oom_adj was written stays off the lists.
+ */
+void oom_adj_bucket_update(struct signal_struct *sig)
+{
+	spin_lock(&oom_adj_lock);
+	if (!hlist_unhashed(&sig->oom_adj_node)) {
+		hlist_del(&sig->oom_adj_node);
+		hlist_add_head(&sig->oom_adj_node,
+			       oom_adj_bucket(sig->oom_adj));
+	}
+	spin_unlock(&oom_adj_lock);
+}
+
+/* Take a thread group whose last thread is exiting off the lists */
+void oom_adj_bucket_del(struct signal_struct *sig)
+{
+	spin_lock(&oom_adj_lock);
+	hlist_del_init(&sig->oom_adj_node);
+	spin_unlock(&oom_adj_lock);
+}
+#endif
+
 /* return true if the task is not adequate as candidate victim task. */
 static bool oom_unkillable_task(struct task_struct *p,
 		const struct mem_cgroup *mem, const nodemask_t *nodemask)
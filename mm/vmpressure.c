@@ -0,0 +1,46 @@
+/*
+ * Global reclaim efficiency and direct reclaim stall accounting
+ *
+ * vmscan reports every pass over a zone's inactive lists and every
+ * direct reclaim it runs; the totals are kept per cpu so that concurrent
+ * reclaimers never share a cache line, and summed only when read.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.
+ */
+
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+#include <linux/vmpressure.h>
+
+static DEFINE_PER_CPU(struct vmpressure_stat, vmpressure_stats);
+
+void vmpressure(unsigned long scanned, unsigned long reclaimed)
+{
+	if (!scanned)
+		return;
+	this_cpu_add(vmpressure_stats.scanned, scanned);
+	this_cpu_add(vmpressure_stats.reclaimed, reclaimed);
+}
+
+void vmpressure_stall(unsigned long us)
+{
+	this_cpu_inc(vmpressure_stats.stalls);
+	this_cpu_add(vmpressure_stats.stall_us, us);
+}
+
+/* Not atomic across cpus: a sum may be missing a concurrent update */
+void vmpressure_read(struct vmpressure_stat *stat)
+{
+	int cpu;
+
+	memset(stat, 0, sizeof(*stat));
+	for_each_possible_cpu(cpu) {
+		struct vmpressure_stat *s = &per_cpu(vmpressure_stats, cpu);
+
+		stat->scanned += s->scanned;
+		stat->reclaimed += s->reclaimed;
+		stat->stalls += s->stalls;
+		stat->stall_us += s->stall_us;
+	}
+}
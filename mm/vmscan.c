@@ -43,6 +43,8 @@
 #include <linux/sysctl.h>
 #include <linux/oom.h>
 #include <linux/prefetch.h>
+#include <linux/ktime.h>
+#include <linux/vmpressure.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -2013,6 +2015,8 @@ restart:
 			break;
 	}
 	sc->nr_reclaimed += nr_reclaimed;
+	if (scanning_global_lru(sc))
+		vmpressure(sc->nr_scanned - nr_scanned, nr_reclaimed);
 
 	/*
 	 * Even if we did not try to evict anon pages at all, we want to
@@ -2223,6 +2227,7 @@ unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 				gfp_t gfp_mask, nodemask_t *nodemask)
 {
 	unsigned long nr_reclaimed;
+	ktime_t start;
 	struct scan_control sc = {
 		.gfp_mask = gfp_mask,
 		.may_writepage = !laptop_mode,
@@ -2241,7 +2246,9 @@ unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 				sc.may_writepage,
 				gfp_mask);
 
+	start = ktime_get();
 	nr_reclaimed = do_try_to_free_pages(zonelist, &sc, &shrink);
+	vmpressure_stall(ktime_to_us(ktime_sub(ktime_get(), start)));
 
 	trace_mm_vmscan_direct_reclaim_end(nr_reclaimed);
 
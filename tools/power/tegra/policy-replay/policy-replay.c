@@ -0,0 +1,699 @@
+/*
+ * policy-replay.c: replay a recorded load trace through the interactive
+ * cpufreq governor and Tegra3 auto-hotplug policies on the host.
+ *
+ * The frequency and hotplug decisions are the ones the kernel runs,
+ * included from drivers/cpufreq/cpufreq_interactive_policy.h and
+ * arch/arm/mach-tegra/cpu-tegra3-policy.h. What is simulated here is the
+ * machinery around them: sampling timers, the shared cpu clock, hotplug
+ * work delays, LP/G cluster switching, a simple scheduler and a power
+ * model, so that policy changes can be compared on the same trace.
+ *
+ * Trace format, one record per line, times in us, '#' starts a comment:
+ *
+ *   freqs <khz> <khz> ...		cpufreq table, ascending (required)
+ *   volts <mv> <mv> ...		cpu rail voltage per table entry
+ *   lp_max <khz>			LP cluster top rate
+ *   g_min <khz>			G cluster bottom rate
+ *   <t> work <thread> <kcycles>	work queued on a thread
+ *   <t> busy <thread> <us> <khz>	recorded busy period, run at <khz>
+ *   <t> input				touch/key input event
+ *
+ * Threads are numbered 0-31; the simulated scheduler spreads runnable
+ * threads over the on-line cores.
+ *
+ * Output: one timeline line per change of rate, core count or cluster,
+ * followed by a summary with the energy estimate and work latency.
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+typedef uint64_t u64;
+#define POLICY_DIV64(a, b)	((a) / (b))
+
+#include "cpufreq_interactive_policy.h"
+#include "cpu-tegra3-policy.h"
+
+#define NR_CPUS		4
+#define NR_THREADS	32
+#define MAX_FREQS	32
+#define MAX_EVENTS	(1 << 20)
+#define MAX_PENDING	4096		/* queued jobs per thread */
+#define MAX_LATENCY	(1 << 20)
+#define FSHIFT		TEGRA_HP_FSHIFT
+#define NR_AVE_PERIOD	(1 << 28)	/* ns, as kernel/sched.c */
+
+enum { EV_WORK, EV_INPUT };
+
+struct event {
+	u64 t;
+	int type;
+	int thread;
+	u64 cycles;
+};
+
+struct job {
+	u64 arrival;
+	u64 cycles;
+};
+
+static struct event events[MAX_EVENTS];
+static int nr_events;
+
+static unsigned int freqs[MAX_FREQS];
+static unsigned int volts[MAX_FREQS];
+static int nr_freqs;
+static unsigned int lp_max, g_min;
+
+/* tunables, kernel defaults */
+static struct cpufreq_interactive_tunables gov = {
+	.go_maxspeed_load = 85,
+	.go_hispeed_load = 85,
+	.above_hispeed_delay = 20000,
+	.min_sample_time = 30000,
+};
+static unsigned long timer_rate = 20000;
+static unsigned int input_boost_freq;
+static unsigned long input_boost_hold = 200000;
+static unsigned long input_boost_decay = 300000;
+static unsigned int input_boost_cores = 2;
+
+static unsigned int nr_run_thresholds[] = { 5, 9, 13, UINT32_MAX };
+static struct tegra_hp_policy hp = {
+	.balance_level = 75,
+	.nr_run_thresholds = nr_run_thresholds,
+	.nr_run_levels = 4,
+	.nr_run_hysteresis = 2,
+};
+static bool rq_balance = true;
+static bool no_lp;
+static unsigned long up2g0_delay = 70000;
+static unsigned long up2gn_delay = 100000;
+static unsigned long down_delay = 2000000;
+
+/* power model, defaults as arch/arm/mach-tegra/power-model.h */
+static unsigned int g_ceff = 300, lp_ceff = 250;	/* pF per core */
+static unsigned int g_leak = 60, lp_leak = 5;		/* mA per core */
+
+static unsigned long step_us = 1000;
+static bool quiet;
+
+/* simulation state */
+static struct {
+	bool online;
+	unsigned int target;
+	unsigned int floor_freq;
+	u64 floor_validate_time;
+	u64 freq_change_time;
+	u64 busy_us, busy_since_change;
+	u64 sample_start;
+	u64 next_sample;
+} cpu[NR_CPUS];
+
+static struct {
+	struct job *jobs;
+	int head, tail;
+} thread[NR_THREADS];
+
+static unsigned int cur_freq;
+static bool lp;
+static int hp_state = TEGRA_HP_IDLE;
+static u64 hp_work_time = ~0ULL;
+static u64 last_change_time;
+static u64 last_input = ~0ULL;
+static unsigned int nr_run_last;
+static double avg_nr_run;
+
+static double energy_nj;
+static u64 *latency;
+static unsigned long nr_latency;
+static unsigned long nr_switches, nr_hotplug;
+
+static void __attribute__((noreturn)) die(const char *msg)
+{
+	fprintf(stderr, "policy-replay: %s\n", msg);
+	exit(1);
+}
+
+static unsigned int freq_round(unsigned int khz, unsigned int max)
+{
+	unsigned int f = freqs[0];
+	int i;
+
+	/* CPUFREQ_RELATION_H: highest rate at or below the target */
+	for (i = 0; i < nr_freqs; i++)
+		if (freqs[i] <= khz && freqs[i] <= max)
+			f = freqs[i];
+	return f;
+}
+
+static unsigned int freq_volt(unsigned int khz)
+{
+	int i;
+
+	for (i = 0; i < nr_freqs; i++)
+		if (freqs[i] >= khz)
+			return volts[i];
+	return volts[nr_freqs - 1];
+}
+
+static unsigned int cluster_max(void)
+{
+	return lp ? lp_max : freqs[nr_freqs - 1];
+}
+
+static unsigned int nr_online(void)
+{
+	unsigned int n = 0;
+	int i;
+
+	for (i = 0; i < NR_CPUS; i++)
+		n += cpu[i].online;
+	return n;
+}
+
+static void timeline(u64 now)
+{
+	static unsigned int last_freq, last_cpus;
+	static bool last_lp = true;
+	unsigned int n = nr_online();
+
+	if (quiet || (cur_freq == last_freq && n == last_cpus &&
+		      lp == last_lp))
+		return;
+	printf("%llu freq %u cpus %u cluster %s\n", (unsigned long long)now,
+	       cur_freq, n, lp ? "LP" : "G");
+	last_freq = cur_freq;
+	last_cpus = n;
+	last_lp = lp;
+}
+
+static unsigned int min_cpus(u64 now)
+{
+	if (last_input != ~0ULL && now - last_input < input_boost_hold)
+		return input_boost_cores;
+	return 0;
+}
+
+static void hp_queue(u64 now, unsigned long delay)
+{
+	hp_work_time = now + delay;
+}
+
+/* tegra_auto_hotplug_governor() */
+static void hp_governor(u64 now)
+{
+	unsigned long top, bottom, up_delay;
+	int state;
+
+	if (lp) {
+		up_delay = up2g0_delay;
+		top = lp_max;
+		bottom = 0;
+	} else {
+		up_delay = up2gn_delay;
+		top = g_min;
+		bottom = top;
+	}
+
+	if (min_cpus(now) >= 2) {
+		if (hp_state != TEGRA_HP_UP) {
+			hp_state = TEGRA_HP_UP;
+			hp_queue(now, up_delay);
+		}
+		return;
+	}
+
+	state = tegra_hp_next_state(hp_state, cur_freq, top, bottom);
+	if (state == hp_state)
+		return;
+	hp_state = state;
+	if (state == TEGRA_HP_UP)
+		hp_queue(now, up_delay);
+	else if (state == TEGRA_HP_DOWN)
+		hp_queue(now, down_delay);
+}
+
+/* tegra_cpu_set_speed_cap(): the cluster runs at the highest target */
+static void set_speed(u64 now)
+{
+	unsigned int f = 0;
+	int i;
+
+	for (i = 0; i < NR_CPUS; i++)
+		if (cpu[i].online && cpu[i].target > f)
+			f = cpu[i].target;
+	f = freq_round(f ? f : freqs[0], cluster_max());
+	if (!lp && f < g_min)
+		f = g_min;	/* G cannot run below its minimum rate */
+	if (f != cur_freq) {
+		cur_freq = f;
+		for (i = 0; i < NR_CPUS; i++) {
+			cpu[i].freq_change_time = now;
+			cpu[i].busy_since_change = 0;
+		}
+	}
+	hp_governor(now);
+	timeline(now);
+}
+
+static int slowest_cpu(void)
+{
+	int i, n = -1;
+
+	for (i = 1; i < NR_CPUS; i++)
+		if (cpu[i].online && (n < 0 || cpu[i].target <= cpu[n].target))
+			n = i;
+	return n;
+}
+
+static void cpu_set_online(u64 now, int n, bool up)
+{
+	cpu[n].online = up;
+	cpu[n].target = up ? cur_freq : 0;
+	cpu[n].sample_start = now;
+	cpu[n].next_sample = now + timer_rate;
+	cpu[n].busy_us = 0;
+	cpu[n].busy_since_change = 0;
+	cpu[n].freq_change_time = now;
+	last_change_time = now;
+	nr_hotplug++;
+}
+
+/* tegra_auto_hotplug_work_func(), without core parking */
+static void hp_work(u64 now)
+{
+	struct tegra_hp_sample s;
+	unsigned long highest = 0;
+	int i, n = -1;
+	bool up = false;
+
+	hp_work_time = ~0ULL;
+
+	switch (hp_state) {
+	case TEGRA_HP_DOWN:
+		n = slowest_cpu();
+		if (n < 0 && !lp && !no_lp && !min_cpus(now)) {
+			lp = true;
+			nr_switches++;
+			set_speed(now);
+			return;
+		}
+		hp_queue(now, down_delay);
+		break;
+	case TEGRA_HP_UP:
+		if (lp && !no_lp) {
+			lp = false;
+			nr_switches++;
+			set_speed(now);
+		} else {
+			memset(&s, 0, sizeof(s));
+			for (i = 0; i < NR_CPUS; i++)
+				if (cpu[i].online && cpu[i].target > highest)
+					highest = cpu[i].target;
+			s.highest_speed = highest;
+			s.nr_cpus = nr_online();
+			s.max_cpus = NR_CPUS;
+			s.min_cpus = min_cpus(now);
+			for (i = 0; i < NR_CPUS; i++) {
+				if (!cpu[i].online)
+					continue;
+				if (cpu[i].target <=
+				    tegra_hp_balanced_speed(&hp, highest))
+					s.slow_balanced++;
+				if (cpu[i].target <=
+				    tegra_hp_skewed_speed(&hp, highest))
+					s.slow_skewed++;
+			}
+			s.edp_favor_up = true;
+			s.nr_run = tegra_hp_nr_run_target(&hp, avg_nr_run,
+							  &nr_run_last);
+			switch (rq_balance ? tegra_hp_nr_run_balance(&hp, &s) :
+					     tegra_hp_speed_balance(&hp, &s)) {
+			case TEGRA_CPU_SPEED_BALANCED:
+				for (i = 1; i < NR_CPUS; i++)
+					if (!cpu[i].online)
+						break;
+				if (i < NR_CPUS) {
+					n = i;
+					up = true;
+				}
+				break;
+			case TEGRA_CPU_SPEED_SKEWED:
+				n = slowest_cpu();
+				break;
+			}
+		}
+		hp_queue(now, (up && nr_online() + 1 < min_cpus(now)) ?
+			 0 : up2gn_delay);
+		break;
+	}
+
+	if (!up && now - last_change_time < down_delay)
+		n = -1;
+	if (n > 0) {
+		cpu_set_online(now, n, up);
+		set_speed(now);
+	}
+}
+
+/* cpufreq_interactive_timer() for one cpu */
+static void gov_sample(u64 now, int n)
+{
+	struct cpufreq_interactive_sample s;
+	u64 elapsed = now - cpu[n].sample_start;
+	u64 since_change = now - cpu[n].freq_change_time;
+	unsigned int f, floor = 0;
+	bool notyet;
+
+	if (input_boost_hold + input_boost_decay && last_input != ~0ULL)
+		floor = cpufreq_interactive_policy_input_floor(
+			input_boost_freq ? : gov.hispeed_freq,
+			now - last_input, input_boost_hold, input_boost_decay);
+
+	memset(&s, 0, sizeof(s));
+	s.load = elapsed ? 100 * cpu[n].busy_us / elapsed : 0;
+	s.load_since_change = since_change ?
+		100 * cpu[n].busy_since_change / since_change : 0;
+	s.cur = cur_freq;
+	s.min = freqs[0];
+	s.max = cluster_max();
+	s.target = cpu[n].target;
+	s.now = now;
+	s.freq_change_time = cpu[n].freq_change_time;
+	s.floor = floor;
+
+	f = freq_round(cpufreq_interactive_policy_target(&gov, &s, &notyet),
+		       s.max);
+
+	cpu[n].busy_us = 0;
+	cpu[n].sample_start = now;
+	cpu[n].next_sample = now + timer_rate;
+
+	if (cpufreq_interactive_policy_hold(&gov, f, cpu[n].floor_freq, now,
+					    cpu[n].floor_validate_time))
+		return;
+	cpu[n].floor_freq = f;
+	cpu[n].floor_validate_time = now;
+
+	if (f != cpu[n].target) {
+		cpu[n].target = f;
+		set_speed(now);
+	}
+}
+
+static bool thread_runnable(int t)
+{
+	return thread[t].head != thread[t].tail;
+}
+
+static void thread_push(int t, u64 now, u64 cycles)
+{
+	int next = (thread[t].tail + 1) % MAX_PENDING;
+
+	if (next == thread[t].head)
+		die("too many pending jobs");
+	thread[t].jobs[thread[t].tail].arrival = now;
+	thread[t].jobs[thread[t].tail].cycles = cycles;
+	thread[t].tail = next;
+}
+
+/* Run @cycles of thread @t; returns the cycles actually used */
+static u64 thread_run(int t, u64 now, u64 cycles)
+{
+	u64 used = 0;
+
+	while (cycles && thread_runnable(t)) {
+		struct job *j = &thread[t].jobs[thread[t].head];
+		u64 c = j->cycles < cycles ? j->cycles : cycles;
+
+		j->cycles -= c;
+		cycles -= c;
+		used += c;
+		if (!j->cycles) {
+			latency[nr_latency++ % MAX_LATENCY] = now - j->arrival;
+			thread[t].head = (thread[t].head + 1) % MAX_PENDING;
+		}
+	}
+	return used;
+}
+
+/* One scheduler step: runnable threads share the on-line cores equally */
+static void sched_step(u64 now)
+{
+	u64 cap = (u64)cur_freq * step_us / 1000;	/* cycles per core */
+	int runnable[NR_THREADS], nr = 0, online[NR_CPUS], nc = 0;
+	unsigned int mv = freq_volt(cur_freq);
+	double ceff = lp ? lp_ceff : g_ceff, leak = lp ? lp_leak : g_leak;
+	int i;
+
+	for (i = 0; i < NR_THREADS; i++)
+		if (thread_runnable(i))
+			runnable[nr++] = i;
+	for (i = 0; i < NR_CPUS; i++)
+		if (cpu[i].online)
+			online[nc++] = i;
+
+	/* avg_nr_running(): exponential average over NR_AVE_PERIOD */
+	avg_nr_run += ((double)((unsigned long)nr << FSHIFT) - avg_nr_run) *
+		(step_us * 1000.0 / NR_AVE_PERIOD);
+
+	for (i = 0; i < nc; i++) {
+		/* threads i, i + nc, i + 2 * nc, ... share core online[i] */
+		int k, shared = i < nr ? (nr - i + nc - 1) / nc : 0;
+		u64 used = 0;
+
+		for (k = i; k < nr; k += nc)
+			used += thread_run(runnable[k], now, cap / shared);
+
+		cpu[online[i]].busy_us += used * step_us / (cap ? cap : 1);
+		cpu[online[i]].busy_since_change +=
+			used * step_us / (cap ? cap : 1);
+
+		/* busy: ceff * V^2 * f, leak * V while on-line and busy */
+		energy_nj += (ceff * mv * mv * (cur_freq / 1000.0) / 1e9 +
+			      leak * mv / 1000.0) *
+			((double)used / (cap ? cap : 1)) * step_us;
+	}
+}
+
+static void parse_trace(FILE *f)
+{
+	char line[1024];
+	int i;
+
+	while (fgets(line, sizeof(line), f)) {
+		char *p = strchr(line, '#'), *tok, *end;
+		unsigned long long t;
+		struct event *e;
+
+		if (p)
+			*p = 0;
+		tok = strtok(line, " \t\n");
+		if (!tok)
+			continue;
+
+		if (!strcmp(tok, "freqs") || !strcmp(tok, "volts")) {
+			unsigned int *a = tok[0] == 'f' ? freqs : volts;
+
+			for (i = 0; (tok = strtok(NULL, " \t\n")) &&
+			     i < MAX_FREQS; i++)
+				a[i] = strtoul(tok, NULL, 0);
+			if (a == freqs)
+				nr_freqs = i;
+			continue;
+		}
+		if (!strcmp(tok, "lp_max") || !strcmp(tok, "g_min")) {
+			unsigned int *v = tok[0] == 'l' ? &lp_max : &g_min;
+
+			tok = strtok(NULL, " \t\n");
+			*v = tok ? strtoul(tok, NULL, 0) : 0;
+			continue;
+		}
+
+		t = strtoull(tok, &end, 0);
+		if (*end || !(tok = strtok(NULL, " \t\n")))
+			die("bad trace record");
+		if (nr_events == MAX_EVENTS)
+			die("trace too long");
+		e = &events[nr_events++];
+		e->t = t;
+		if (!strcmp(tok, "input")) {
+			e->type = EV_INPUT;
+		} else if (!strcmp(tok, "work") || !strcmp(tok, "busy")) {
+			char *a = strtok(NULL, " \t\n");
+			char *b = strtok(NULL, " \t\n");
+			char *c = strtok(NULL, " \t\n");
+
+			if (!a || !b)
+				die("bad work record");
+			e->type = EV_WORK;
+			e->thread = atoi(a) % NR_THREADS;
+			if (tok[0] == 'w')
+				e->cycles = strtoull(b, NULL, 0) * 1000;
+			else
+				e->cycles = strtoull(b, NULL, 0) *
+					(c ? strtoull(c, NULL, 0) : 1000000) /
+					1000;
+		} else {
+			die("unknown trace record");
+		}
+	}
+
+	if (!nr_freqs)
+		die("no frequency table in trace");
+	for (i = 0; i < nr_freqs; i++)
+		if (!volts[i])
+			volts[i] = 800 + 400 * i / (nr_freqs > 1 ?
+						    nr_freqs - 1 : 1);
+	if (!lp_max)
+		lp_max = freqs[nr_freqs / 3];
+	if (!g_min)
+		g_min = freqs[nr_freqs / 4];
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void set_tunable(char *arg)
+{
+	char *v = strchr(arg, '=');
+	unsigned long val;
+
+	if (!v)
+		die("tunables are name=value");
+	*v++ = 0;
+	val = strtoul(v, NULL, 0);
+
+#define TUNABLE(name, var) if (!strcmp(arg, name)) { var = val; return; }
+	TUNABLE("go_hispeed_load", gov.go_hispeed_load);
+	TUNABLE("go_maxspeed_load", gov.go_maxspeed_load);
+	TUNABLE("boost_factor", gov.boost_factor);
+	TUNABLE("max_boost", gov.max_boost);
+	TUNABLE("sustain_load", gov.sustain_load);
+	TUNABLE("above_hispeed_delay", gov.above_hispeed_delay);
+	TUNABLE("min_sample_time", gov.min_sample_time);
+	TUNABLE("hispeed_freq", gov.hispeed_freq);
+	TUNABLE("timer_rate", timer_rate);
+	TUNABLE("input_boost_freq", input_boost_freq);
+	TUNABLE("input_boost_hold", input_boost_hold);
+	TUNABLE("input_boost_decay", input_boost_decay);
+	TUNABLE("input_boost_cores", input_boost_cores);
+	TUNABLE("balance_level", hp.balance_level);
+	TUNABLE("nr_run_hysteresis", hp.nr_run_hysteresis);
+	TUNABLE("rq_balance", rq_balance);
+	TUNABLE("no_lp", no_lp);
+	TUNABLE("up2g0_delay", up2g0_delay);
+	TUNABLE("up2gn_delay", up2gn_delay);
+	TUNABLE("down_delay", down_delay);
+	TUNABLE("g_ceff", g_ceff);
+	TUNABLE("lp_ceff", lp_ceff);
+	TUNABLE("g_leak", g_leak);
+	TUNABLE("lp_leak", lp_leak);
+	TUNABLE("step", step_us);
+#undef TUNABLE
+	die("unknown tunable");
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: policy-replay [-q] [-t name=value]... "
+		"[trace]\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *f = stdin;
+	u64 now, end;
+	int i, ev = 0, opt;
+
+	while ((opt = getopt(argc, argv, "qt:")) != -1) {
+		switch (opt) {
+		case 'q':
+			quiet = true;
+			break;
+		case 't':
+			set_tunable(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind < argc && !(f = fopen(argv[optind], "r")))
+		die("cannot open trace");
+
+	parse_trace(f);
+	if (!nr_events)
+		die("empty trace");
+
+	latency = calloc(MAX_LATENCY, sizeof(*latency));
+	for (i = 0; i < NR_THREADS; i++)
+		thread[i].jobs = calloc(MAX_PENDING, sizeof(struct job));
+	if (!gov.hispeed_freq)
+		gov.hispeed_freq = freqs[nr_freqs - 1];
+
+	/* boot: LP cluster, one core */
+	lp = !no_lp;
+	cpu[0].online = true;
+	cpu[0].next_sample = timer_rate;
+	cur_freq = freq_round(cluster_max(), cluster_max());
+	cpu[0].target = cur_freq;
+	timeline(0);
+
+	end = events[nr_events - 1].t + down_delay * 2;
+	for (now = 0; now < end; now += step_us) {
+		for (; ev < nr_events && events[ev].t <= now; ev++) {
+			if (events[ev].type == EV_INPUT) {
+				last_input = now;
+				hp_governor(now);
+			} else {
+				thread_push(events[ev].thread, now,
+					    events[ev].cycles);
+			}
+		}
+
+		sched_step(now);
+
+		for (i = 0; i < NR_CPUS; i++)
+			if (cpu[i].online && now >= cpu[i].next_sample)
+				gov_sample(now, i);
+
+		if (now >= hp_work_time)
+			hp_work(now);
+	}
+
+	if (nr_latency > MAX_LATENCY)
+		nr_latency = MAX_LATENCY;
+	qsort(latency, nr_latency, sizeof(*latency), cmp_u64);
+	printf("duration_ms %llu\n", (unsigned long long)end / 1000);
+	printf("energy_mj %.1f\n", energy_nj / 1e6);
+	printf("jobs %lu\n", nr_latency);
+	if (nr_latency) {
+		printf("latency_p50_ms %.2f\n",
+			latency[nr_latency / 2] / 1000.0);
+		printf("latency_p95_ms %.2f\n",
+			latency[nr_latency * 95 / 100] / 1000.0);
+		printf("latency_max_ms %.2f\n",
+			latency[nr_latency - 1] / 1000.0);
+	}
+	printf("cluster_switches %lu\n", nr_switches);
+	printf("hotplug_events %lu\n", nr_hotplug);
+
+	return 0;
+}
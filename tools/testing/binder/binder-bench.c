@@ -0,0 +1,732 @@
+/*
+ * binder-bench.c: binder IPC throughput and latency benchmark
+ *
+ * Talks to /dev/binder with raw ioctls, so it needs no libbinder and no
+ * servicemanager. The benchmark makes itself the context manager and runs
+ * a tiny registry there, so it has to run with the Android runtime stopped
+ * (adb shell stop) or on a plain rootfs.
+ *
+ * Modes:
+ *
+ *   pingpong	<clients> independent client/server process pairs, every
+ *		client calling only its own server. With a global driver
+ *		lock the pairs serialize; with per-proc locking they scale
+ *		with the number of cores.
+ *
+ *   fanout	<clients> client processes calling one server process that
+ *		runs <threads> looper threads.
+ *
+ * Every call carries <size> bytes each way, inline in the parcel or, with
+ * -g, as one BINDER_TYPE_PTR segment gathered by BC_TRANSACTION_SG. The
+ * report has the call rate per client and in total, and the mean and max
+ * round trip latency.
+ *
+ * Copyright (C) 2012 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "binder.h"
+
+#define BINDER_DEV		"/dev/binder"
+#define BINDER_MAP_SIZE		(1024 * 1024)
+
+#define MAX_CLIENTS		64
+#define MAX_THREADS		16
+
+/* registry calls on handle 0 */
+#define REG_ADD			1	/* u32 index, flat_binder_object */
+#define REG_GET			2	/* u32 index -> flat_binder_object */
+
+/* benchmark call on a server */
+#define BENCH_PING		1
+
+struct bio {
+	int fd;
+	void *map;
+};
+
+struct result {
+	uint64_t calls;
+	uint64_t ns;
+	uint64_t lat_sum_ns;
+	uint64_t lat_max_ns;
+};
+
+static int verbose;
+static int gather;
+
+#define ALIGN_PTR(x)	(((x) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void die(const char *what)
+{
+	fprintf(stderr, "binder-bench[%d]: %s: %s\n", getpid(), what,
+		strerror(errno));
+	exit(1);
+}
+
+static void bio_open(struct bio *b)
+{
+	struct binder_version vers;
+
+	b->fd = open(BINDER_DEV, O_RDWR);
+	if (b->fd < 0)
+		die("open " BINDER_DEV);
+	if (ioctl(b->fd, BINDER_VERSION, &vers) < 0)
+		die("BINDER_VERSION");
+	if (vers.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "binder-bench: protocol %ld, expected %d\n",
+			vers.protocol_version, BINDER_CURRENT_PROTOCOL_VERSION);
+		exit(1);
+	}
+	b->map = mmap(NULL, BINDER_MAP_SIZE, PROT_READ, MAP_PRIVATE,
+		      b->fd, 0);
+	if (b->map == MAP_FAILED)
+		die("mmap");
+}
+
+static int bio_write_read(struct bio *b, void *wbuf, size_t wsize,
+			  void *rbuf, size_t rsize, size_t *rdone)
+{
+	struct binder_write_read bwr;
+	int ret;
+
+	bwr.write_buffer = (unsigned long)wbuf;
+	bwr.write_size = wsize;
+	bwr.write_consumed = 0;
+	bwr.read_buffer = (unsigned long)rbuf;
+	bwr.read_size = rsize;
+	bwr.read_consumed = 0;
+
+	do {
+		ret = ioctl(b->fd, BINDER_WRITE_READ, &bwr);
+	} while (ret < 0 && errno == EINTR);
+
+	if (rdone)
+		*rdone = bwr.read_consumed;
+	return ret;
+}
+
+static void bio_write(struct bio *b, void *wbuf, size_t wsize)
+{
+	if (bio_write_read(b, wbuf, wsize, NULL, 0, NULL) < 0)
+		die("BINDER_WRITE_READ write");
+}
+
+/* Write buffer assembly */
+struct wbuf {
+	uint8_t data[256];
+	size_t len;
+};
+
+static void wbuf_u32(struct wbuf *w, uint32_t v)
+{
+	memcpy(w->data + w->len, &v, sizeof(v));
+	w->len += sizeof(v);
+}
+
+static void wbuf_ptr(struct wbuf *w, const void *p)
+{
+	memcpy(w->data + w->len, &p, sizeof(p));
+	w->len += sizeof(p);
+}
+
+/* BC_TRANSACTION or BC_REPLY, or their _SG forms if buffers_size is set */
+static void wbuf_txn(struct wbuf *w, int reply, size_t handle,
+		     uint32_t code, const void *data, size_t data_size,
+		     const size_t *offs, size_t offs_size, size_t buffers_size)
+{
+	struct binder_transaction_data_sg sg;
+	struct binder_transaction_data *tr = &sg.transaction_data;
+
+	memset(&sg, 0, sizeof(sg));
+	tr->target.handle = handle;
+	tr->code = code;
+	tr->data_size = data_size;
+	tr->offsets_size = offs_size;
+	tr->data.ptr.buffer = data;
+	tr->data.ptr.offsets = offs;
+	sg.buffers_size = buffers_size;
+
+	if (buffers_size) {
+		wbuf_u32(w, reply ? BC_REPLY_SG : BC_TRANSACTION_SG);
+		memcpy(w->data + w->len, &sg, sizeof(sg));
+		w->len += sizeof(sg);
+	} else {
+		wbuf_u32(w, reply ? BC_REPLY : BC_TRANSACTION);
+		memcpy(w->data + w->len, tr, sizeof(*tr));
+		w->len += sizeof(*tr);
+	}
+}
+
+static void wbuf_ref_done(struct wbuf *w, uint32_t cmd, uint8_t **p)
+{
+	struct binder_ptr_cookie pc;
+
+	memcpy(&pc, *p, sizeof(pc));
+	*p += sizeof(pc);
+	wbuf_u32(w, cmd);
+	memcpy(w->data + w->len, &pc, sizeof(pc));
+	w->len += sizeof(pc);
+}
+
+/*
+ * Parse a read buffer. Acknowledges strong and weak ref requests on our
+ * nodes (into *ack) and stops at the first BR_TRANSACTION or BR_REPLY,
+ * which is copied to *tr. Returns that command, or 0 if there was none.
+ */
+static uint32_t bio_parse(uint8_t *p, uint8_t *end, struct wbuf *ack,
+			  struct binder_transaction_data *tr)
+{
+	while (p < end) {
+		uint32_t cmd;
+
+		memcpy(&cmd, p, sizeof(cmd));
+		p += sizeof(cmd);
+
+		switch (cmd) {
+		case BR_NOOP:
+		case BR_TRANSACTION_COMPLETE:
+		case BR_SPAWN_LOOPER:
+			break;
+		case BR_INCREFS:
+			wbuf_ref_done(ack, BC_INCREFS_DONE, &p);
+			break;
+		case BR_ACQUIRE:
+			wbuf_ref_done(ack, BC_ACQUIRE_DONE, &p);
+			break;
+		case BR_RELEASE:
+		case BR_DECREFS:
+			p += sizeof(struct binder_ptr_cookie);
+			break;
+		case BR_TRANSACTION:
+		case BR_REPLY:
+			memcpy(tr, p, sizeof(*tr));
+			return cmd;
+		case BR_DEAD_REPLY:
+		case BR_FAILED_REPLY:
+			fprintf(stderr, "binder-bench[%d]: call failed (%s)\n",
+				getpid(), cmd == BR_DEAD_REPLY ?
+				"dead reply" : "failed reply");
+			exit(1);
+		default:
+			fprintf(stderr, "binder-bench[%d]: unexpected return "
+				"%08x\n", getpid(), cmd);
+			exit(1);
+		}
+	}
+	return 0;
+}
+
+/* Call handle and wait for the reply; the reply buffer is left to free */
+static void bio_call(struct bio *b, size_t handle, uint32_t code,
+		     const void *data, size_t data_size,
+		     const size_t *offs, size_t offs_size, size_t buffers_size,
+		     const void *free_buf, struct binder_transaction_data *reply)
+{
+	uint32_t rbuf[64];
+	struct wbuf w = { .len = 0 };
+
+	if (free_buf) {
+		wbuf_u32(&w, BC_FREE_BUFFER);
+		wbuf_ptr(&w, free_buf);
+	}
+	wbuf_txn(&w, 0, handle, code, data, data_size, offs, offs_size,
+		 buffers_size);
+
+	for (;;) {
+		struct wbuf ack = { .len = 0 };
+		size_t done;
+		uint32_t cmd;
+
+		if (bio_write_read(b, w.data, w.len, rbuf, sizeof(rbuf),
+				   &done) < 0)
+			die("BINDER_WRITE_READ call");
+		w.len = 0;
+
+		cmd = bio_parse((uint8_t *)rbuf, (uint8_t *)rbuf + done, &ack,
+				reply);
+		if (ack.len)
+			bio_write(b, ack.data, ack.len);
+		if (cmd == BR_REPLY)
+			break;
+	}
+}
+
+/*
+ * Serve calls until killed. The registry (handle 0) and the benchmark
+ * servers share this loop; handler builds the reply for one call and
+ * returns the buffers size to send it with.
+ */
+typedef size_t (*bio_handler)(struct bio *b,
+			      const struct binder_transaction_data *tr,
+			      struct binder_transaction_data *reply,
+			      size_t *offs_storage, void *data_storage);
+
+struct looper_arg {
+	struct bio *b;
+	bio_handler handler;
+};
+
+static void *bio_looper(void *arg)
+{
+	struct looper_arg *la = arg;
+	struct bio *b = la->b;
+	uint32_t rbuf[64];
+	struct wbuf w = { .len = 0 };
+	uint8_t data_storage[sizeof(struct flat_binder_object)];
+	size_t offs_storage[1];
+
+	wbuf_u32(&w, BC_ENTER_LOOPER);
+
+	for (;;) {
+		struct binder_transaction_data tr, reply;
+		struct wbuf ack = { .len = 0 };
+		size_t done, buffers_size;
+		uint32_t cmd;
+
+		if (bio_write_read(b, w.data, w.len, rbuf, sizeof(rbuf),
+				   &done) < 0)
+			die("BINDER_WRITE_READ loop");
+		w.len = 0;
+
+		cmd = bio_parse((uint8_t *)rbuf, (uint8_t *)rbuf + done,
+				&ack, &tr);
+		if (ack.len)
+			bio_write(b, ack.data, ack.len);
+		if (cmd != BR_TRANSACTION)
+			continue;
+
+		memset(&reply, 0, sizeof(reply));
+		buffers_size = la->handler(b, &tr, &reply, offs_storage,
+					   data_storage);
+
+		/* the reply may echo the call buffer: free it afterwards */
+		if (!(tr.flags & TF_ONE_WAY))
+			wbuf_txn(&w, 1, 0, 0, reply.data.ptr.buffer,
+				 reply.data_size, reply.data.ptr.offsets,
+				 reply.offsets_size, buffers_size);
+		wbuf_u32(&w, BC_FREE_BUFFER);
+		wbuf_ptr(&w, tr.data.ptr.buffer);
+	}
+	return NULL;
+}
+
+static void bio_serve(struct bio *b, bio_handler handler, int threads)
+{
+	struct looper_arg la = { .b = b, .handler = handler };
+	pthread_t tid[MAX_THREADS];
+	int i;
+
+	for (i = 1; i < threads; i++)
+		if (pthread_create(&tid[i], NULL, bio_looper, &la))
+			die("pthread_create");
+	bio_looper(&la);
+}
+
+/* Registry: REG_ADD stores a handle by index, REG_GET hands it out */
+static size_t reg_handles[MAX_CLIENTS];
+
+static size_t reg_handler(struct bio *b,
+			  const struct binder_transaction_data *tr,
+			  struct binder_transaction_data *reply,
+			  size_t *offs_storage, void *data_storage)
+{
+	const uint8_t *data = tr->data.ptr.buffer;
+	struct flat_binder_object obj;
+	uint32_t index;
+
+	if (tr->data_size < sizeof(index))
+		return 0;
+	memcpy(&index, data, sizeof(index));
+	if (index >= MAX_CLIENTS)
+		return 0;
+
+	if (tr->code == REG_ADD &&
+	    tr->data_size >= sizeof(index) + sizeof(obj)) {
+		struct wbuf w = { .len = 0 };
+
+		memcpy(&obj, data + sizeof(index), sizeof(obj));
+		if (obj.type != BINDER_TYPE_HANDLE)
+			return 0;
+		reg_handles[index] = obj.handle;
+
+		/* keep the ref once the transaction buffer is freed */
+		wbuf_u32(&w, BC_ACQUIRE);
+		wbuf_u32(&w, obj.handle);
+		bio_write(b, w.data, w.len);
+		if (verbose)
+			fprintf(stderr, "registry: %u -> handle %zu\n",
+				index, reg_handles[index]);
+	} else if (tr->code == REG_GET && reg_handles[index]) {
+		memset(&obj, 0, sizeof(obj));
+		obj.type = BINDER_TYPE_HANDLE;
+		obj.handle = reg_handles[index];
+		memcpy(data_storage, &obj, sizeof(obj));
+		offs_storage[0] = 0;
+		reply->data.ptr.buffer = data_storage;
+		reply->data_size = sizeof(obj);
+		reply->data.ptr.offsets = offs_storage;
+		reply->offsets_size = sizeof(size_t);
+	}
+	return 0;
+}
+
+/*
+ * Benchmark server: echo the payload back. A gathered payload is sent
+ * back the same way, straight from where it landed in our mapping.
+ */
+static size_t echo_handler(struct bio *b,
+			   const struct binder_transaction_data *tr,
+			   struct binder_transaction_data *reply,
+			   size_t *offs_storage, void *data_storage)
+{
+	struct binder_buffer_object bp;
+
+	if (tr->offsets_size == sizeof(size_t) &&
+	    tr->data_size == sizeof(bp)) {
+		memcpy(&bp, tr->data.ptr.buffer, sizeof(bp));
+		if (bp.type != BINDER_TYPE_PTR)
+			return 0;
+		memcpy(data_storage, &bp, sizeof(bp));
+		offs_storage[0] = 0;
+		reply->data.ptr.buffer = data_storage;
+		reply->data_size = sizeof(bp);
+		reply->data.ptr.offsets = offs_storage;
+		reply->offsets_size = sizeof(size_t);
+		return ALIGN_PTR(bp.length);
+	}
+
+	reply->data.ptr.buffer = tr->data.ptr.buffer;
+	reply->data_size = tr->data_size;
+	return 0;
+}
+
+static void run_registry(int ready_fd)
+{
+	struct bio b;
+
+	bio_open(&b);
+	if (ioctl(b.fd, BINDER_SET_CONTEXT_MGR, 0) < 0)
+		die("BINDER_SET_CONTEXT_MGR (is servicemanager running?)");
+	if (write(ready_fd, "r", 1) != 1)
+		die("write ready");
+	close(ready_fd);
+	bio_serve(&b, reg_handler, 1);
+}
+
+static int server_cookie;
+
+static void run_server(uint32_t index, int threads, int ready_fd)
+{
+	struct bio b;
+	struct binder_transaction_data reply;
+	struct {
+		uint32_t index;
+		struct flat_binder_object obj;
+	} __attribute__((packed)) msg;
+	size_t offs = sizeof(uint32_t);
+
+	bio_open(&b);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.index = index;
+	msg.obj.type = BINDER_TYPE_BINDER;
+	msg.obj.flags = 0x7f;	/* inherit the caller's nice, as libbinder */
+	msg.obj.binder = &server_cookie;
+	msg.obj.cookie = &server_cookie;
+
+	bio_call(&b, 0, REG_ADD, &msg, sizeof(msg), &offs, sizeof(offs), 0,
+		 NULL, &reply);
+	{
+		struct wbuf w = { .len = 0 };
+
+		wbuf_u32(&w, BC_FREE_BUFFER);
+		wbuf_ptr(&w, reply.data.ptr.buffer);
+		bio_write(&b, w.data, w.len);
+	}
+
+	if (write(ready_fd, "s", 1) != 1)
+		die("write ready");
+	close(ready_fd);
+	bio_serve(&b, echo_handler, threads);
+}
+
+static size_t client_lookup(struct bio *b, uint32_t index)
+{
+	struct binder_transaction_data reply;
+	struct flat_binder_object obj;
+	struct wbuf w = { .len = 0 };
+
+	bio_call(b, 0, REG_GET, &index, sizeof(index), NULL, 0, 0, NULL,
+		 &reply);
+	if (reply.data_size < sizeof(obj)) {
+		fprintf(stderr, "binder-bench: server %u not registered\n",
+			index);
+		exit(1);
+	}
+	memcpy(&obj, reply.data.ptr.buffer, sizeof(obj));
+
+	wbuf_u32(&w, BC_ACQUIRE);
+	wbuf_u32(&w, obj.handle);
+	wbuf_u32(&w, BC_FREE_BUFFER);
+	wbuf_ptr(&w, reply.data.ptr.buffer);
+	bio_write(b, w.data, w.len);
+
+	return obj.handle;
+}
+
+static void run_client(uint32_t index, size_t size, uint64_t duration_ns,
+		       uint64_t iterations, int start_fd, int result_fd)
+{
+	struct bio b;
+	struct binder_transaction_data reply;
+	struct result r;
+	const void *last = NULL;
+	uint64_t start, t, end;
+	size_t handle;
+	void *payload;
+	struct binder_buffer_object bp;
+	size_t bp_off = 0;
+	char c;
+
+	bio_open(&b);
+	handle = client_lookup(&b, index);
+
+	payload = calloc(1, size ? size : 1);
+	if (!payload)
+		die("calloc");
+
+	memset(&bp, 0, sizeof(bp));
+	bp.type = BINDER_TYPE_PTR;
+	bp.buffer = payload;
+	bp.length = size;
+
+	/* wait for every client to be connected, then go */
+	if (read(start_fd, &c, 1) < 0)
+		die("read start");
+	close(start_fd);
+
+	memset(&r, 0, sizeof(r));
+	start = now_ns();
+	end = start + duration_ns;
+	t = start;
+	while (iterations ? r.calls < iterations : t < end) {
+		uint64_t lat;
+
+		if (gather)
+			bio_call(&b, handle, BENCH_PING, &bp, sizeof(bp),
+				 &bp_off, sizeof(bp_off), ALIGN_PTR(size),
+				 last, &reply);
+		else
+			bio_call(&b, handle, BENCH_PING, payload, size, NULL, 0,
+				 0, last, &reply);
+		last = reply.data.ptr.buffer;
+
+		lat = now_ns() - t;
+		t += lat;
+		r.calls++;
+		r.lat_sum_ns += lat;
+		if (lat > r.lat_max_ns)
+			r.lat_max_ns = lat;
+	}
+	r.ns = t - start;
+
+	if (write(result_fd, &r, sizeof(r)) != sizeof(r))
+		die("write result");
+	exit(0);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: binder-bench [options] pingpong|fanout\n"
+		"  -c <n>   client processes (default 4)\n"
+		"  -t <n>   fanout server threads (default: clients)\n"
+		"  -s <n>   payload bytes each way (default 32)\n"
+		"  -g       send the payload as a gathered buffer\n"
+		"  -d <s>   run for <s> seconds (default 5)\n"
+		"  -i <n>   run <n> calls per client instead\n"
+		"  -v       verbose\n");
+	exit(2);
+}
+
+static pid_t spawn(void)
+{
+	pid_t pid = fork();
+
+	if (pid < 0)
+		die("fork");
+	return pid;
+}
+
+int main(int argc, char **argv)
+{
+	int clients = 4, threads = 0, fanout, servers;
+	size_t size = 32;
+	uint64_t duration_ns = 5000000000ULL, iterations = 0;
+	pid_t helpers[MAX_CLIENTS + 1];
+	int nr_helpers = 0;
+	int ready[2], start[2], results[2];
+	uint64_t total_calls = 0, lat_sum = 0, lat_max = 0, max_ns = 0;
+	char c;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "c:t:s:d:i:gv")) != -1) {
+		switch (opt) {
+		case 'c':
+			clients = atoi(optarg);
+			break;
+		case 't':
+			threads = atoi(optarg);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			duration_ns = strtoull(optarg, NULL, 0) * 1000000000ULL;
+			break;
+		case 'i':
+			iterations = strtoull(optarg, NULL, 0);
+			break;
+		case 'g':
+			gather = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1)
+		usage();
+	if (!strcmp(argv[optind], "pingpong"))
+		fanout = 0;
+	else if (!strcmp(argv[optind], "fanout"))
+		fanout = 1;
+	else
+		usage();
+
+	if (clients < 1 || clients > MAX_CLIENTS)
+		usage();
+	if (threads <= 0)
+		threads = fanout ? clients : 1;
+	if (threads > MAX_THREADS)
+		threads = MAX_THREADS;
+	if (size > BINDER_MAP_SIZE / 4)
+		usage();
+	servers = fanout ? 1 : clients;
+
+	if (pipe(ready) || pipe(start) || pipe(results))
+		die("pipe");
+
+	helpers[nr_helpers] = spawn();
+	if (!helpers[nr_helpers]) {
+		close(ready[0]);
+		run_registry(ready[1]);
+	}
+	nr_helpers++;
+	if (read(ready[0], &c, 1) != 1) {
+		fprintf(stderr, "binder-bench: registry failed\n");
+		goto out;
+	}
+
+	for (i = 0; i < servers; i++) {
+		helpers[nr_helpers] = spawn();
+		if (!helpers[nr_helpers]) {
+			close(ready[0]);
+			run_server(i, fanout ? threads : 1, ready[1]);
+		}
+		nr_helpers++;
+		if (read(ready[0], &c, 1) != 1) {
+			fprintf(stderr, "binder-bench: server %d failed\n", i);
+			goto out;
+		}
+	}
+
+	for (i = 0; i < clients; i++) {
+		if (!spawn()) {
+			close(start[1]);
+			close(results[0]);
+			run_client(fanout ? 0 : i, size, duration_ns,
+				   iterations, start[0], results[1]);
+		}
+	}
+	close(start[0]);
+	close(results[1]);
+
+	/* a client stuck in lookup would hang here; clients exit on error */
+	usleep(100000);
+	close(start[1]);
+
+	printf("%s: %d client%s, %d server%s x %d thread%s, %zu bytes%s\n",
+	       fanout ? "fanout" : "pingpong", clients,
+	       clients == 1 ? "" : "s", servers, servers == 1 ? "" : "s",
+	       fanout ? threads : 1, (fanout ? threads : 1) == 1 ? "" : "s",
+	       size, gather ? " gathered" : "");
+
+	for (i = 0; i < clients; i++) {
+		struct result r;
+
+		if (read(results[0], &r, sizeof(r)) != sizeof(r)) {
+			fprintf(stderr, "binder-bench: lost a client\n");
+			break;
+		}
+		if (verbose)
+			printf("  client: %llu calls, %.0f calls/s, "
+			       "mean %.1f us\n",
+			       (unsigned long long)r.calls,
+			       r.ns ? r.calls * 1e9 / r.ns : 0.0,
+			       r.calls ? r.lat_sum_ns / 1e3 / r.calls : 0.0);
+		total_calls += r.calls;
+		lat_sum += r.lat_sum_ns;
+		if (r.lat_max_ns > lat_max)
+			lat_max = r.lat_max_ns;
+		if (r.ns > max_ns)
+			max_ns = r.ns;
+	}
+
+	if (total_calls && max_ns) {
+		printf("total: %llu calls, %.0f calls/s, "
+		       "%.0f calls/s per client\n",
+		       (unsigned long long)total_calls,
+		       total_calls * 1e9 / max_ns,
+		       total_calls * 1e9 / max_ns / clients);
+		printf("latency: mean %.1f us, max %.1f us\n",
+		       lat_sum / 1e3 / total_calls, lat_max / 1e3);
+	}
+
+out:
+	for (i = 0; i < nr_helpers; i++)
+		kill(helpers[i], SIGKILL);
+	while (wait(NULL) > 0)
+		;
+	return total_calls ? 0 : 1;
+}
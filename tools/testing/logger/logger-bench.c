@@ -0,0 +1,336 @@
+/*
+ * logger-bench.c: Android logger write throughput benchmark
+ *
+ * Runs <threads> writer threads that log as fast as they can to one log
+ * device for <seconds>, each entry laid out the way liblog writes it: a
+ * priority byte, a tag and a message of <size> bytes, in one writev().
+ * All threads share one file descriptor per log, as the threads of an
+ * app do. The report has the entry rate per thread and in total, and
+ * the mean and max latency of a write.
+ *
+ * With -r, a reader thread drains the log while it is written, one entry
+ * per read() or, with -b, as many as fit in 64K per read() in the batched
+ * LOGGER_VERSION_BATCH mode. Messages carry the writer and a per-writer
+ * sequence number, so the reader also reports entries it lost to being
+ * lapped, and entries of one writer it saw out of order, which the logger
+ * must never produce.
+ *
+ * Copyright (C) 2012 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+
+#include "logger.h"
+
+#define MAX_THREADS		64
+#define TAG			"logger-bench"
+#define LOG_PRIO_INFO		4
+
+struct writer {
+	pthread_t thread;
+	int id;
+	uint64_t writes;
+	uint64_t lat_sum_ns;
+	uint64_t lat_max_ns;
+};
+
+#define BATCH_SIZE		(64 * 1024)
+
+struct reader {
+	pthread_t thread;
+	int fd;
+	int batch;
+	uint64_t reads;
+	uint64_t entries;
+	uint64_t lost;
+	uint64_t reordered;
+	uint64_t last_seq[MAX_THREADS];
+};
+
+static int log_fd;
+static size_t msg_size = 64;
+static volatile int stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void die(const char *what)
+{
+	fprintf(stderr, "logger-bench: %s: %s\n", what, strerror(errno));
+	exit(1);
+}
+
+static void *run_writer(void *arg)
+{
+	struct writer *w = arg;
+	unsigned char prio = LOG_PRIO_INFO;
+	char *msg = malloc(msg_size + 1);
+	struct iovec vec[3];
+	uint64_t seq = 0;
+
+	if (!msg)
+		die("malloc");
+	memset(msg, 'x', msg_size);
+	msg[msg_size] = '\0';
+
+	vec[0].iov_base = &prio;
+	vec[0].iov_len = 1;
+	vec[1].iov_base = TAG;
+	vec[1].iov_len = sizeof(TAG);
+	vec[2].iov_base = msg;
+	vec[2].iov_len = msg_size + 1;
+
+	while (!stop) {
+		uint64_t start, lat;
+		ssize_t ret;
+
+		/* "<writer> <seq> " over the start of the padding */
+		snprintf(msg, msg_size + 1, "%d %llu ", w->id,
+			 (unsigned long long)++seq);
+		msg[strlen(msg)] = msg_size > strlen(msg) ? 'x' : '\0';
+
+		start = now_ns();
+		do {
+			ret = writev(log_fd, vec, 3);
+		} while (ret < 0 && errno == EAGAIN);
+		if (ret < 0)
+			die("writev");
+		lat = now_ns() - start;
+
+		w->writes++;
+		w->lat_sum_ns += lat;
+		if (lat > w->lat_max_ns)
+			w->lat_max_ns = lat;
+	}
+
+	free(msg);
+	return NULL;
+}
+
+static void reader_account(struct reader *r, struct logger_entry *e)
+{
+	const char *msg;
+	unsigned long long seq;
+	int id;
+
+	r->entries++;
+
+	/* skip the priority byte and the tag */
+	msg = e->msg + 1;
+	msg += strnlen(msg, e->len - 1) + 1;
+	if (msg >= e->msg + e->len || strcmp(e->msg + 1, TAG))
+		return;
+	if (sscanf(msg, "%d %llu", &id, &seq) != 2 ||
+	    id < 0 || id >= MAX_THREADS)
+		return;
+
+	if (seq <= r->last_seq[id])
+		r->reordered++;
+	else
+		r->lost += seq - r->last_seq[id] - 1;
+	r->last_seq[id] = seq;
+}
+
+static void *run_reader(void *arg)
+{
+	struct reader *r = arg;
+	size_t size = r->batch ? BATCH_SIZE :
+		LOGGER_ENTRY_MAX_PAYLOAD + sizeof(struct logger_entry);
+	char *buf = malloc(size);
+	/* one entry, aligned and terminated */
+	char entry[LOGGER_ENTRY_MAX_PAYLOAD + sizeof(struct logger_entry) + 1];
+	struct pollfd pfd = { .fd = r->fd, .events = POLLIN };
+
+	if (!buf)
+		die("malloc");
+
+	while (!stop) {
+		ssize_t ret = read(r->fd, buf, size);
+		ssize_t off;
+
+		if (ret < 0 && errno == EAGAIN) {
+			poll(&pfd, 1, 100);
+			continue;
+		}
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			die("read");
+		r->reads++;
+
+		for (off = 0; off + sizeof(struct logger_entry) <= ret; ) {
+			struct logger_entry hdr;
+			size_t len;
+
+			memcpy(&hdr, buf + off, sizeof(hdr));
+			len = sizeof(hdr) + hdr.len;
+			if (off + len > ret)
+				break;
+			memcpy(entry, buf + off, len);
+			entry[len] = '\0';
+			reader_account(r, (struct logger_entry *)entry);
+			off += len;
+		}
+	}
+
+	free(buf);
+	return NULL;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: logger-bench [options]\n"
+		"  -l <log>  log device (default /dev/log/main)\n"
+		"  -t <n>    writer threads (default 4)\n"
+		"  -s <n>    message bytes (default 64)\n"
+		"  -d <s>    run for <s> seconds (default 5)\n"
+		"  -r        drain the log with a reader while writing\n"
+		"  -b        read in batches rather than an entry at a time\n"
+		"  -v        verbose\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *log_name = "/dev/log/main";
+	int threads = 4, read_log = 0, batch = 0, verbose = 0;
+	unsigned int seconds = 5;
+	struct writer writers[MAX_THREADS];
+	struct reader reader;
+	uint64_t start, ns, total = 0, lat_sum = 0, lat_max = 0;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "l:t:s:d:rbv")) != -1) {
+		switch (opt) {
+		case 'l':
+			log_name = optarg;
+			break;
+		case 't':
+			threads = atoi(optarg);
+			break;
+		case 's':
+			msg_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			read_log = 1;
+			break;
+		case 'b':
+			read_log = 1;
+			batch = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc)
+		usage();
+	if (threads < 1 || threads > MAX_THREADS)
+		usage();
+	if (msg_size < 32 ||
+	    msg_size + sizeof(TAG) + 2 > LOGGER_ENTRY_MAX_PAYLOAD)
+		usage();
+
+	log_fd = open(log_name, O_WRONLY);
+	if (log_fd < 0)
+		die(log_name);
+
+	if (read_log) {
+		int version = batch ? LOGGER_VERSION_BATCH : 2;
+
+		memset(&reader, 0, sizeof(reader));
+		reader.batch = batch;
+		reader.fd = open(log_name, O_RDONLY | O_NONBLOCK);
+		if (reader.fd < 0)
+			die(log_name);
+		if (ioctl(reader.fd, LOGGER_SET_VERSION, &version) < 0)
+			die("LOGGER_SET_VERSION");
+		/* start from an empty log, so that sequence numbers line up */
+		if (ioctl(log_fd, LOGGER_FLUSH_LOG) < 0)
+			die("LOGGER_FLUSH_LOG");
+		if (pthread_create(&reader.thread, NULL, run_reader, &reader))
+			die("pthread_create");
+	}
+
+	memset(writers, 0, sizeof(writers));
+	start = now_ns();
+	for (i = 0; i < threads; i++) {
+		writers[i].id = i;
+		if (pthread_create(&writers[i].thread, NULL, run_writer,
+				   &writers[i]))
+			die("pthread_create");
+	}
+
+	sleep(seconds);
+	stop = 1;
+
+	for (i = 0; i < threads; i++)
+		pthread_join(writers[i].thread, NULL);
+	ns = now_ns() - start;
+	if (read_log)
+		pthread_join(reader.thread, NULL);
+
+	printf("%s: %d thread%s, %zu byte messages, %u s\n", log_name,
+	       threads, threads == 1 ? "" : "s", msg_size, seconds);
+
+	for (i = 0; i < threads; i++) {
+		struct writer *w = &writers[i];
+
+		if (verbose)
+			printf("  thread %d: %llu writes, %.0f writes/s, "
+			       "mean %.1f us\n", i,
+			       (unsigned long long)w->writes,
+			       w->writes * 1e9 / ns,
+			       w->writes ? w->lat_sum_ns / 1e3 / w->writes : 0);
+		total += w->writes;
+		lat_sum += w->lat_sum_ns;
+		if (w->lat_max_ns > lat_max)
+			lat_max = w->lat_max_ns;
+	}
+
+	printf("total: %llu writes, %.0f writes/s, %.0f writes/s per thread, "
+	       "%.1f MB/s\n", (unsigned long long)total, total * 1e9 / ns,
+	       total * 1e9 / ns / threads,
+	       total * (msg_size + sizeof(TAG) + 2) * 1e3 / ns);
+	if (total)
+		printf("write latency: mean %.1f us, max %.1f us\n",
+		       lat_sum / 1e3 / total, lat_max / 1e3);
+	if (read_log)
+		printf("reader: %llu entries, %.0f entries/s, %.1f per read, "
+		       "%llu lost, %llu out of order\n",
+		       (unsigned long long)reader.entries,
+		       reader.entries * 1e9 / ns,
+		       reader.reads ? (double)reader.entries / reader.reads : 0,
+		       (unsigned long long)reader.lost,
+		       (unsigned long long)reader.reordered);
+
+	return 0;
+}